@@ -0,0 +1,16 @@
+#pragma once
+
+#include <stdint.h>
+
+// Heap allocation counter for proving that a code path does not allocate.
+// Read the counters before and after the code being measured.
+//   Host (src/native/): every operator new is counted (std::string, std::vector, ...).
+//   Device: build with -DALLOC_COUNT and -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc
+//   (env:alloc-check); malloc/calloc/realloc made by the watched task are counted,
+//   which covers String, HTTPClient and the IDF components it calls into.
+namespace AllocCounter {
+  uint64_t count();
+  uint64_t bytes();
+  // Device: count the calling task only (allocations by WiFi/lwIP tasks are not ours). Host: no-op.
+  void watchCurrentTask();
+}
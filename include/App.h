@@ -0,0 +1,132 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include "Hal.h"
+#include "SensorData.h"
+#include "SampleBuffer.h"
+#include "WindowAggregator.h"
+#include "MotionAnalyzer.h"
+#include "LoopProfiler.h"
+#include "Scheduler.h"
+
+struct AppConfig {
+  const char* userId;
+  AggregationConfig aggregation;  // Window length, heartbeat and per-channel deadbands of buffered samples
+  FlushPolicy flushPolicy;        // maxSamples doubles as the upload batch size; idleMaxAgeMs applies while the display is off
+  uint32_t flushRetryIntervalMs;  // Min spacing between flush attempts while uploads fail
+  MotionConfig motion;            // sampleRateHz is taken from the MotionSensor
+  uint8_t vibrationIntensity;
+  uint32_t vibrationMs;
+  uint32_t popupMs;
+  uint32_t perfWindowMs;          // Profiling window; each window's summary goes out with the next upload
+};
+
+struct AppHal {
+  Clock* clock;
+  EnvSensors* sensors;
+  MotionSensor* imu;
+  Ui* ui;
+  UploadLink* link;
+  SystemMonitor* system;
+  EventLog* events;     // Every upload result, shown on the log page
+};
+
+// Timed work in App::loop(), each armed for when it is next due
+enum class AppTask : uint8_t { Window, Flush, Diagnostics, Popup, Vibration, Screen, Count };
+
+// Everything loop() does, written against the Hal interfaces so the same code runs on
+// the Core2 and in the native simulator/benchmark: windowed sensor aggregation and batch uploads,
+// motion events, cloud state reactions, the UI pages, the upload event log and the
+// loop profiler. loop() is one non-blocking pass; the caller decides how often it runs
+// (and times what it does around it into profiler(): LoopStage::Board and Idle). msUntilDue()
+// says how long the next pass would find nothing to do, so the caller can sleep until then.
+//
+// While the display is off nobody watches live values: sensors back off while their readings
+// are steady (EnvSensors::setAdaptive) and partial batches may wait up to idleMaxAgeMs.
+class App {
+public:
+  static constexpr size_t MAX_LOG_ROWS = 12;    // Log page rows read per redraw
+  static constexpr size_t IMU_BATCH = 64;       // IMU samples taken per drain
+  static constexpr uint32_t SYSTEM_READ_MS = 1000; // Heap/RSSI sampling and diagnostics page refresh
+
+  void begin(const AppConfig& config, const AppHal& hal);
+  void loop();
+  // Time until the next sensor read, IMU drain or timed task (the touch controller and network
+  // results are not included: the caller wakes on those by itself or within its longest sleep).
+  uint32_t msUntilDue();
+
+  const SensorData& currentData() const { return _currentData; }
+  size_t bufferedSamples() const { return _sampleBuffer.size(); }
+  uint32_t droppedSamples() const { return _sampleBuffer.dropped(); }
+  const WindowAggregator& aggregator() const { return _aggregator; }
+  LoopProfiler& profiler() { return _prof; }
+
+private:
+  void updateSensors();
+  void closeWindow(bool force);
+  uint8_t recentChannels(uint32_t now) const;
+  void uploadData(const char* triggerEvent = nullptr);
+  void flushUploads();
+  void scheduleFlush(uint32_t now);
+  uint32_t flushAgeMs() const;
+  void handleNetEvents();
+  void handleUploadResult(const NetEvent& ev);
+  void handleCloudState(bool currentCloudState);
+  void handleLinkUp(const NetEvent& ev);
+  void processImu();
+  void processImuBatch(size_t n);
+  void startVibration();
+  void updateVibration();
+  void handleTouch();
+  void updateAwake(uint32_t now);
+  void scrollLog(UiButton button);
+  void drawScreen();
+  void updateScreenData();
+  void updateMainPageData();
+  void updateLogPageData();
+  void updateDiagPageData();
+  void updateDiagnostics(uint32_t now);
+  void clearPopup();
+  void logUploadResult(const NetEvent& ev);
+
+  AppConfig _cfg = {};
+  AppHal _hal = {};
+  SensorData _currentData = {};
+  uint8_t _readChannels = 0;      // Channels read at least once since boot (the others in _currentData are 0)
+  uint32_t _capturedMs[ENV_CHANNELS] = {}; // When each value in _currentData was captured
+
+  WindowAggregator _aggregator;          // Every sensor reading, summarized per window
+  // Windows waiting to be uploaded (room for two batches so a failed flush is retried, not lost)
+  SampleBuffer<2 * MAX_BATCH_SAMPLES> _sampleBuffer;
+  UploadJob _uploadJob = {};             // Staging buffer for submitUpload (too large for the stack)
+  bool _uploadInFlight = false;          // A batch is queued/being sent; its samples stay buffered until the result
+  size_t _inFlightCount = 0;
+  uint32_t _inFlightDroppedMark = 0;     // _sampleBuffer.dropped() when the batch was queued
+  const char* _pendingUploadEvent = nullptr; // Event that arrived while a batch was in flight
+  MotionEvent _pendingMotion = {};       // Feature summary that goes out with the next upload
+  uint32_t _lastFlushAttemptTime = 0;
+  uint32_t _calmWindows = 0;             // Windows in a row in which no channel left its deadband
+
+  MotionAnalyzer _motion;
+  ImuSample _imuBatch[IMU_BATCH];
+
+  Scheduler<AppTask, (size_t)AppTask::Count> _sched;
+  bool _uiAwake = true;                  // Display on (someone may be watching)
+  bool _showShakePopup = false;
+
+  bool _lastCloudState = false;
+  bool _firstCloudCheck = true;
+
+  LoopProfiler _prof;
+  PerfSummary _pendingPerf = {};         // Closed window waiting for the next upload (seq 0: none)
+  bool _diagDirty = true;                // Diagnostics page shows stale figures
+
+  UiPage _page = UiPage::Main;
+  // Log page: newest first, the top row is record _logTop - 1. Following, it tracks the newest record.
+  bool _logFollow = true;
+  uint32_t _logTop = 0;
+  uint32_t _shownLogTop = 0, _shownLogEnd = 0; // What the log page shows
+  bool _logDirty = true;
+};
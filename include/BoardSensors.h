@@ -0,0 +1,53 @@
+#pragma once
+
+#include <Wire.h>
+#include <Adafruit_VCNL4040.h>
+#include "SensorHub.h"
+
+// Device acquisition channels for SensorHub. The VCNL4040 converts continuously, so its
+// channels read the latest result registers straight away. The SHT4x is driven over
+// raw I2C: the Adafruit driver's getEvent() sits in delay() for the whole ~9 ms
+// conversion, here trigger() starts it and collect() picks it up on a later pass.
+
+class Vcnl4040Proximity : public SensorChannel {
+public:
+  explicit Vcnl4040Proximity(Adafruit_VCNL4040& chip) : _chip(chip) {}
+  const char* name() const override { return "prox"; }
+  uint8_t channels() const override { return envChannelBit(EnvChannel::Prox); }
+  bool trigger(uint32_t& waitMs) override { waitMs = 0; return true; }
+  bool collect(SensorData& out) override { out.prox = _chip.getProximity(); return true; }
+private:
+  Adafruit_VCNL4040& _chip;
+};
+
+class Vcnl4040Light : public SensorChannel {
+public:
+  explicit Vcnl4040Light(Adafruit_VCNL4040& chip) : _chip(chip) {}
+  const char* name() const override { return "light"; }
+  uint8_t channels() const override { return envChannelBit(EnvChannel::AmbientLight) | envChannelBit(EnvChannel::WhiteLight); }
+  bool trigger(uint32_t& waitMs) override { waitMs = 0; return true; }
+  bool collect(SensorData& out) override;
+private:
+  Adafruit_VCNL4040& _chip;
+};
+
+// Temperature + humidity, one high-precision single-shot measurement per trigger().
+// Call after Adafruit_SHT4x::begin() has found and reset the chip.
+class Sht4xChannel : public SensorChannel {
+public:
+  static constexpr uint8_t DEFAULT_ADDRESS = 0x44;
+
+  explicit Sht4xChannel(TwoWire& wire, uint8_t address = DEFAULT_ADDRESS) : _wire(wire), _address(address) {}
+  const char* name() const override { return "sht4x"; }
+  uint8_t channels() const override { return envChannelBit(EnvChannel::Temp) | envChannelBit(EnvChannel::RHum); }
+  bool trigger(uint32_t& waitMs) override;
+  bool collect(SensorData& out) override;
+  uint32_t crcErrors() const { return _crcErrors; }
+
+private:
+  static uint8_t crc8(const uint8_t* data, size_t len);
+
+  TwoWire& _wire;
+  uint8_t _address;
+  uint32_t _crcErrors = 0;
+};
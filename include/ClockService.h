@@ -0,0 +1,73 @@
+#pragma once
+
+#include <Arduino.h>
+#include <sys/time.h>
+#include "Hal.h"
+
+// Wall clock for the whole firmware. Time is esp_timer (microseconds since boot,
+// never adjusted) mapped onto UTC by an offset and a rate correction:
+//   utc = baseUtc + (timer - baseTimer) * (1 + drift)
+// so reading it is a timer read and a multiply, with no UDP or NTP state involved.
+//
+// - Boot: the mapping is seeded from the BM8563 RTC (1 s resolution), so timestamps
+//   are valid before WiFi comes up and across reboots.
+// - SNTP (lwIP, in the background) re-anchors it every syncIntervalMs once started.
+//   Consecutive syncs give the crystal's drift, which is smoothed and applied between
+//   syncs so the clock stays close during WiFi outages.
+// - After each sync, service() writes the time back to the RTC, at the top of a second.
+//
+// Readings do not go backwards for small corrections: a sync that moves the clock back by up
+// to a second holds it until it catches up. A larger error is stepped out at once, since
+// holding would freeze the timestamps for as long as the error.
+class ClockService : public Clock {
+public:
+  enum class Source : uint8_t { None, Rtc, Sntp };
+
+  struct Status {
+    Source source;
+    uint32_t syncs;          // SNTP syncs since boot
+    int32_t lastCorrectionMs; // Clock error found by the last sync (positive: clock was behind)
+    float driftPpm;          // Applied rate correction
+    uint32_t sinceSyncS;     // Seconds since the last sync or RTC seed
+  };
+
+  static constexpr float MAX_DRIFT_PPM = 500.0f;
+
+  // utcOffsetS: applied to epoch()/epochMs() (display and uploads use local time).
+  void begin(int32_t utcOffsetS, const char* ntpServer, uint32_t syncIntervalMs);
+  // Starts SNTP; call once the network is up (from any task, only the first call counts).
+  void startSntp();
+  // Writes a pending sync to the RTC; call from loop() (the RTC sits on the internal I2C bus).
+  void service();
+
+  uint32_t millis() override { return ::millis(); }
+  bool timeSet() override { return _source != Source::None; }
+  // 0 until the RTC or SNTP set the clock: before that utcUs() is time since boot, which a negative offset would wrap
+  uint64_t epochMs() override { return timeSet() ? (utcUs() + (int64_t)_utcOffsetS * 1000000) / 1000 : 0; }
+  uint64_t utcUs();
+  Status status();
+  static const char* sourceName(Source source);
+
+private:
+  static void onSntpSync(struct timeval* tv);
+  void sync(uint64_t utcUs, int64_t timerUs);
+  uint64_t mapLocked(int64_t timerUs) const;
+  bool readRtc(uint64_t& utcUs);
+  void writeRtc(uint64_t utcUs);
+
+  portMUX_TYPE _lock = portMUX_INITIALIZER_UNLOCKED; // Read on core 1, synced from the lwIP task
+  int32_t _utcOffsetS = 0;
+  const char* _ntpServer = nullptr;
+  uint32_t _syncIntervalMs = 0;
+  bool _sntpStarted = false;
+  volatile Source _source = Source::None;
+  int64_t _baseTimerUs = 0;
+  uint64_t _baseUtcUs = 0;
+  float _drift = 0.0f;            // Rate correction (ppm * 1e-6)
+  int64_t _lastSyncTimerUs = 0;   // Previous SNTP sync, for the drift estimate
+  uint64_t _lastSyncUtcUs = 0;
+  uint64_t _lastReadUs = 0;       // Highest value handed out since the last step (monotonic readings)
+  uint32_t _syncs = 0;
+  int32_t _lastCorrectionMs = 0;
+  volatile bool _rtcWritePending = false;
+};
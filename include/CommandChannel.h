@@ -0,0 +1,69 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "HttpSession.h"
+#include "StatePoll.h"
+
+class NetWorker;
+
+// How the device learns about cloud state changes.
+enum class CommandMode : uint8_t {
+  Poll,     // Conditional GET (If-None-Match) every pollIntervalMs
+  LongPoll, // Conditional GET with &wait=N: the server holds it until the state changes
+  Sse,      // text/event-stream; falls back to LongPoll if the server answers with plain JSON
+};
+
+struct CommandChannelConfig {
+  HttpSession* session;
+  const char* userId;
+  NetWorker* events;        // CloudState events are posted through the network task's queue
+  CommandMode mode;
+  uint32_t pollIntervalMs;  // Poll period, and the minimum spacing between long-poll requests
+  uint32_t longPollWaitS;   // How long the server may hold a long-poll request (at most MAX_LONG_POLL_WAIT_S)
+};
+
+// Counters for the command channel, readable from any task.
+struct CommandStats {
+  uint32_t requests;
+  uint32_t notModified;     // 304s: unchanged state, nothing parsed
+  uint32_t parsed;          // Bodies/events parsed
+  uint32_t changes;         // State changes reported to loop()
+  uint32_t errors;
+};
+
+// Delivers the device's "fanState" from get-device-state with as little traffic as
+// possible. Runs in its own task so a held long-poll or event stream never delays
+// uploads on the network task. Responses are parsed straight off the socket with a
+// filter for the one key we need, never buffered into a String.
+class CommandChannel {
+public:
+  static constexpr BaseType_t TASK_CORE = 0;
+  static constexpr uint32_t TASK_STACK = 8192;
+  static constexpr uint32_t SSE_IDLE_TIMEOUT_MS = 60000; // Reconnect if the stream goes quiet (server pings every 15 s)
+  static constexpr uint32_t LONG_POLL_GRACE_S = 10;      // Read timeout beyond the wait the server may hold
+  // HTTPClient::setTimeout() takes a uint16_t in ms; longer waits are cut to this
+  static constexpr uint32_t MAX_LONG_POLL_WAIT_S = UINT16_MAX / 1000 - LONG_POLL_GRACE_S;
+
+  bool begin(const CommandChannelConfig& config);
+  const CommandStats& stats() const { return _stats; }
+  CommandMode mode() const { return _mode; }
+
+private:
+  static void taskEntry(void* arg);
+  void run();
+  int checkCloudCommand(bool longPoll);
+  bool streamEvents();
+  bool parseState(Stream& in, bool& state);
+  bool parseState(const char* json, bool& state);
+  bool handleParsed(DeserializationError error, bool hasKey);
+  void report(bool state, int httpCode);
+
+  CommandChannelConfig _cfg = {};
+  CommandMode _mode = CommandMode::Poll;
+  TaskHandle_t _task = nullptr;
+  CommandStats _stats = {};
+  StatePoll _poll;          // ETag and last reported state
+};
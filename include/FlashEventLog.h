@@ -0,0 +1,57 @@
+#pragma once
+
+#include <Arduino.h>
+#include <FS.h>
+#include "FlashRecord.h"
+#include "Hal.h"
+
+// Upload history on LittleFS, tens of thousands of records deep.
+//
+// Records go into fixed-size segment files (<dir>/<id>.log) like FlashQueue's, but
+// nothing is ever consumed: when maxSegments is exceeded the oldest segment is
+// deleted. Every segment but the newest is full, so a record's sequence number is
+// its position: segment (seq / RECORDS_PER_SEGMENT) + 1, slot seq % RECORDS_PER_SEGMENT,
+// and reading a page is one open + seek + read. A sparse time index in RAM (the epoch
+// of every INDEX_STRIDE-th record) narrows seek() down to one stride of records.
+// Only loop() touches it after begin().
+class FlashEventLog : public EventLog {
+public:
+  static constexpr uint32_t RECORDS_PER_SEGMENT = 1024;
+  static constexpr uint32_t INDEX_STRIDE = 64;
+
+  using Record = FlashRecord<EventRecord, 0x4C45>; // Magic "EL"
+  static constexpr size_t RECORD_SIZE = sizeof(Record);
+
+  ~FlashEventLog() { delete[] _index; }
+  // Scans the segments and rebuilds the time index (one small read per stride).
+  bool begin(fs::FS& fs, const char* dir, uint32_t maxSegments);
+
+  bool append(const EventRecord& record) override;
+  uint32_t first() override { return (_headSeg - 1) * RECORDS_PER_SEGMENT; }
+  uint32_t end() override { return (_tailSeg - 1) * RECORDS_PER_SEGMENT + _tailCount; }
+  size_t read(uint32_t seq, EventRecord* out, size_t count) override;
+  uint32_t seek(uint32_t epoch) override;
+
+  uint32_t size() { return end() - first(); }
+  uint32_t segmentCount() const { return _tailSeg - _headSeg + 1; }
+  // Corrupt records found by begin()'s index scan (stride starts only) plus torn appends since;
+  // page reads and seek() scans do not count, so each record is counted at most once.
+  uint32_t corruptRecords() const { return _corrupt; }
+
+private:
+  String segmentPath(uint32_t seg) const;
+  bool decode(const Record& rec, EventRecord& out);
+  uint32_t& indexEntry(uint32_t seq) { return _index[(seq / INDEX_STRIDE) % _indexSlots]; }
+  void indexRecord(uint32_t seq, const EventRecord& event);
+
+  fs::FS* _fs = nullptr;
+  String _dir;
+  uint32_t _maxSegments = 0;
+  uint32_t _headSeg = 1;                  // Oldest segment kept
+  uint32_t _tailSeg = 1, _tailCount = 0;  // Segment being appended to
+  uint32_t _corrupt = 0;
+  uint32_t _lastEpoch = 0;                // Newest valid timestamp, stands in for corrupt and unset-time index records
+  uint32_t* _index = nullptr;             // Ring over the kept strides
+  uint32_t _indexSlots = 0;
+  File _tail;
+};
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <Arduino.h>
+#include <FS.h>
+#include "FlashRecord.h"
+#include "SensorData.h"
+
+// Persistent FIFO of window samples on LittleFS, used to hold uploads while offline.
+//
+// Records are appended to fixed-size segment files (<dir>/<id>.seg) and a segment
+// is deleted as a whole once every record in it was replayed, so nothing is ever
+// rewritten in place. The read position is kept in <dir>/cursor and only written
+// once per consumed batch. When maxSegments is exceeded the oldest segment is
+// dropped. Not thread safe: only the network task touches it after begin().
+class FlashQueue {
+public:
+  static constexpr uint32_t RECORDS_PER_SEGMENT = 256;
+
+  // Magic "WR" (older layouts: "SQ" point samples, "WQ" windows without ms; skipped as corrupt)
+  using Record = FlashRecord<WindowSample, 0x5257>;
+  static constexpr size_t RECORD_SIZE = sizeof(Record);
+
+  bool begin(fs::FS& fs, const char* dir, uint32_t maxSegments);
+  // Appends samples; returns how many were written.
+  size_t append(const WindowSample* samples, size_t count);
+  // Copies up to maxCount of the oldest records into out without removing them.
+  size_t peek(WindowSample* out, size_t maxCount);
+  // Removes the records returned by the last peek().
+  void consume(size_t count);
+  void clear();
+
+  uint32_t size() const { return _count; }
+  bool empty() const { return _count == 0; }
+  uint32_t segmentCount() const { return _tailSeg - _headSeg + 1; }
+  uint32_t droppedRecords() const { return _dropped; }
+  uint32_t corruptRecords() const { return _corrupt; }
+
+private:
+  String segmentPath(uint32_t seg) const;
+  uint32_t segmentRecords(uint32_t seg);
+  void removeHeadSegment();
+  void loadCursor();
+  void saveCursor();
+
+  fs::FS* _fs = nullptr;
+  String _dir;
+  uint32_t _maxSegments = 0;
+  uint32_t _headSeg = 1, _headOffset = 0; // Next record to replay
+  uint32_t _tailSeg = 1, _tailCount = 0;  // Segment being appended to
+  uint32_t _count = 0;
+  uint32_t _dropped = 0;
+  uint32_t _corrupt = 0;
+  size_t _lastPeekCount = 0;
+  size_t _lastPeekSpan = 0;               // Records stepped over by the last peek (incl. corrupt ones)
+  File _tail;
+};
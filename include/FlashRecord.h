@@ -0,0 +1,45 @@
+#pragma once
+
+#include <Arduino.h>
+
+// On-flash framing shared by FlashQueue and FlashEventLog: fixed-size records of a payload
+// followed by a CRC and a per-file-type magic, in segment files named <dir>/<id in hex>.<ext>.
+
+inline uint16_t flashCrc16(const uint8_t* data, size_t len) { // CRC-16/CCITT-FALSE
+  uint16_t crc = 0xFFFF;
+  for (size_t i = 0; i < len; ++i) {
+    crc ^= (uint16_t)data[i] << 8;
+    for (int b = 0; b < 8; ++b) crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+  }
+  return crc;
+}
+
+template <typename T, uint16_t Magic>
+struct FlashRecord {
+  T data;
+  uint16_t crc;   // CRC-16 over data, catches torn writes after a power loss
+  uint16_t magic; // Tells the layouts apart; a record of another layout reads as corrupt
+
+  void seal(const T& value) {
+    data = value;
+    crc = flashCrc16((const uint8_t*)&data, sizeof(data));
+    magic = Magic;
+  }
+  bool valid() const { return magic == Magic && crc == flashCrc16((const uint8_t*)&data, sizeof(data)); }
+};
+
+// "<dir>/0000002a.<ext>" for segment 42.
+inline String flashSegmentPath(const String& dir, uint32_t seg, const char* ext) {
+  char name[20];
+  snprintf(name, sizeof(name), "/%08lx.%s", (unsigned long)seg, ext);
+  return dir + name;
+}
+
+// The segment id of a directory entry, or false if it is not a segment with that extension.
+inline bool flashSegmentId(const char* path, const char* ext, uint32_t& seg) {
+  const char* name = strrchr(path, '/'); name = name ? name + 1 : path;
+  const char* dot = strrchr(name, '.');
+  if (dot == nullptr || strcmp(dot + 1, ext) != 0) return false;
+  seg = strtoul(name, nullptr, 16);
+  return true;
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "SensorData.h"
+#include "NetTypes.h"
+
+// The hardware App talks to. The device implementations wrap M5Unified, the Adafruit
+// drivers, ClockService and NetWorker (main.cpp, M5Ui, ImuSampler); the native build
+// swaps in simulations fed from recorded traces (src/native/).
+
+class Clock {
+public:
+  virtual ~Clock() {}
+  virtual uint32_t millis() = 0;
+  virtual bool timeSet() = 0;      // Wall clock known (synced, or restored from the RTC)
+  virtual uint64_t epochMs() = 0;  // Wall-clock milliseconds, local offset applied; cheap, never goes back; 0 until timeSet()
+  uint32_t epoch() { return epochMs() / 1000; }
+};
+
+// Proximity/light and temperature/humidity.
+class EnvSensors {
+public:
+  virtual ~EnvSensors() {}
+  // Latest readings; never waits for a measurement. capturedMs: millis() at which each channel's
+  // value was captured (for channels read at least once). Returns a bit per EnvChannel (envChannelBit()) that was read
+  // off its sensor since the last call; 0: nothing new.
+  virtual uint8_t read(SensorData& out, uint32_t (&capturedMs)[ENV_CHANNELS]) = 0;
+  // How long read() has nothing to do (0: call it on every pass).
+  virtual uint32_t msUntilDue(uint32_t nowMs) { (void)nowMs; return 0; }
+  // Adaptive: slow down while readings are steady (nobody is watching them live).
+  virtual void setAdaptive(bool adaptive) { (void)adaptive; }
+};
+
+// Accelerometer delivering samples at a fixed rate.
+class MotionSensor {
+public:
+  virtual ~MotionSensor() {}
+  virtual bool available() = 0;
+  virtual uint16_t rateHz() = 0;
+  // Samples taken since the last call, oldest first (up to max).
+  virtual size_t drain(ImuSample* out, size_t max) = 0;
+  // Longest gap between drains that loses no samples (0: drain on every pass).
+  virtual uint32_t maxDrainIntervalMs() { return 0; }
+};
+
+// Heap and WiFi figures for the diagnostics page and perf summaries.
+class SystemMonitor {
+public:
+  virtual ~SystemMonitor() {}
+  virtual void read(SystemStats& out) = 0;
+};
+
+enum class UiPage : uint8_t { Main, Log, Diag };
+// Presses and gestures App reacts to. Log page: Older/Newer page, Scroll* are vertical
+// flicks (half a page), Hour* horizontal flicks (an hour back/ahead).
+enum class UiButton : uint8_t { None, ViewLog, ViewDiag, Back, LogOlder, LogNewer, ScrollOlder, ScrollNewer, HourOlder, HourNewer };
+
+// Screen, touch and haptics at the level of the pages App shows.
+class Ui {
+public:
+  static constexpr size_t VALUE_ROWS = 5; // Proximity, ambient, white, temperature, humidity
+
+  virtual ~Ui() {}
+  // Clears the screen and draws the page's static parts (labels, buttons).
+  virtual void showPage(UiPage page) = 0;
+  virtual void setClock(const char* text) = 0;
+  virtual void setValue(size_t row, const char* text) = 0;
+  virtual size_t logRows() = 0;
+  virtual void setLogStatus(const char* text) = 0; // Position in the log, next to the title
+  virtual void setLogRow(size_t row, const char* time, const char* event) = 0;
+  virtual size_t diagRows() = 0;
+  virtual void setDiagRow(size_t row, const char* label, const char* value) = 0;
+  virtual void showPopup(const char* message) = 0;
+  // False if what the popup covered could not be restored and the page must be redrawn.
+  virtual bool hidePopup() = 0;
+  // Button pressed since the last call (debounced).
+  virtual UiButton pollButton() = 0;
+  virtual void setVibration(uint8_t intensity) = 0;
+  // False while the display is off after a spell without touches; nothing needs drawing then.
+  virtual bool awake() { return true; }
+  // Bracket one screen update pass.
+  virtual void beginFrame() {}
+  virtual void endFrame() {}
+};
+
+// HTTP: uploads and cloud state, delivered asynchronously.
+class UploadLink {
+public:
+  virtual ~UploadLink() {}
+  // Non-blocking; false if the upload queue is full.
+  virtual bool submitUpload(const UploadJob& job) = 0;
+  // Non-blocking; true while there are results to consume.
+  virtual bool pollEvent(NetEvent& event) = 0;
+  virtual size_t spooledSamples() = 0;
+  virtual const char* errorString(int16_t httpCode) = 0;
+};
+
+// Append-only history of upload results, oldest first. Records are addressed by a sequence
+// number that keeps counting across reboots; old ones are dropped from the front when the
+// log is full, so first() moves up. Reads cost O(records read), not O(log size).
+class EventLog {
+public:
+  virtual ~EventLog() {}
+  virtual bool append(const EventRecord& record) = 0;
+  virtual uint32_t first() = 0; // Oldest record still kept
+  virtual uint32_t end() = 0;   // One past the newest record
+  // Copies up to count records starting at seq into out; stops at end(). 0 if seq is not kept.
+  virtual size_t read(uint32_t seq, EventRecord* out, size_t count) = 0;
+  // First record stamped at or after epoch (end() if none). Assumes records are in time order.
+  virtual uint32_t seek(uint32_t epoch) = 0;
+};
+
+// Debug output (Serial on the device, stdout on the host).
+void logPrintf(const char* format, ...) __attribute__((format(printf, 1, 2)));
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <Arduino.h>
+#include <WiFiClientSecure.h>
+#include <HTTPClient.h>
+
+// Timing of the most recent request made through an HttpSession.
+struct HttpTiming {
+  uint32_t handshakeMs = 0; // TCP + TLS connect, 0 when the open connection was reused
+  uint32_t transferMs = 0;  // Request sent -> response headers received
+  bool reused = false;      // True if no new connection had to be opened
+};
+
+struct HttpHeader {
+  const char* name;
+  const char* value;
+};
+
+// One long-lived, keep-alive HTTP(S) connection to a single endpoint.
+//
+// Fixed-buffer requests (uploads): the request head is formatted into a preallocated
+// buffer and the response is parsed in place, so a request over an open connection
+// makes no heap allocation:
+//   HttpHeader headers[] = { { "Content-Type", "application/json" } };
+//   int code = session.request("POST", headers, 1, body, bodyLen);
+//
+// HTTPClient requests (streamed responses, response headers):
+//   if (session.begin("?userId=x")) {
+//     session.http().addHeader(...);
+//     int code = session.sendRequest("GET");
+//     ... read session.http() body ...
+//     session.end();   // Keeps the socket open for the next call
+//   }
+//
+// The connection is opened lazily and only re-established when the server or
+// the network closed it, so a periodic call costs one round-trip instead of a
+// full TLS handshake. Plain http:// URLs (e.g. a local stand-in backend) skip TLS.
+class HttpSession {
+public:
+  static constexpr size_t URL_CAPACITY = 192;
+  static constexpr size_t HEAD_CAPACITY = 768;         // Request line + headers (M5-Details is the big one)
+  static constexpr uint32_t RESPONSE_TIMEOUT_MS = HTTPCLIENT_DEFAULT_TCP_TIMEOUT;
+
+  explicit HttpSession(const char* baseUrl);
+
+  // Sends method + headers + body to baseUrl and reads the response (the body is discarded).
+  // Returns the HTTP status or a negative HTTPC_ERROR_* code. Retries once on a fresh
+  // connection if a reused one went stale.
+  int request(const char* method, const HttpHeader* headers, size_t headerCount, const uint8_t* body, size_t bodyLen);
+
+  // Prepares an HTTPClient request to baseUrl + suffix, connecting first if needed.
+  bool begin(const char* urlSuffix = "");
+  HTTPClient& http() { return _http; }
+  // Sends the request; retries once on a fresh connection if a reused one went stale.
+  int sendRequest(const char* method, const uint8_t* body = nullptr, size_t bodyLen = 0);
+  // Finishes the request. The socket stays open unless the server asked to close it.
+  void end();
+  // Opens the connection ahead of the first request (e.g. right after WiFi comes up).
+  bool preconnect() { return ensureConnected(); }
+  // Drops the connection (e.g. after WiFi loss).
+  void close();
+
+  bool connected() { return _client->connected(); }
+  bool secure() const { return _client == &_secureClient; }
+  const HttpTiming& lastTiming() const { return _timing; }
+  uint32_t requestCount() const { return _requests; }
+  uint32_t handshakeCount() const { return _handshakes; }
+  const char* host() const { return _host; }
+
+private:
+  bool ensureConnected();
+  bool formatHead(const char* method, const HttpHeader* headers, size_t headerCount, size_t bodyLen);
+  int exchange(const uint8_t* body, size_t bodyLen);
+  int readResponse();
+  int readLine(uint32_t deadline);
+  int discard(size_t length, uint32_t deadline);
+
+  char _baseUrl[URL_CAPACITY] = "";
+  char _url[URL_CAPACITY] = "";
+  char _host[64] = "";
+  const char* _path = "/";       // Points into _baseUrl
+  uint16_t _port = 443;
+  bool _defaultPort = true;
+  WiFiClientSecure _secureClient;
+  WiFiClient _plainClient;
+  WiFiClient* _client = &_secureClient;
+  HTTPClient _http;
+  char _head[HEAD_CAPACITY];
+  size_t _headLen = 0;
+  char _line[128];               // Response status/header line, also the scratch buffer for skipped bodies
+  bool _keepAlive = true;        // Last response allows reusing the connection
+  HttpTiming _timing;
+  uint32_t _requests = 0;
+  uint32_t _handshakes = 0;
+};
+
+// Static text for a negative HTTPC_ERROR_* code (HTTPClient::errorToString builds a String).
+const char* httpErrorName(int code);
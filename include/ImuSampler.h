@@ -0,0 +1,43 @@
+#pragma once
+
+#include <M5Unified.h>
+#include "Hal.h"
+
+// Fixed-rate accelerometer sampling. On the Core2's MPU6886 the chip samples into its
+// own 1 KB FIFO at rateHz and drain() reads everything queued since the last call in
+// one I2C burst, so loop() jitter (drawing, touch) no longer decides when samples are
+// taken. Any other IMU falls back to one getAccelData() per drain(), i.e. per loop() pass.
+// Called from loop() only: the internal I2C bus is shared with touch and the PMIC.
+class ImuSampler : public MotionSensor {
+public:
+  static constexpr size_t MAX_DRAIN = 64; // Samples per drain() (FIFO holds 128 accel + temp packets)
+
+  // pollRateHz: how often drain() is called, the effective rate without a FIFO
+  bool begin(uint16_t rateHz, uint16_t pollRateHz);
+  // Reads queued samples into out (up to max); returns how many.
+  size_t drain(ImuSample* out, size_t max) override;
+  bool available() override { return M5.Imu.isEnabled(); }
+  uint16_t rateHz() override { return _rateHz; }
+  // FIFO: two thirds of the time it takes to fill (~425 ms at 200 Hz); polling: the poll period.
+  uint32_t maxDrainIntervalMs() override;
+
+  bool usingFifo() const { return _fifo; }
+  uint32_t samples() const { return _samples; }
+  uint32_t overflows() const { return _overflows; } // FIFO filled up between drains (loop stalled)
+  uint16_t maxBacklog() const { return _maxBacklog; } // Most packets found queued at one drain()
+  void resetStats() { _maxBacklog = 0; }
+
+private:
+  bool writeReg(uint8_t reg, uint8_t value);
+  bool readRegs(uint8_t reg, uint8_t* out, size_t len);
+  void resetFifo();
+
+  bool _fifo = false;
+  uint16_t _rateHz = 0;
+  uint16_t _pollRateHz = 0;
+  float _lsbPerG = 4096.0f;
+  uint32_t _nextSampleMs = 0;  // Timestamp of the next packet to come out of the FIFO
+  uint32_t _samples = 0;
+  uint32_t _overflows = 0;
+  uint16_t _maxBacklog = 0;
+};
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "SensorData.h"
+
+#ifdef ARDUINO
+#include <Arduino.h>
+inline uint32_t profilerTicks() { return ESP.getCycleCount(); } // CPU cycles (CCOUNT, wraps every ~18 s at 240 MHz)
+#else // Native build: nanoseconds
+#include <chrono>
+inline uint32_t profilerTicks() {
+  return (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+#endif
+
+// Log-linear histogram of non-negative integers: exact below 8, then 4 buckets per
+// power of two (values reported within 25% of the truth). Fixed size, no allocation.
+class LatencyHistogram {
+public:
+  static constexpr size_t BUCKETS = 8 + 21 * 4; // Up to 2^24 (16.7 s in us)
+
+  void record(uint32_t value);
+  void reset();
+  uint32_t count() const { return _count; }
+  uint32_t max() const { return _max; }
+  // Upper bound of the bucket holding the p-th fraction of values (p in 0..1), capped at max()
+  uint32_t percentile(float p) const;
+
+private:
+  static size_t bucketOf(uint32_t value);
+  static uint32_t bucketUpper(size_t bucket);
+
+  uint32_t _counts[BUCKETS] = {};
+  uint32_t _count = 0;
+  uint32_t _max = 0;
+};
+
+// Per-stage loop() timing plus upload latency/status and heap/RSSI watermarks,
+// collected over fixed windows. Each stage costs one tick read and a bucket increment:
+//   uint32_t t = prof.now(); handleTouch(); t = prof.lap(LoopStage::Touch, t); ...
+class LoopProfiler {
+public:
+  void begin(uint32_t nowMs);
+  uint32_t now() const { return profilerTicks(); }
+  // Records the time since `start` against `stage` and returns the current tick count.
+  uint32_t lap(LoopStage stage, uint32_t start);
+  // For spans the tick counter does not cover: it stops in light sleep (LoopStage::Idle).
+  void recordUs(LoopStage stage, uint32_t us) { _stages[(size_t)stage].record(us); }
+  // The CPU clock was changed between passes: ticks per microsecond follow it.
+  void clockChanged();
+
+  // One upload attempt: HTTP status or negative transport error, latency if a response came back
+  void recordHttp(int16_t httpCode, uint32_t latencyMs);
+  void recordSystem(const SystemStats& stats);
+
+  // Current window
+  const LatencyHistogram& stage(LoopStage stage) const { return _stages[(size_t)stage]; }
+  const LatencyHistogram& http() const { return _http; }
+  uint16_t httpOk() const { return _httpOk; }
+  uint16_t httpFailed() const { return _http4xx + _http5xx + _httpErr; }
+  const SystemStats& system() const { return _system; }
+  uint32_t minLargestBlock() const { return _minLargestBlock == UINT32_MAX ? _system.largestBlock : _minLargestBlock; }
+  uint32_t windowAgeMs(uint32_t nowMs) const { return nowMs - _windowStartMs; }
+
+  // Closes the current window into a summary and starts the next one.
+  const PerfSummary& roll(uint32_t nowMs);
+  const PerfSummary& lastSummary() const { return _last; }
+
+private:
+  uint32_t _ticksPerUs = 1;
+  uint32_t _windowStartMs = 0;
+  uint32_t _seq = 0;
+  LatencyHistogram _stages[LOOP_STAGES]; // us
+  LatencyHistogram _http;                // ms
+  uint16_t _httpOk = 0, _http4xx = 0, _http5xx = 0, _httpErr = 0;
+  SystemStats _system = {};
+  uint32_t _minLargestBlock = UINT32_MAX;
+  PerfSummary _last = {};
+};
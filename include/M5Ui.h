@@ -0,0 +1,92 @@
+#pragma once
+
+#include <M5Unified.h>
+#include "Hal.h"
+#include "Renderer.h"
+
+// --- Layout Constants ---
+namespace Layout {
+  const int headerY = 5; const int headerH = 25;
+  const int dataAreaY = 40; const int dataLabelX = 15;
+  const int dataValueX = 160; const int dataRowH = 28; // Slightly reduced row height for space
+
+  // Buttons (at the bottom)
+  const int buttonH = 35;
+  const int buttonY = 240 - buttonH - 5; // Position near bottom
+  const int logButtonX = 10;
+  const int logButtonW = 145;
+  const int backButtonX = 10; // Same position for Back button
+  const int backButtonW = 145;
+  const int diagButtonX = 165; // Next to "View Log" on the main page
+  const int diagButtonW = 145;
+  const int olderButtonX = 165; // Log page paging, next to "Back"
+  const int newerButtonX = 240;
+  const int pageButtonW = 70;
+
+  // Log Page Layout
+  const int logTitleY = 10;
+  const int logStatusX = 170; // Record position, right of the title
+  const int logEntryY = 40;
+  const int logEntryH = 22; // Reduced height for more entries
+  const int logTimestampX = 15;
+  const int logEventX = 153; // Kind, HTTP code, latency ms
+  const int logRows = (buttonY - logEntryY) / logEntryH; // Rows that fit above the Back button
+
+  // Diagnostics Page Layout (denser rows: one per loop stage plus http and heap)
+  const int diagEntryY = 36;
+  const int diagEntryH = 16;
+  const int diagValueX = 111;
+  const int diagRows = (buttonY - diagEntryY) / diagEntryH;
+}
+
+// The Core2's screen, touch panel and vibration motor. Dynamic text lives in
+// sprite-backed fields that only push when their text changes (see Renderer).
+// The display goes to sleep (backlight off) after displayTimeoutMs without a touch;
+// the touch that wakes it is swallowed so it does not press whatever is under it.
+class M5Ui : public Ui {
+public:
+  // displayTimeoutMs: 0 keeps the display on.
+  void begin(const char* userId, unsigned long touchDebounceMs, uint32_t displayTimeoutMs = 0);
+  Renderer& renderer() { return _renderer; }
+
+  void showPage(UiPage page) override;
+  void setClock(const char* text) override { _clockField.set(text); }
+  void setValue(size_t row, const char* text) override { if (row < VALUE_ROWS) _valueFields[row].set(text); }
+  size_t logRows() override { return Layout::logRows; }
+  void setLogStatus(const char* text) override { _logStatusField.set(text); }
+  void setLogRow(size_t row, const char* time, const char* event) override;
+  size_t diagRows() override { return Layout::diagRows; }
+  void setDiagRow(size_t row, const char* label, const char* value) override;
+  void showPopup(const char* message) override;
+  bool hidePopup() override { return _renderer.hidePopup(); }
+  UiButton pollButton() override;
+  void setVibration(uint8_t intensity) override { M5.Power.setVibration(intensity); }
+  bool awake() override { return !_asleep; }
+  void beginFrame() override { _renderer.beginFrame(); }
+  void endFrame() override { _renderer.endFrame(); }
+
+private:
+  void drawMainPage();
+  void drawLogPage();
+  void drawDiagPage();
+  void drawButton(int x, int w, uint16_t fill, const char* label);
+  UiButton pollFlick(const m5::touch_detail_t& t);
+  void sleepDisplay();
+  void wakeDisplay();
+
+  const char* _userId = "";
+  unsigned long _touchDebounceMs = 0;
+  unsigned long _lastTouchTime = 0;
+  uint32_t _displayTimeoutMs = 0;
+  uint32_t _lastActivityMs = 0;
+  bool _asleep = false;
+  bool _swallowTouch = false;   // The touch that woke the display, until it is released
+  uint8_t _brightness = 0;      // Restored on wake
+  UiPage _page = UiPage::Main;
+  Renderer _renderer;
+  TextField _clockField;
+  TextField _valueFields[VALUE_ROWS];
+  TextField _logStatusField;
+  TextField _logRowFields[Layout::logRows];
+  TextField _diagRowFields[Layout::diagRows];
+};
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "SensorData.h"
+
+struct MotionConfig {
+  float sampleRateHz;
+  float shakeRmsG;      // Windowed RMS of dynamic acceleration that starts an event
+  float impactPeakG;    // Total |a| that starts an event on its own (short knocks)
+  uint32_t releaseMs;   // RMS must stay below half of shakeRmsG this long to end an event
+  uint32_t minShakeMs;  // Shorter events are reported as impacts
+  uint32_t maxEventMs;  // Long shakes are closed and reported at this length
+  uint32_t cooldownMs;  // No new event this soon after the previous one ended
+};
+
+// Streaming shake/impact detector fed with raw accelerometer samples at a fixed rate.
+// Per sample it removes gravity with a slow low-pass, then updates over a sliding
+// window of WINDOW samples: RMS (running sum of squares), peak |a| and peak jerk
+// (monotonic max queues) and a sliding DFT per axis whose summed power gives the
+// dominant frequency. All updates are O(1) per sample except the DFT (3 x WINDOW/2 bins).
+class MotionAnalyzer {
+public:
+  static constexpr size_t WINDOW = 64; // 320 ms at 200 Hz
+  static constexpr size_t BINS = WINDOW / 2;
+
+  enum class Result : uint8_t { None, Onset, Completed };
+
+  void begin(const MotionConfig& config);
+  // Feeds one sample (g). Onset: an event just started; Completed: lastEvent() is ready.
+  Result addSample(float ax, float ay, float az, uint32_t tMs);
+
+  bool active() const { return _active; }
+  const MotionEvent& lastEvent() const { return _event; }
+
+  // Current window features
+  float rms() const;
+  float peak() const { return _peak.max(); }
+  float peakJerk() const { return _jerk.max(); }
+  float dominantFrequency() const;
+
+private:
+  // Sliding-window maximum: candidates kept in decreasing order, expired by sample number
+  struct WindowMax {
+    float value[WINDOW]; uint32_t seq[WINDOW];
+    size_t head = 0, count = 0;
+    void reset() { head = 0; count = 0; }
+    void push(float v, uint32_t n);
+    float max() const { return count ? value[head] : 0.0f; }
+  };
+
+  MotionConfig _cfg = {};
+  float _gravityAlpha = 0.0f;
+  float _gx = 0, _gy = 0, _gz = 0;         // Gravity estimate
+  float _lx = 0, _ly = 0, _lz = 0;         // Previous sample, for jerk
+  bool _primed = false;
+  uint32_t _n = 0;                         // Samples seen
+
+  float _dyn[WINDOW] = {};                 // Dynamic magnitude ring (RMS)
+  float _axis[3][WINDOW] = {};             // Dynamic acceleration per axis (DFT input; signed, so no rectified 2f)
+  size_t _pos = 0;
+  double _sumSq = 0;
+  WindowMax _peak, _jerk;
+
+  float _twRe[BINS + 1] = {}, _twIm[BINS + 1] = {}; // r * e^(j2πk/N)
+  float _binRe[3][BINS + 1] = {}, _binIm[3][BINS + 1] = {};
+  float _rN = 1.0f;                        // r^N, damping that keeps the sliding DFT stable in float
+
+  bool _active = false;
+  uint32_t _lastLoudMs = 0;                // Last sample whose own dynamic |a| reached shakeRmsG
+  uint32_t _quietSinceMs = 0;
+  bool _quiet = false;
+  uint32_t _lastEndMs = 0;
+  bool _haveEnded = false;
+  MotionEvent _event = {};
+};
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include "SensorData.h"
+#include "UploadPayload.h"
+
+// HTTPClient's "not connected" error (WiFi down), for code that cannot include HTTPClient.h.
+constexpr int16_t NET_ERROR_NOT_CONNECTED = -4;
+constexpr int16_t NET_ERROR_TOO_LESS_RAM = -8; // Also: the request did not fit its buffers
+
+// Whether a failed upload may succeed later: transport errors, 408, 429 and 5xx. Any other 4xx,
+// and a batch too big to build, fails the same way every time it is replayed.
+inline bool uploadRetryable(int16_t httpCode) {
+  if (httpCode < 0) return httpCode != NET_ERROR_TOO_LESS_RAM;
+  return httpCode == 408 || httpCode == 429 || httpCode >= 500;
+}
+
+// Batch handed from loop() to the network task.
+struct UploadJob {
+  const char* triggerEvent; // String literal ("regular", "shake", ...)
+  MotionEvent motion;       // kind None unless the upload was triggered by a motion event
+  PerfSummary perf;         // seq 0 unless a profiling window closed since the last upload
+  uint8_t count;
+  WindowSample samples[MAX_BATCH_SAMPLES];
+};
+
+enum class NetEventType : uint8_t { UploadDone, CloudState, LinkUp };
+
+// Result handed from the network task back to loop().
+struct NetEvent {
+  NetEventType type;
+  bool success;           // UploadDone: 2xx received; LinkUp: always set
+  bool cached;            // LinkUp: reconnected from the cached association, without a scan
+  bool spooled;           // UploadDone: failed, but the samples were saved to the flash queue
+  bool backlog;           // UploadDone: batch replayed from the flash queue, not from loop()
+  bool dropped;           // UploadDone: failed for good (see uploadRetryable()), the samples were discarded
+  bool cloudState;        // CloudState: current "fanState"
+  int16_t httpCode;       // HTTP status or negative HTTPClient error
+  uint8_t count;          // UploadDone: samples in the batch
+  uint16_t bodyBytes;     // UploadDone: request body size (0: nothing was sent)
+  const char* triggerEvent;
+  uint32_t handshakeMs;   // UploadDone: TCP + TLS connect; LinkUp: WiFi association + IP
+  uint32_t transferMs;
+};
+
+// What started an upload, as kept in the event log (the trigger strings are not stored).
+enum class EventKind : uint8_t { Regular, Shake, Impact, CloudState, Backlog, Other };
+
+inline EventKind eventKindOf(const char* triggerEvent) {
+  static const char* const names[] = { "regular", "shake", "impact", "cloud_state_change", "backlog" };
+  if (triggerEvent == nullptr) return EventKind::Regular;
+  for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); ++i) {
+    if (strcmp(triggerEvent, names[i]) == 0) return (EventKind)i;
+  }
+  return EventKind::Other;
+}
+
+inline const char* eventKindLabel(EventKind kind) { // Short enough for a log page row
+  static const char* const labels[] = { "reg", "shake", "impact", "cloud", "replay", "other" };
+  return kind <= EventKind::Other ? labels[(size_t)kind] : "?";
+}
+
+enum EventFlags : uint8_t {
+  EVENT_OK = 1,        // 2xx received
+  EVENT_SPOOLED = 2,   // Failed, samples saved to the flash queue
+  EVENT_BACKLOG = 4,   // Batch replayed from the flash queue
+  EVENT_DROPPED = 8,   // Failed for good, samples discarded
+  EVENT_CORRUPT = 128, // Set by the reader: the stored record failed its check, the other fields are zero
+};
+
+// One upload result in the event log. Fixed size so the log can index records by position.
+struct EventRecord {
+  uint32_t epoch;      // Wall-clock seconds when the result came in (0: clock not set yet)
+  uint16_t epochMs;
+  int16_t httpCode;    // HTTP status or negative HTTPClient error
+  uint16_t latencyMs;  // Handshake + transfer, saturated at 65535
+  uint16_t bodyBytes;
+  EventKind kind;
+  uint8_t flags;       // EventFlags
+  uint8_t count;       // Samples in the batch
+  uint8_t reserved;
+};
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
+#include "HttpSession.h"
+#include "NetTypes.h"
+#include "Hal.h"
+#include "FlashQueue.h"
+#include "WiFiCache.h"
+
+class ClockService;
+
+// What a reconnect may reuse from the last good association (WiFiCache)
+enum class FastConnect : uint8_t {
+  Off,          // Full scan and DHCP every time
+  Channel,      // Straight to the last AP on its channel, DHCP
+  ChannelAndIp  // ...and the last leased IP as a static address, never renewed: needs a DHCP reservation
+};
+
+struct NetWorkerConfig {
+  const char* wifiSsid;
+  const char* wifiPassword;
+  const char* userId;
+  HttpSession* uploadSession;
+  ClockService* clock;           // SNTP is started once WiFi is up
+  FlashQueue* spool;             // Optional: store-and-forward for failed uploads
+  PayloadFormat payloadFormat;   // Offered body encoding; JSON if the server rejects it with 415
+  FastConnect fastConnect;
+};
+
+// Reconnect timing, read by loop() for its status report.
+struct LinkStats {
+  uint32_t connects;
+  uint32_t cachedConnects;     // Connects that skipped the scan (and DHCP) through the cache
+  uint32_t cacheMisses;        // Cached association failed, fell back to a scan
+  uint32_t drops;
+  uint32_t lastConnectMs;      // WiFi.begin() -> IP, last connect
+  uint32_t lastFirstUploadMs;  // Boot or link drop -> first 2xx upload after it (0: none yet)
+};
+
+// Owns the radio: keeps WiFi up and runs uploads in a FreeRTOS task pinned to the
+// protocol core, so loop() only exchanges queue items with it. Cloud state comes
+// from CommandChannel, which reports through the same event queue.
+//
+// Connecting: with a cached association the STA goes straight to the last AP's channel
+// and BSSID (and IP), which takes a few hundred ms instead of a scan plus DHCP; if that
+// fails the cache is dropped and the next attempt scans. Failed connects back off
+// exponentially without ever blocking loop(). Once up, a LinkUp event tells loop() to send
+// what is waiting, and the upload connection is opened before the first batch arrives.
+class NetWorker : public UploadLink {
+public:
+  static constexpr BaseType_t TASK_CORE = 0;     // loop() runs on core 1
+  static constexpr uint32_t TASK_STACK = 12288;  // TLS handshake needs the headroom
+  static constexpr UBaseType_t JOB_QUEUE_DEPTH = 2;
+  static constexpr UBaseType_t EVENT_QUEUE_DEPTH = 8;
+  static constexpr uint32_t BACKLOG_DRAIN_INTERVAL_MS = 1000; // At most one replayed batch per second
+
+  bool begin(const NetWorkerConfig& config);
+  // Non-blocking; false if the job queue is full.
+  bool submitUpload(const UploadJob& job) override;
+  // Non-blocking; true while there are results to consume.
+  bool pollEvent(NetEvent& event) override;
+  // Copy kept by the network task: the FlashQueue itself is only touched from there.
+  size_t spooledSamples() override { return _spooledSamples; }
+  const char* errorString(int16_t httpCode) override;
+  const LinkStats& linkStats() const { return _linkStats; }
+  // Batches the server refused for good, and the samples lost with them.
+  uint32_t droppedBatches() const { return _droppedBatches; }
+  uint32_t droppedSamples() const { return _droppedSamples; }
+  // Non-blocking; used by the network-side tasks to report to loop().
+  bool postEvent(const NetEvent& event);
+
+private:
+  static void taskEntry(void* arg);
+  void run();
+  bool ensureWiFi();
+  bool connect(bool cached);
+  void linkUp(uint32_t startMs, bool cached);
+  void noteUpload(bool success);
+  void doUpload(const UploadJob& job);
+  bool postBatch(const UploadJob& job, NetEvent& ev);
+  void drainBacklog();
+  bool spool(const UploadJob& job);
+  void drop(NetEvent& ev);
+  void failQueuedJobs(int16_t httpCode);
+#ifdef ALLOC_COUNT
+  void checkAllocations(uint64_t allocs);
+#endif
+
+  NetWorkerConfig _cfg = {};
+  QueueHandle_t _jobs = nullptr;
+  QueueHandle_t _events = nullptr;
+  TaskHandle_t _task = nullptr;
+  UploadJob _job;                          // Receive buffer (kept off the task stack)
+  UploadJob _backlogJob;                   // Batch read back from the flash queue
+  char _body[UPLOAD_BODY_CAPACITY];
+  char _details[M5_DETAILS_CAPACITY];      // M5-Details header value
+  PayloadFormat _format = PayloadFormat::Json; // Encoding in use (payloadFormat until the server refuses it)
+  uint32_t _wifiRetryDelayMs = 0;
+  WiFiCache _wifiCache;
+  LinkStats _linkStats = {};
+  bool _linkUp = false;
+  bool _firstUploadPending = true;         // No 2xx since boot or the last drop
+  uint32_t _linkDownMs = 0;                // Boot, or when the link dropped
+  volatile uint32_t _disconnectMs = 0;     // Set by the WiFi event handler
+  volatile bool _connectFailed = false;    // STA_DISCONNECTED during a cached connect
+  volatile uint32_t _spooledSamples = 0;   // FlashQueue::size() after the last append/consume
+  volatile uint32_t _droppedBatches = 0;
+  volatile uint32_t _droppedSamples = 0;
+#ifdef ALLOC_COUNT
+  uint32_t _allocCheckedUploads = 0;
+#endif
+};
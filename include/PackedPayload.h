@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "SensorData.h"
+#include "UploadPayload.h"
+
+// Packed binary upload batch (Content-Type application/x-m5-packed), ~30 bytes per window
+// against ~190 in JSON. Integers are LEB128 varints, signed ones zigzag-encoded, and readings
+// are sent in hundredths (the precision of the JSON body):
+//
+//   "M5" version(2) flags(bit0 motion, bit1 perf)
+//   userId, triggerEvent        varint length + bytes
+//   count                       varint
+//   per window:  epoch          absolute for the first window, then zigzag delta from the previous
+//                epochMs, durationMs, n  varint
+//                reported       1 byte, bit per EnvChannel
+//                per reported channel (EnvChannel order):
+//                  mean         zigzag delta from the same channel's mean earlier in the batch (0 at first)
+//                  mean-min, max-mean, stdDev   varint
+//   motion:  kind(1) durMs n rms peak jerk freq     (rms/peak/freq in hundredths)
+//   perf:    seq winMs passes, LOOP_STAGES x (p50 p99 max), ok 4xx 5xx err p50Ms p99Ms,
+//            free minFree minLargestBlock, rssi (zigzag)
+//
+// Writes into a caller-owned buffer; no heap allocation. Returns the length, or 0 if it did not fit.
+size_t buildBatchPacked(uint8_t* out, size_t outSize, const char* userId, const char* triggerEvent,
+                        const WindowSample* samples, size_t count, const MotionEvent* motion = nullptr,
+                        const PerfSummary* perf = nullptr);
+
+// Decoded batch (server side, host benchmark and tests of the encoder).
+struct PackedBatch {
+  char userId[32];
+  char triggerEvent[24];
+  uint8_t count;
+  WindowSample samples[MAX_BATCH_SAMPLES]; // Channels not reported are left zero
+  bool hasMotion;
+  MotionEvent motion;                      // startMs is not sent
+  bool hasPerf;
+  PerfSummary perf;
+};
+
+// False if the data is truncated, malformed or holds more than MAX_BATCH_SAMPLES windows.
+bool decodeBatchPacked(const uint8_t* data, size_t len, PackedBatch& out);
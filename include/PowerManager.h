@@ -0,0 +1,59 @@
+#pragma once
+
+#include <Arduino.h>
+
+// What loop() is allowed to save power on.
+//   Baseline: fixed delay between passes, full clock (the old behaviour, for comparison)
+//   Active:   display on; block until the next deadline, full clock, WiFi modem sleep
+//   Idle:     display off; lower clock, WiFi max modem sleep, automatic light sleep
+//             while every task is blocked (needs CONFIG_PM_ENABLE and tickless idle)
+enum class PowerMode : uint8_t { Baseline, Active, Idle, Count };
+
+struct PowerConfig {
+  uint32_t baselineLoopMs;   // Baseline: delay() per pass
+  uint32_t maxSleepMs;       // Longest block in wait(): bounds how late network results are picked up
+  uint32_t activeCpuMhz;
+  uint32_t idleCpuMhz;       // 80 keeps the APB clock (and with it I2C/UART timing) unchanged
+  int touchIntPin;           // Touch controller INT (low while touched), wakes the loop; -1: none
+  uint32_t currentSampleMs;  // Battery current sampling period for stats()
+};
+
+// Duty-cycles loop(): instead of delay()-ing a fixed interval it blocks until App's next
+// deadline, woken early by a touch. The block is a FreeRTOS wait, so with power management
+// enabled the idle task can light-sleep the chip for the whole of it; the touch INT is
+// also a light sleep wake source. Loop task only.
+class PowerManager {
+public:
+  struct Stats {
+    float avgMa;      // Mean battery discharge current in the mode (0: no samples)
+    uint32_t seconds; // Time spent in the mode while running on battery
+  };
+
+  void begin(const PowerConfig& config);
+  // True if the CPU clock changed (the loop profiler must be told).
+  bool setMode(PowerMode mode);
+  PowerMode mode() const { return _mode; }
+  // Blocks up to ms (clamped to 1..maxSleepMs) or until the touch panel is pressed.
+  void wait(uint32_t ms);
+  // Samples the battery current now and then; call once per pass.
+  void service(uint32_t nowMs);
+
+  Stats stats(PowerMode mode) const;
+  bool lightSleep() const { return _lightSleep; }
+  uint32_t wakeups() const { return _wakeups; }
+  static const char* modeName(PowerMode mode);
+
+private:
+  static void IRAM_ATTR onTouch(void* arg);
+  void applyClock(uint32_t mhz, bool lightSleep);
+
+  PowerConfig _cfg = {};
+  PowerMode _mode = PowerMode::Baseline;
+  TaskHandle_t _loopTask = nullptr;
+  bool _pm = false;          // esp_pm_configure() works (CONFIG_PM_ENABLE)
+  bool _lightSleep = false;  // ...and automatic light sleep is available
+  uint32_t _wakeups = 0;     // Waits ended early by a touch
+  uint32_t _lastSampleMs = 0;
+  double _mAms[(size_t)PowerMode::Count] = {};  // Discharge current integrated over time, per mode
+  uint32_t _ms[(size_t)PowerMode::Count] = {};
+};
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <M5Unified.h>
+
+class Renderer;
+
+// A fixed screen region backed by an off-screen sprite. It remembers the text it
+// last put on screen and only redraws and pushes its pixels when that changes.
+// An optional second column (e.g. log event next to its timestamp) is drawn at col2X.
+class TextField {
+public:
+  static constexpr size_t MAX_TEXT = 40;
+
+  bool begin(Renderer& renderer, int x, int y, int w, int h, uint16_t fg = TFT_WHITE, uint16_t bg = TFT_BLACK,
+             int padX = 0, int padY = 0, int col2X = 0);
+  // Draws the text if it differs from what is on screen.
+  void set(const char* text, const char* col2 = nullptr);
+  // Forgets the cached text so the next set() redraws (the area was cleared underneath us).
+  void invalidate() { _shown[0] = '\0'; _valid = false; }
+
+  bool overlaps(int x, int y, int w, int h) const {
+    return _x < x + w && x < _x + _w && _y < y + h && y < _y + _h;
+  }
+
+private:
+  friend class Renderer;
+  void push();
+
+  Renderer* _renderer = nullptr;
+  M5Canvas _sprite;
+  bool _hasSprite = false;
+  int _x = 0, _y = 0, _w = 0, _h = 0, _padX = 0, _padY = 0, _col2X = 0;
+  uint16_t _fg = TFT_WHITE, _bg = TFT_BLACK;
+  char _shown[MAX_TEXT * 2 + 2] = "";
+  bool _valid = false;
+  bool _deferred = false; // Changed while covered by the popup; pushed when it closes
+};
+
+// Owns what reaches the panel: TextFields push through it, popups are composited on
+// top of the page and the pixels underneath are restored from a saved copy when the
+// popup closes, so the page never has to be redrawn. Counts pixels pushed per frame.
+class Renderer {
+public:
+  static constexpr size_t MAX_FIELDS = 32;
+
+  void begin(M5GFX& display);
+  M5GFX& display() { return *_display; }
+
+  // Frame accounting: one frame per updateScreenData() pass
+  void beginFrame() { _framePixels = 0; }
+  void endFrame();
+  void countPixels(uint32_t pixels) { _framePixels += pixels; _totalPixels += pixels; }
+  uint32_t lastFramePixels() const { return _lastFramePixels; }
+  uint32_t maxFramePixels() const { return _maxFramePixels; }
+  uint64_t totalPixels() const { return _totalPixels; }
+  uint32_t frames() const { return _frames; }
+  void resetFrameStats() { _maxFramePixels = 0; }
+
+  // Whole-page redraw (page switch): forget every field's cached text
+  void clearScreen(uint16_t color);
+  void invalidateAll();
+
+  void showPopup(const char* message, uint16_t bgColor, uint16_t textColor);
+  // Restores the pixels under the popup; false if they could not be saved and the page must be redrawn.
+  bool hidePopup();
+  bool popupVisible() const { return _popupVisible; }
+
+private:
+  friend class TextField;
+  void registerField(TextField* field);
+  // Pushes a field's sprite unless the popup covers it (then it is deferred)
+  void pushField(TextField& field);
+
+  M5GFX* _display = nullptr;
+  TextField* _fields[MAX_FIELDS] = {};
+  size_t _fieldCount = 0;
+
+  M5Canvas _popup;        // Popup contents
+  M5Canvas _popupBehind;  // Panel pixels underneath the popup
+  bool _popupVisible = false;
+  bool _haveBehind = false;
+  int _popupX = 0, _popupY = 0;
+
+  uint32_t _framePixels = 0, _lastFramePixels = 0, _maxFramePixels = 0, _frames = 0;
+  uint64_t _totalPixels = 0;
+};
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "SensorData.h"
+
+// When a batch of buffered samples should be sent.
+struct FlushPolicy {
+  size_t maxSamples;      // Flush once this many windows are waiting
+  uint32_t maxAgeMs;      // ...or once the oldest waiting window is this old
+  uint32_t idleMaxAgeMs;  // maxAgeMs stretches up to this while readings are steady and the screen is off
+};
+
+// Fixed-size ring buffer of window samples, oldest first.
+// When full, new samples overwrite the oldest ones (counted in dropped()).
+template <size_t Capacity>
+class SampleBuffer {
+public:
+  void push(const WindowSample& sample) {
+    if (_count == Capacity) { _head = (_head + 1) % Capacity; _count--; _dropped++; }
+    _items[(_head + _count) % Capacity] = sample;
+    _count++;
+  }
+
+  size_t size() const { return _count; }
+  bool empty() const { return _count == 0; }
+  static constexpr size_t capacity() { return Capacity; }
+  uint32_t dropped() const { return _dropped; }
+
+  uint32_t oldestAgeMs(uint32_t nowMs) const {
+    return empty() ? 0 : nowMs - _items[_head].uptimeMs;
+  }
+
+  // Time until the batch is due under a size limit and an age limit (0: due now).
+  uint32_t msUntilFlush(size_t maxSamples, uint32_t maxAgeMs, uint32_t nowMs) const {
+    if (_count >= maxSamples) return 0;
+    uint32_t age = oldestAgeMs(nowMs);
+    return age >= maxAgeMs ? 0 : maxAgeMs - age;
+  }
+
+  // Copies up to maxCount of the oldest samples into out without removing them.
+  size_t peek(WindowSample* out, size_t maxCount) const {
+    size_t n = (_count < maxCount) ? _count : maxCount;
+    for (size_t i = 0; i < n; ++i) out[i] = _items[(_head + i) % Capacity];
+    return n;
+  }
+
+  // Removes the n oldest samples (after they were uploaded).
+  void consume(size_t n) {
+    if (n > _count) n = _count;
+    _head = (_head + n) % Capacity;
+    _count -= n;
+  }
+
+private:
+  WindowSample _items[Capacity];
+  size_t _head = 0;
+  size_t _count = 0;
+  uint32_t _dropped = 0;
+};
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// One-shot deadlines for the timed work in loop(), one slot per kind of task.
+// Instead of comparing millis() against a last-run time on every pass, a task is
+// armed for the time it is next due; loop() runs the ones that are due and asks
+// next() how long nothing is, which is how long the board may sleep:
+//   sched.after(Task::Popup, now, popupMs);  ...  if (sched.due(Task::Popup, now)) clearPopup();
+template <typename Task, size_t Count>
+class Scheduler {
+public:
+  static constexpr uint32_t NONE = UINT32_MAX; // next(): nothing armed
+
+  void at(Task task, uint32_t dueMs) { Slot& s = _slots[(size_t)task]; s.dueMs = dueMs; s.armed = true; }
+  void after(Task task, uint32_t nowMs, uint32_t delayMs) { at(task, nowMs + delayMs); }
+  // Arms the task unless it is already due earlier.
+  void notLater(Task task, uint32_t nowMs, uint32_t delayMs) {
+    const Slot& s = _slots[(size_t)task];
+    if (!s.armed || (int32_t)(nowMs + delayMs - s.dueMs) < 0) after(task, nowMs, delayMs);
+  }
+  void cancel(Task task) { _slots[(size_t)task].armed = false; }
+  bool armed(Task task) const { return _slots[(size_t)task].armed; }
+
+  // True once if the task is due; it stays disarmed until armed again.
+  bool due(Task task, uint32_t nowMs) {
+    Slot& s = _slots[(size_t)task];
+    if (!s.armed || (int32_t)(nowMs - s.dueMs) < 0) return false;
+    s.armed = false;
+    return true;
+  }
+
+  // Milliseconds until the earliest armed task is due (0: overdue), NONE if none is armed.
+  uint32_t next(uint32_t nowMs) const {
+    uint32_t best = NONE;
+    for (const Slot& s : _slots) {
+      if (!s.armed) continue;
+      int32_t left = (int32_t)(s.dueMs - nowMs);
+      uint32_t ms = left > 0 ? (uint32_t)left : 0;
+      if (ms < best) best = ms;
+    }
+    return best;
+  }
+
+private:
+  struct Slot { uint32_t dueMs; bool armed; };
+  Slot _slots[Count] = {};
+};
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Sensor Data Structure
+struct SensorData {
+  uint16_t prox; uint16_t ambientLight; uint16_t whiteLight;
+  float temp; float rHum;
+};
+
+// Environment channels, in SensorData field order.
+enum class EnvChannel : uint8_t { Prox, AmbientLight, WhiteLight, Temp, RHum, Count };
+constexpr size_t ENV_CHANNELS = (size_t)EnvChannel::Count;
+
+inline const char* envChannelName(EnvChannel ch) { // Also the upload JSON keys
+  static const char* const names[ENV_CHANNELS] = { "prox", "al", "wl", "temp", "rHum" };
+  return ch < EnvChannel::Count ? names[(size_t)ch] : "?";
+}
+
+constexpr uint8_t envChannelBit(EnvChannel ch) { return (uint8_t)(1 << (size_t)ch); }
+
+inline float envChannelValue(const SensorData& d, EnvChannel ch) {
+  switch (ch) {
+    case EnvChannel::Prox: return d.prox;
+    case EnvChannel::AmbientLight: return d.ambientLight;
+    case EnvChannel::WhiteLight: return d.whiteLight;
+    case EnvChannel::Temp: return d.temp;
+    case EnvChannel::RHum: return d.rHum;
+    default: return 0.0f;
+  }
+}
+
+// One channel over an aggregation window.
+struct ChannelStats { float min, max, mean, stdDev; };
+
+// Statistics of every reading taken in one aggregation window, stamped at the window's end
+// (see WindowAggregator). The unit that is buffered, spooled to flash and uploaded.
+struct WindowSample {
+  uint32_t epoch;      // Wall-clock seconds (local offset applied)
+  uint32_t uptimeMs;   // millis() at the end of the window, used for batch age
+  uint32_t durationMs;
+  uint16_t count;      // Readings of the most-read channel (each channel's stats cover its own readings)
+  uint16_t epochMs;    // Millisecond part of the end time
+  uint8_t reported;    // Bit per EnvChannel that is sent: moved past its deadband, or heartbeat due
+  uint8_t reserved[3];
+  ChannelStats stats[ENV_CHANNELS];
+};
+
+// One accelerometer reading.
+struct ImuSample {
+  float ax, ay, az;  // g
+  uint32_t tMs;      // When it was taken (reconstructed from the sample rate for FIFO data)
+};
+
+enum class MotionKind : uint8_t { None, Shake, Impact };
+
+// Feature summary of one detected motion event (see MotionAnalyzer).
+struct MotionEvent {
+  MotionKind kind;
+  uint32_t startMs;    // millis() at onset
+  uint16_t durationMs;
+  uint16_t samples;    // IMU samples the event spanned
+  float rmsG;          // Largest windowed RMS of dynamic acceleration (gravity removed)
+  float peakG;         // Largest total |a|
+  float jerkGps;       // Largest |da/dt|, g/s
+  float freqHz;        // Dominant frequency of the window with the largest RMS
+};
+
+inline const char* motionKindName(MotionKind kind) {
+  return kind == MotionKind::Shake ? "shake" : kind == MotionKind::Impact ? "impact" : "none";
+}
+
+// Stages of one loop() pass timed by LoopProfiler, in the order they run.
+enum class LoopStage : uint8_t { Board, Touch, Net, Imu, Sensors, Screen, Upload, Idle, Count };
+constexpr size_t LOOP_STAGES = (size_t)LoopStage::Count;
+
+inline const char* loopStageName(LoopStage stage) {
+  static const char* const names[LOOP_STAGES] = { "board", "touch", "net", "imu", "sensors", "screen", "upload", "idle" };
+  return stage < LoopStage::Count ? names[(size_t)stage] : "?";
+}
+
+// Heap and radio snapshot (ESP heap_caps / WiFi on the device).
+struct SystemStats {
+  uint32_t freeHeap;
+  uint32_t minFreeHeap;   // Lowest free heap since boot
+  uint32_t largestBlock;  // Largest allocatable block
+  int8_t rssi;            // dBm, 0 when not connected
+};
+
+// Performance of one profiling window, sent with the next upload (see LoopProfiler).
+struct PerfSummary {
+  uint32_t seq;            // Window number since boot, 0: no summary
+  uint32_t windowMs;
+  uint32_t passes;         // loop() passes in the window
+  struct { uint32_t p50Us, p99Us, maxUs; } stages[LOOP_STAGES];
+  uint16_t httpOk, http4xx, http5xx, httpErr; // Upload responses; httpErr: no response (transport error)
+  uint32_t httpP50Ms, httpP99Ms;              // Handshake + transfer, responses only
+  uint32_t freeHeap, minFreeHeap;
+  uint32_t minLargestBlock; // Smallest largest-free-block seen in the window
+  int8_t rssi;
+};
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "Hal.h"
+#include "SensorData.h"
+
+// One acquisition channel: a sensor, or a group of its registers read together.
+// Conversions are started by trigger() and picked up by collect() once they are done,
+// so no channel ever waits on the bus for a measurement.
+class SensorChannel {
+public:
+  virtual ~SensorChannel() {}
+  virtual const char* name() const = 0;
+  // Bit per EnvChannel (envChannelBit()) whose field in SensorData collect() writes.
+  virtual uint8_t channels() const = 0;
+  // Starts a conversion. waitMs: how long until collect() can succeed (0: right away).
+  // False on a bus error.
+  virtual bool trigger(uint32_t& waitMs) = 0;
+  // Stores the finished conversion in the fields of `out` this channel owns.
+  // False if the result is not there yet (retried) or failed its check.
+  virtual bool collect(SensorData& out) = 0;
+};
+
+struct SensorChannelStats {
+  uint32_t reads;
+  uint32_t errors;      // Bus errors and conversions that never arrived
+};
+
+// Runs every registered channel at its own period from loop(): triggers due
+// conversions and collects finished ones on later passes. A pass that has nothing
+// due touches no bus at all. Adding a sensor is one add() call.
+//
+// Adaptive mode (while nobody watches the screen): a channel whose readings stay within
+// the deadbands doubles its period after each conversion, up to its maxPeriodMs, and
+// drops back to its base period as soon as a reading moves.
+class SensorHub : public EnvSensors {
+public:
+  static constexpr size_t MAX_CHANNELS = 6;
+
+  explicit SensorHub(Clock& clock) : _clock(clock) {}
+  // maxPeriodMs: longest period in adaptive mode (0: always periodMs).
+  bool add(SensorChannel& channel, uint32_t periodMs, uint32_t maxPeriodMs = 0);
+  // Per EnvChannel: how far a reading must move to count as a change (adaptive mode).
+  void setDeadbands(const float (&deadband)[ENV_CHANNELS]);
+
+  // Non-blocking: advances the channels, then copies the latest readings.
+  uint8_t read(SensorData& out, uint32_t (&capturedMs)[ENV_CHANNELS]) override;
+  uint32_t msUntilDue(uint32_t nowMs) override;
+  void setAdaptive(bool adaptive) override;
+  void service();
+
+  size_t channelCount() const { return _count; }
+  const char* channelName(size_t i) const { return _slots[i].channel->name(); }
+  const SensorChannelStats& channelStats(size_t i) const { return _slots[i].stats; }
+  uint32_t channelPeriod(size_t i) const { return _slots[i].periodMs; }
+
+private:
+  struct Slot {
+    SensorChannel* channel;
+    uint32_t periodMs;    // Current period
+    uint32_t basePeriodMs, maxPeriodMs;
+    uint32_t nextMs;      // Next trigger
+    uint32_t readyMs;     // Pending conversion can be collected from here on
+    bool pending;
+    float ref[ENV_CHANNELS]; // Readings when the channel last changed (adaptive mode)
+    SensorChannelStats stats;
+  };
+  void collect(Slot& slot, uint32_t now);
+  void adapt(Slot& slot);
+
+  Clock& _clock;
+  Slot _slots[MAX_CHANNELS] = {};
+  size_t _count = 0;
+  SensorData _data = {};
+  uint8_t _updated = 0;    // Channels collected since the last read()
+  uint32_t _capturedMs[ENV_CHANNELS] = {}; // When each channel's conversion finished
+  bool _adaptive = false;
+  float _deadband[ENV_CHANNELS] = {};
+};
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <ArduinoJson.h>
+
+// The get-device-state protocol of CommandChannel::checkCloudCommand() without the HTTP client:
+// the request query, If-None-Match bookkeeping, the "fanState" body and which states are news.
+// Portable, so the host fleet bench (src/fleet/) polls the stand-in backend exactly like a device.
+class StatePoll {
+public:
+  static constexpr int HTTP_OK = 200;
+  static constexpr int HTTP_NOT_MODIFIED = 304;
+  // One member plus its key, copied when parsing from a read-only buffer or a Stream. Sized with
+  // JSON_OBJECT_SIZE() rather than a byte count so it also fits the 64-bit host's bigger slots.
+  static constexpr size_t DOC_CAPACITY = JSON_OBJECT_SIZE(1) + sizeof("fanState");
+
+  enum class Outcome : uint8_t {
+    NotModified, // 304: unchanged, nothing to parse
+    Parsed,      // 200 with a "fanState"; see state()
+    BadBody,     // 200 that did not parse or lacks "fanState"
+    Failed,      // Any other status or no response
+  };
+
+  // "?userId=X" for a plain conditional GET, "?userId=X&wait=N" for a long-poll (waitS > 0).
+  // Returns the length, or 0 if it did not fit.
+  static size_t query(char* out, size_t outSize, const char* userId, uint32_t waitS);
+
+  // If-None-Match value for the next request; empty until a 200 carried an ETag.
+  const char* etag() const { return _etag; }
+  void setEtag(const char* etag, size_t length);
+  void setEtag(const char* etag) { setEtag(etag, strlen(etag)); }
+
+  // Reads "fanState" from a response body: a char buffer, or a Stream parsed in place on the device.
+  template <typename Input>
+  DeserializationError parse(Input&& in, bool& state, bool& hasKey) {
+    StaticJsonDocument<DOC_CAPACITY> filter;
+    filter["fanState"] = true;
+    StaticJsonDocument<DOC_CAPACITY> doc;
+    DeserializationError error = deserializeJson(doc, in, DeserializationOption::Filter(filter));
+    hasKey = !error && doc.containsKey("fanState");
+    if (hasKey) state = doc["fanState"];
+    return error;
+  }
+
+  // One complete response to a query() with its body read (NUL-terminated): parses the body of a
+  // 200 and takes its ETag, or clears the ETag if the body was bad.
+  Outcome onResponse(int httpCode, const char* etag, const char* body);
+  bool state() const { return _state; }
+
+  // Only the first state and changes are news; mark one reported once it was delivered.
+  bool isNews(bool state) const { return !_haveReported || state != _reported; }
+  void markReported(bool state) { _haveReported = true; _reported = state; }
+  bool hasReported() const { return _haveReported; }
+
+private:
+  char _etag[64] = "";
+  bool _state = false;
+  bool _haveReported = false;
+  bool _reported = false;
+};
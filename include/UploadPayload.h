@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stddef.h>
+#include "SensorData.h"
+
+// Both builders write into caller-owned buffers through compile-time-sized JSON documents:
+// no heap allocation on the upload path.
+
+// Largest number of window samples sent in one upload request.
+constexpr size_t MAX_BATCH_SAMPLES = 16;
+// Serialized body size for a full batch (~190 bytes per window plus envelope, motion and perf summaries).
+constexpr size_t UPLOAD_BODY_CAPACITY = 4096;
+// Serialized M5-Details header value (single snapshot plus motion summary).
+constexpr size_t M5_DETAILS_CAPACITY = 384;
+
+// Serializes a batch into `out` as
+//   {"userId":..,"triggerEvent":..,"samples":[{"t":..,"ms":..,"dur":..,"n":..,"<channel>":[mean,min,max,sd],..},..]}
+// with only the channels flagged in each window's `reported` mask (prox, al, wl, temp, rHum),
+// plus "motion":{"kind","durMs","n","rms","peak","jerk","freq"} when the batch carries a motion event
+// and "perf":{"seq","winMs","n","us":{"<stage>":[p50,p99,max],..},"http":[ok,4xx,5xx,err,p50Ms,p99Ms],
+// "heap":[free,minFree,minLargestBlock],"rssi"} when it carries a profiling window summary.
+// Returns the body length, or 0 if it did not fit.
+size_t buildBatchBody(char* out, size_t outSize, const char* userId, const char* triggerEvent,
+                      const WindowSample* samples, size_t count, const MotionEvent* motion = nullptr,
+                      const PerfSummary* perf = nullptr);
+
+// Upload body encodings. The device offers its configured one through Content-Type and falls back
+// to JSON when the server answers 415 Unsupported Media Type (see NetWorker::postBatch).
+enum class PayloadFormat : uint8_t { Json, MsgPack, Packed };
+
+inline const char* payloadContentType(PayloadFormat format) {
+  return format == PayloadFormat::MsgPack ? "application/msgpack"
+       : format == PayloadFormat::Packed ? "application/x-m5-packed" : "application/json";
+}
+
+inline const char* payloadFormatName(PayloadFormat format) {
+  return format == PayloadFormat::MsgPack ? "msgpack" : format == PayloadFormat::Packed ? "packed" : "json";
+}
+
+// The buildBatchBody document as MessagePack (same keys, binary numbers). Returns the length, or 0.
+size_t buildBatchMsgPack(char* out, size_t outSize, const char* userId, const char* triggerEvent,
+                         const WindowSample* samples, size_t count, const MotionEvent* motion = nullptr,
+                         const PerfSummary* perf = nullptr);
+
+// Serializes a batch in the given format (Packed: see PackedPayload.h). Returns the length, or 0.
+size_t buildBatch(PayloadFormat format, char* out, size_t outSize, const char* userId, const char* triggerEvent,
+                  const WindowSample* samples, size_t count, const MotionEvent* motion = nullptr,
+                  const PerfSummary* perf = nullptr);
+
+// Nested vcnlDetails/shtDetails/otherDetails JSON for the M5-Details header (window means of
+// every channel as a single snapshot). Returns the value length, or 0 if it did not fit.
+size_t generateM5DetailsHeader(char* out, size_t outSize, const WindowSample& sample, const char* userId,
+                               const char* triggerEvent = nullptr, const MotionEvent* motion = nullptr);
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <Arduino.h>
+
+// The last good association (AP channel and BSSID, IP configuration) in NVS, so that a
+// reconnect after a reboot or a drop can skip the all-channel scan and the DHCP exchange:
+//   WiFi.config(ip, gateway, subnet, dns); WiFi.begin(ssid, password, channel, bssid);
+// An entry only applies to the SSID it was stored for. It is only written when the
+// association changes (new AP, channel or lease), so steady reconnects cost no flash writes.
+// Network task only.
+class WiFiCache {
+public:
+  struct Entry {
+    uint32_t ssidHash;
+    uint8_t channel;
+    uint8_t bssid[6];
+    uint32_t ip, gateway, subnet, dns; // Network byte order, as IPAddress holds them
+  };
+
+  // Reads the entry stored for ssid; false if there is none.
+  bool load(const char* ssid);
+  // Stores the current association of the STA interface if it differs from the cached one.
+  void store(const char* ssid);
+  // Drops the entry after it failed to connect; the next connect scans and uses DHCP.
+  void invalidate();
+
+  bool valid() const { return _valid; }
+  const Entry& entry() const { return _entry; }
+
+private:
+  static uint32_t hash(const char* text);
+
+  Entry _entry = {};
+  bool _valid = false;
+};
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "SensorData.h"
+
+// Running min/max/mean/variance in constant memory (Welford's update: one pass, no
+// catastrophic cancellation in float).
+class RunningStats {
+public:
+  void add(float x) {
+    _n++;
+    float delta = x - _mean;
+    _mean += delta / _n;
+    _m2 += delta * (x - _mean);
+    if (_n == 1 || x < _min) _min = x;
+    if (_n == 1 || x > _max) _max = x;
+  }
+  void reset() { *this = RunningStats(); }
+
+  uint32_t count() const { return _n; }
+  float mean() const { return _mean; }
+  float variance() const { return _n > 1 ? _m2 / (_n - 1) : 0.0f; } // Sample variance
+  float min() const { return _min; }
+  float max() const { return _max; }
+  ChannelStats summary() const;
+
+private:
+  uint32_t _n = 0;
+  float _mean = 0.0f, _m2 = 0.0f;
+  float _min = 0.0f, _max = 0.0f;
+};
+
+struct AggregationConfig {
+  uint32_t windowMs;             // Readings are summarized per window
+  uint32_t heartbeatMs;          // Every channel is sent at least this often, even when steady
+  float deadband[ENV_CHANNELS];  // Send a channel once it moves this far from its last sent mean (0: every window)
+};
+
+// Folds every new reading of a channel into that channel's window statistics and decides at the end of each
+// window which channels are worth sending: those that left the deadband around their last
+// sent mean (the window mean, or a spike within the window), and those whose heartbeat
+// expired. A window with nothing to send is dropped, so steady readings cost no uploads.
+class WindowAggregator {
+public:
+  void begin(const AggregationConfig& config, uint32_t nowMs);
+  // Folds the channels flagged in `channels` (envChannelBit()); the others were not read since.
+  void add(const SensorData& data, uint8_t channels);
+
+  bool due(uint32_t nowMs) const { return nowMs - _windowStartMs >= _cfg.windowMs; }
+  // Readings of the most-read channel in the window.
+  uint32_t readings() const;
+
+  // Summarizes the window into out (all but epoch) and starts the next one. force: send every
+  // channel read in the window (event uploads). False if the window was empty or nothing in it
+  // needs sending. A channel without readings in the window is never sent.
+  bool close(uint32_t nowMs, bool force, WindowSample& out);
+
+  // Channels that left their deadband in the last closed window (not counting heartbeats or force).
+  uint8_t lastMoved() const { return _moved; }
+  uint32_t windows() const { return _windows; }
+  uint32_t sentWindows() const { return _sent; }
+  uint32_t channelsSent(EnvChannel ch) const { return _channelsSent[(size_t)ch]; }
+
+private:
+  AggregationConfig _cfg = {};
+  RunningStats _stats[ENV_CHANNELS];
+  uint32_t _windowStartMs = 0;
+  float _lastSentMean[ENV_CHANNELS] = {};
+  uint32_t _lastSentMs[ENV_CHANNELS] = {};
+  uint8_t _everSent = 0;         // Bit per channel sent at least once
+  uint8_t _moved = 0;
+  uint32_t _windows = 0;
+  uint32_t _sent = 0;
+  uint32_t _channelsSent[ENV_CHANNELS] = {};
+};
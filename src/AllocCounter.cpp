@@ -0,0 +1,35 @@
+#if defined(ARDUINO) && defined(ALLOC_COUNT)
+#include "AllocCounter.h"
+#include <stdlib.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+// The linker redirects every malloc/calloc/realloc call to these (-Wl,--wrap=...).
+extern "C" {
+  void* __real_malloc(size_t size);
+  void* __real_calloc(size_t n, size_t size);
+  void* __real_realloc(void* p, size_t size);
+}
+
+namespace {
+  volatile TaskHandle_t watchedTask = nullptr;
+  volatile uint32_t allocCount = 0; // Only the watched task writes these
+  volatile uint32_t allocBytes = 0;
+
+  inline void note(size_t size) {
+    if (watchedTask != nullptr && xTaskGetCurrentTaskHandle() == watchedTask) { allocCount++; allocBytes += size; }
+  }
+}
+
+extern "C" {
+  void* __wrap_malloc(size_t size) { note(size); return __real_malloc(size); }
+  void* __wrap_calloc(size_t n, size_t size) { note(n * size); return __real_calloc(n, size); }
+  void* __wrap_realloc(void* p, size_t size) { note(size); return __real_realloc(p, size); }
+}
+
+namespace AllocCounter {
+  uint64_t count() { return allocCount; }
+  uint64_t bytes() { return allocBytes; }
+  void watchCurrentTask() { watchedTask = xTaskGetCurrentTaskHandle(); }
+}
+#endif
@@ -0,0 +1,466 @@
+#include "App.h"
+#include <stdio.h>
+#include <string.h>
+
+namespace {
+  void formatTimestamp(time_t epochTime, char* out, size_t outSize) {
+    if (epochTime == 0) { snprintf(out, outSize, "No Time"); return; }
+    struct tm timeinfo;
+    gmtime_r(&epochTime, &timeinfo); // Epoch already carries the local offset
+    strftime(out, outSize, "%m/%d %H:%M", &timeinfo);
+  }
+}
+
+void App::begin(const AppConfig& config, const AppHal& hal) {
+  _cfg = config; _hal = hal;
+  if (_hal.imu->available()) {
+    MotionConfig motion = _cfg.motion;
+    motion.sampleRateHz = _hal.imu->rateHz();
+    _motion.begin(motion);
+  }
+  uint32_t now = _hal.clock->millis();
+  _prof.begin(now);
+  _aggregator.begin(_cfg.aggregation, now);
+  _sched.after(AppTask::Window, now, _cfg.aggregation.windowMs);
+  _sched.after(AppTask::Diagnostics, now, SYSTEM_READ_MS);
+  drawScreen(); // Draw the initial page (Main Page)
+  updateSensors();
+  updateMainPageData(); // Update dynamic data on initial page
+}
+
+void App::loop() {
+  uint32_t t = _prof.now();
+  handleTouch(); // Process button presses for navigation
+  updateAwake(_hal.clock->millis());
+  t = _prof.lap(LoopStage::Touch, t);
+  handleNetEvents(); // Upload results and cloud state changes from the network task
+  t = _prof.lap(LoopStage::Net, t);
+  updateVibration();
+  if (_hal.imu->available()) processImu(); // On every page: samples keep coming regardless of the UI
+  t = _prof.lap(LoopStage::Imu, t);
+
+  // --- Run Checks and Updates ---
+  uint32_t now = _hal.clock->millis();
+  updateSensors(); // Cheap when nothing is due: each sensor is read at its own rate, never waited on
+  t = _prof.lap(LoopStage::Sensors, t);
+
+  updateScreenData(); // Update screen based on the current page, handles popup clearing
+  t = _prof.lap(LoopStage::Screen, t);
+
+  // --- Timed Actions ---
+
+  // Aggregation window: buffer its statistics if a channel moved or is due a heartbeat
+  if (_sched.due(AppTask::Window, now)) closeWindow(false);
+
+  // Closes the profiling window in time for the flush below
+  if (_sched.due(AppTask::Diagnostics, now)) updateDiagnostics(now);
+
+  // Batch Flush: armed by scheduleFlush() whenever the buffer or the upload state changes
+  if (_sched.due(AppTask::Flush, now)) flushUploads(); // The result is logged when the network task reports back
+  _prof.lap(LoopStage::Upload, t);
+}
+
+uint32_t App::msUntilDue() {
+  uint32_t now = _hal.clock->millis();
+  uint32_t ms = _sched.next(now);
+  uint32_t sensors = _hal.sensors->msUntilDue(now);
+  if (sensors < ms) ms = sensors;
+  if (_hal.imu->available()) {
+    uint32_t imu = _hal.imu->maxDrainIntervalMs();
+    if (imu < ms) ms = imu;
+  }
+  return ms;
+}
+
+// --- Sensors & Uploads ---
+
+void App::updateSensors() {
+  uint8_t updated = _hal.sensors->read(_currentData, _capturedMs);
+  if (updated) _aggregator.add(_currentData, updated); // Only channels read since the last pass count
+  _readChannels |= updated;
+}
+
+// Ends the aggregation window and buffers it, stamped at its end, unless nothing in it needs sending
+void App::closeWindow(bool force) {
+  uint32_t now = _hal.clock->millis();
+  if (force && _aggregator.readings() == 0) _aggregator.add(_currentData, recentChannels(now)); // Window just started: use the latest readings
+  WindowSample sample;
+  bool keep = _aggregator.close(now, force, sample);
+  _sched.after(AppTask::Window, now, _cfg.aggregation.windowMs);
+  if (!force && _aggregator.lastMoved() == 0) _calmWindows++;
+  else if (_aggregator.lastMoved() != 0) _calmWindows = 0;
+  if (!keep) return;
+  if (!_hal.clock->timeSet()) return; // No wall-clock yet (RTC not set and no SNTP sync so far)
+  uint64_t endMs = _hal.clock->epochMs();
+  sample.epoch = endMs / 1000; sample.epochMs = endMs % 1000;
+  _sampleBuffer.push(sample);
+  scheduleFlush(now);
+}
+
+// Channels whose latest value was captured within the last window: an event window that has just
+// started borrows those, not the value of a sensor that was slowed down, failed, or never read
+uint8_t App::recentChannels(uint32_t now) const {
+  uint8_t channels = 0;
+  for (size_t i = 0; i < ENV_CHANNELS; ++i) {
+    if ((_readChannels & (1 << i)) && now - _capturedMs[i] <= _cfg.aggregation.windowMs) channels |= 1 << i;
+  }
+  return channels;
+}
+
+// Requests an upload. Event uploads close the window early (every channel included) so the readings
+// up to the event are part of the batch; if a batch is already in flight the event goes out with the next one.
+void App::uploadData(const char* triggerEvent) {
+  if (triggerEvent != nullptr && strcmp(triggerEvent, "regular") != 0) { closeWindow(true); _pendingUploadEvent = triggerEvent; }
+  flushUploads();
+}
+
+// Queues the oldest buffered samples for the network task; never blocks
+void App::flushUploads() {
+  uint32_t now = _hal.clock->millis();
+  if (_uploadInFlight || _sampleBuffer.empty()) { scheduleFlush(now); return; }
+  _lastFlushAttemptTime = now;
+
+  _uploadJob.triggerEvent = _pendingUploadEvent ? _pendingUploadEvent : "regular";
+  _uploadJob.motion = _pendingMotion;
+  _uploadJob.perf = _pendingPerf;
+  _uploadJob.count = _sampleBuffer.peek(_uploadJob.samples, _cfg.flushPolicy.maxSamples);
+  if (!_hal.link->submitUpload(_uploadJob)) {
+    logPrintf("Upload queue full, will retry.\n");
+    _sched.after(AppTask::Flush, now, _cfg.flushRetryIntervalMs); // Even for an event: the queue needs time to drain
+    return;
+  }
+  logPrintf("Queued %u samples for upload (Trigger: %s)\n", (unsigned)_uploadJob.count, _uploadJob.triggerEvent);
+  _uploadInFlight = true; _inFlightCount = _uploadJob.count; _inFlightDroppedMark = _sampleBuffer.dropped();
+  _pendingUploadEvent = nullptr; _pendingMotion = {}; _pendingPerf.seq = 0;
+  _sched.cancel(AppTask::Flush); // Re-armed by the result
+}
+
+// Arms the next flush: right away for an event that arrived while a batch was in flight, otherwise
+// once the batch is full or old enough, and no sooner than flushRetryIntervalMs after the last attempt
+void App::scheduleFlush(uint32_t now) {
+  if (_uploadInFlight || _sampleBuffer.empty()) { _sched.cancel(AppTask::Flush); return; }
+  if (_pendingUploadEvent != nullptr) { _sched.after(AppTask::Flush, now, 0); return; }
+  uint32_t wait = _sampleBuffer.msUntilFlush(_cfg.flushPolicy.maxSamples, flushAgeMs(), now);
+  uint32_t sinceAttempt = now - _lastFlushAttemptTime;
+  if (sinceAttempt < _cfg.flushRetryIntervalMs && wait < _cfg.flushRetryIntervalMs - sinceAttempt) {
+    wait = _cfg.flushRetryIntervalMs - sinceAttempt;
+  }
+  _sched.after(AppTask::Flush, now, wait);
+}
+
+// Age limit of a partial batch: maxAgeMs, doubled per calm window while the display is off, up to idleMaxAgeMs
+uint32_t App::flushAgeMs() const {
+  const FlushPolicy& policy = _cfg.flushPolicy;
+  if (_uiAwake || policy.idleMaxAgeMs <= policy.maxAgeMs) return policy.maxAgeMs;
+  uint32_t age = policy.maxAgeMs << (_calmWindows < 4 ? _calmWindows : 4);
+  return age < policy.idleMaxAgeMs ? age : policy.idleMaxAgeMs;
+}
+
+// Drains results posted by the network task
+void App::handleNetEvents() {
+  NetEvent ev;
+  while (_hal.link->pollEvent(ev)) {
+    if (ev.type == NetEventType::UploadDone) handleUploadResult(ev);
+    else if (ev.type == NetEventType::CloudState) handleCloudState(ev.cloudState);
+    else if (ev.type == NetEventType::LinkUp) handleLinkUp(ev);
+  }
+}
+
+void App::handleUploadResult(const NetEvent& ev) {
+  _prof.recordHttp(ev.httpCode, ev.handshakeMs + ev.transferMs);
+  logUploadResult(ev);
+  if (ev.backlog) { // Replayed from flash by the network task, independent of the in-flight batch
+    if (ev.success) logPrintf("Backlog upload successful, %u samples (%u still spooled)\n", (unsigned)ev.count, (unsigned)_hal.link->spooledSamples());
+    else logPrintf("Backlog upload failed, HTTP code: %d (%s)\n", ev.httpCode, ev.dropped ? "dropped" : "kept in flash");
+    return;
+  }
+
+  _uploadInFlight = false;
+  scheduleFlush(_hal.clock->millis()); // Before the returns below; consume() only makes the batch younger
+  const char* kept = ev.dropped ? "samples dropped" : ev.spooled ? "saved to flash" : "samples kept";
+  if (ev.success || ev.spooled || ev.dropped) { // A dropped batch would be refused again
+    // Samples overwritten while the batch was in flight were already removed from the front
+    uint32_t lost = _sampleBuffer.dropped() - _inFlightDroppedMark;
+    _sampleBuffer.consume(_inFlightCount > lost ? _inFlightCount - lost : 0);
+  }
+  if (ev.success) {
+    logPrintf("Upload successful, HTTP code: %d, %u samples (handshake %lu ms, transfer %lu ms)\n", ev.httpCode,
+              (unsigned)ev.count, (unsigned long)ev.handshakeMs, (unsigned long)ev.transferMs);
+  } else if (ev.httpCode == NET_ERROR_NOT_CONNECTED) {
+    logPrintf("WiFi disconnected. Cannot upload (%s).\n", kept); return;
+  } else if (ev.httpCode > 0) {
+    logPrintf("Upload rejected, HTTP code: %d (%s)\n", ev.httpCode, kept);
+  } else {
+    logPrintf("Upload failed, error: %s (%s)\n", _hal.link->errorString(ev.httpCode), kept);
+  }
+}
+
+// One fixed-size record per result, successful or not, with what field debugging needs
+void App::logUploadResult(const NetEvent& ev) {
+  EventRecord rec = {};
+  if (_hal.clock->timeSet()) {
+    uint64_t nowMs = _hal.clock->epochMs();
+    rec.epoch = nowMs / 1000; rec.epochMs = nowMs % 1000;
+  }
+  rec.httpCode = ev.httpCode;
+  uint32_t latencyMs = ev.handshakeMs + ev.transferMs;
+  rec.latencyMs = latencyMs > UINT16_MAX ? UINT16_MAX : latencyMs;
+  rec.bodyBytes = ev.bodyBytes;
+  rec.kind = ev.backlog ? EventKind::Backlog : eventKindOf(ev.triggerEvent);
+  rec.flags = (ev.success ? EVENT_OK : 0) | (ev.spooled ? EVENT_SPOOLED : 0) | (ev.backlog ? EVENT_BACKLOG : 0) |
+              (ev.dropped ? EVENT_DROPPED : 0);
+  rec.count = ev.count;
+  if (!_hal.events->append(rec)) logPrintf("Event log write failed.\n");
+}
+
+// WiFi (re)connected: what waited for the link goes out now, not at the batch deadline. The first
+// time after boot the window closes early, so the backend hears from the device as soon as it can.
+void App::handleLinkUp(const NetEvent& ev) {
+  logPrintf("Network up after %lu ms%s.\n", (unsigned long)ev.handshakeMs, ev.cached ? " (cached AP)" : "");
+  if (_aggregator.sentWindows() == 0 && _hal.clock->timeSet()) closeWindow(false);
+  flushUploads();
+}
+
+void App::handleCloudState(bool currentCloudState) {
+  if (_firstCloudCheck) { _lastCloudState = currentCloudState; _firstCloudCheck = false; logPrintf("Initial cloud state received: %s\n", currentCloudState ? "TRUE" : "FALSE"); }
+  else if (currentCloudState != _lastCloudState) {
+    logPrintf("Cloud state changed from %s to %s. Triggering actions.\n", _lastCloudState ? "TRUE" : "FALSE", currentCloudState ? "TRUE" : "FALSE");
+    logPrintf("Vibrating (Cloud State Change)...\n"); startVibration();
+    uploadData("cloud_state_change"); // Log this specific event
+    _lastCloudState = currentCloudState;
+  }
+}
+
+// Samples heap/RSSI once a second and closes the profiling window when it is due. With the display
+// off nothing shows the figures, so it only wakes up for the end of the profiling window.
+void App::updateDiagnostics(uint32_t now) {
+  uint32_t windowLeft = _cfg.perfWindowMs - _prof.windowAgeMs(now);
+  if (_prof.windowAgeMs(now) >= _cfg.perfWindowMs) windowLeft = 0;
+  _sched.after(AppTask::Diagnostics, now, (_uiAwake || windowLeft < SYSTEM_READ_MS) ? SYSTEM_READ_MS : windowLeft);
+  SystemStats stats = {};
+  _hal.system->read(stats);
+  _prof.recordSystem(stats);
+  _diagDirty = true;
+  if (_prof.windowAgeMs(now) < _cfg.perfWindowMs) return;
+
+  _pendingPerf = _prof.roll(now); // Replaces a summary that has not gone out yet
+  const PerfSummary& p = _pendingPerf;
+  size_t worst = 0; // Slowest stage by p99, not counting the idle delay
+  for (size_t i = 1; i < (size_t)LoopStage::Idle; ++i) if (p.stages[i].p99Us > p.stages[worst].p99Us) worst = i;
+  logPrintf("Perf window %lu: %lu passes, slowest %s p99 %lu us max %lu us, uploads %u ok %u failed, heap %lu (min %lu, block %lu), RSSI %d\n",
+            (unsigned long)p.seq, (unsigned long)p.passes, loopStageName((LoopStage)worst), (unsigned long)p.stages[worst].p99Us,
+            (unsigned long)p.stages[worst].maxUs, (unsigned)p.httpOk, (unsigned)(p.http4xx + p.http5xx + p.httpErr),
+            (unsigned long)p.freeHeap, (unsigned long)p.minFreeHeap, (unsigned long)p.minLargestBlock, p.rssi);
+}
+
+// --- Motion & Haptics ---
+
+// Feeds every queued IMU sample to the analyzer: feedback at the onset of an event,
+// upload with the feature summary once it is over. After a long sleep the queue can
+// hold more than one batch, so it drains until a batch comes back short.
+void App::processImu() {
+  size_t n = IMU_BATCH;
+  while (n == IMU_BATCH) {
+    n = _hal.imu->drain(_imuBatch, IMU_BATCH);
+    processImuBatch(n);
+  }
+}
+
+void App::processImuBatch(size_t n) {
+  for (size_t i = 0; i < n; ++i) {
+    const ImuSample& s = _imuBatch[i];
+    MotionAnalyzer::Result r = _motion.addSample(s.ax, s.ay, s.az, s.tMs);
+    if (r == MotionAnalyzer::Result::Onset) {
+      logPrintf("Motion detected! RMS %.2f G, peak %.2f G\n", _motion.rms(), _motion.peak());
+      logPrintf("Vibrating (Shake)...\n"); startVibration();
+      if (!_showShakePopup && _uiAwake) { // Display off: the vibration is the only feedback
+        _hal.ui->showPopup("SHAKE DETECTED"); _showShakePopup = true;
+        _sched.after(AppTask::Popup, _hal.clock->millis(), _cfg.popupMs);
+      }
+    } else if (r == MotionAnalyzer::Result::Completed) {
+      const MotionEvent& ev = _motion.lastEvent();
+      logPrintf("Motion event: %s, %u ms, RMS %.2f G, peak %.2f G, jerk %.0f G/s, %.1f Hz\n", motionKindName(ev.kind),
+                (unsigned)ev.durationMs, ev.rmsG, ev.peakG, ev.jerkGps, ev.freqHz);
+      _pendingMotion = ev;
+      uploadData(motionKindName(ev.kind)); // "shake" or "impact", with the summary in the body
+    }
+  }
+}
+
+// Haptics: start a pulse and let loop() switch it off, instead of delay()-ing through it
+void App::startVibration() {
+  _hal.ui->setVibration(_cfg.vibrationIntensity); _sched.after(AppTask::Vibration, _hal.clock->millis(), _cfg.vibrationMs);
+}
+
+void App::updateVibration() {
+  if (_sched.due(AppTask::Vibration, _hal.clock->millis())) _hal.ui->setVibration(0);
+}
+
+// --- UI ---
+
+void App::handleTouch() {
+  UiButton button = _hal.ui->pollButton();
+  if (button == UiButton::ViewLog && _page == UiPage::Main) {
+    logPrintf("Log button pressed.\n");
+    _page = UiPage::Log;
+    drawScreen(); // Redraw screen for the log page
+  } else if (button == UiButton::ViewDiag && _page == UiPage::Main) {
+    logPrintf("Diagnostics button pressed.\n");
+    _page = UiPage::Diag;
+    drawScreen();
+  } else if (button == UiButton::Back && _page != UiPage::Main) {
+    logPrintf("Back button pressed.\n");
+    _page = UiPage::Main;
+    _logFollow = true; // Log page opens on the newest records again
+    drawScreen(); // Redraw screen for the main page
+  } else if (button != UiButton::None && _page == UiPage::Log) {
+    scrollLog(button);
+  }
+}
+
+// The display turned off or back on: sensors back off while nobody watches, and the flush
+// deadline moves with the batch age limit. On wake the page is redrawn with current values.
+void App::updateAwake(uint32_t now) {
+  bool awake = _hal.ui->awake();
+  if (awake == _uiAwake) return;
+  _uiAwake = awake;
+  logPrintf("Display %s.\n", awake ? "on" : "off");
+  _hal.sensors->setAdaptive(!awake);
+  scheduleFlush(now);
+  if (awake) { drawScreen(); _sched.after(AppTask::Diagnostics, now, 0); return; }
+  if (_showShakePopup) clearPopup();
+  _sched.cancel(AppTask::Screen);
+}
+
+// Log page navigation: the buttons page, vertical flicks scroll half a page, horizontal flicks
+// jump an hour through the time index. Scrolling to the newest record follows new ones again.
+void App::scrollLog(UiButton button) {
+  EventLog& log = *_hal.events;
+  uint32_t first = log.first(), end = log.end();
+  if (first == end) return;
+  uint32_t rows = _hal.ui->logRows();
+  uint32_t minTop = (end - first > rows) ? first + rows : end; // Keep the page full
+  uint32_t top = _logFollow ? end : _logTop;
+  uint32_t step = (button == UiButton::LogOlder || button == UiButton::LogNewer) ? rows : (rows + 1) / 2;
+
+  EventRecord topRecord;
+  bool jump = button == UiButton::HourOlder || button == UiButton::HourNewer;
+  if (jump && log.read(top - 1, &topRecord, 1) == 1 && !(topRecord.flags & EVENT_CORRUPT) && topRecord.epoch != 0) {
+    uint32_t target = (button == UiButton::HourOlder) ? topRecord.epoch - 3600 : topRecord.epoch + 3600;
+    top = log.seek(target) + 1; // That record goes to the top row
+  } else if (button == UiButton::LogOlder || button == UiButton::ScrollOlder || button == UiButton::HourOlder) {
+    top = (top - first > step) ? top - step : first;
+  } else if (button == UiButton::LogNewer || button == UiButton::ScrollNewer || button == UiButton::HourNewer) {
+    top += step;
+  } else {
+    return;
+  }
+  if (top < minTop) top = minTop;
+  _logFollow = top >= end;
+  _logTop = _logFollow ? end : top;
+}
+
+void App::drawScreen() { // Static parts; dynamic fields redraw on their next update
+  _hal.ui->showPage(_page);
+  _logDirty = true; _diagDirty = true;
+  if (_page == UiPage::Log) updateLogPageData();
+  else if (_page == UiPage::Diag) updateDiagPageData();
+}
+
+void App::updateScreenData() { // Main update router
+  if (!_uiAwake) return; // Display off: redrawn on wake
+  uint32_t now = _hal.clock->millis();
+  _hal.ui->beginFrame();
+  if (_page == UiPage::Main) {
+    updateMainPageData();
+  } else if (_page == UiPage::Log) {
+    updateLogPageData(); // Log page needs update if data changes
+  } else if (_page == UiPage::Diag) {
+    updateDiagPageData();
+  }
+  // Handle popup clearing regardless of page
+  if (_sched.due(AppTask::Popup, now)) clearPopup();
+  _hal.ui->endFrame();
+  // The main page clock ticks on the next second; other pages change only with new data
+  if (_page == UiPage::Main) _sched.after(AppTask::Screen, now, _hal.clock->timeSet() ? 1000 - (uint32_t)(_hal.clock->epochMs() % 1000) : 1000);
+  else _sched.cancel(AppTask::Screen);
+}
+
+void App::updateMainPageData() { // Update dynamic parts of Main Page (the clock read is a timer read, no NTP)
+  char buffer[16];
+  uint32_t t = _hal.clock->epoch();
+  if (_hal.clock->timeSet()) snprintf(buffer, sizeof(buffer), "%02u:%02u:%02u", (unsigned)(t / 3600 % 24), (unsigned)(t / 60 % 60), (unsigned)(t % 60));
+  else snprintf(buffer, sizeof(buffer), "--:--:--"); // No RTC time and no sync yet
+  _hal.ui->setClock(buffer);
+  snprintf(buffer, sizeof(buffer), "%d", _currentData.prox); _hal.ui->setValue(0, buffer);
+  snprintf(buffer, sizeof(buffer), "%d lux", _currentData.ambientLight); _hal.ui->setValue(1, buffer);
+  snprintf(buffer, sizeof(buffer), "%d", _currentData.whiteLight); _hal.ui->setValue(2, buffer);
+  snprintf(buffer, sizeof(buffer), "%.1f", _currentData.temp); _hal.ui->setValue(3, buffer);
+  snprintf(buffer, sizeof(buffer), "%.1f", _currentData.rHum); _hal.ui->setValue(4, buffer);
+}
+
+void App::updateLogPageData() { // Reads only the records on screen, and only after a new one or a scroll
+  EventLog& log = *_hal.events;
+  uint32_t first = log.first(), end = log.end();
+  if (_logFollow || _logTop > end) _logTop = end;
+  if (!_logDirty && _shownLogTop == _logTop && _shownLogEnd == end) return;
+  _logDirty = false; _shownLogTop = _logTop; _shownLogEnd = end;
+  size_t rows = _hal.ui->logRows();
+  if (rows > MAX_LOG_ROWS) rows = MAX_LOG_ROWS;
+
+  if (first == end) {
+    _hal.ui->setLogStatus("");
+    _hal.ui->setLogRow(0, "No log entries yet.", "");
+    for (size_t row = 1; row < rows; ++row) _hal.ui->setLogRow(row, "", "");
+    return;
+  }
+
+  uint32_t top = _logTop, fullTop = (end - first > rows) ? first + rows : end;
+  if (top < fullTop) top = fullTop; // Records under the page may have been dropped meanwhile
+  uint32_t start = (top - first > rows) ? top - rows : first;
+  EventRecord page[MAX_LOG_ROWS];
+  size_t n = log.read(start, page, top - start);
+  char timestamp[20], event[36];
+  snprintf(event, sizeof(event), "%lu-%lu/%lu", (unsigned long)(end - top + 1), (unsigned long)(end - start),
+           (unsigned long)(end - first)); // 1 is the newest record
+  _hal.ui->setLogStatus(event);
+
+  for (size_t row = 0; row < rows; ++row) { // Newest first
+    if (row >= n) { _hal.ui->setLogRow(row, "", ""); continue; }
+    const EventRecord& rec = page[n - 1 - row];
+    if (rec.flags & EVENT_CORRUPT) { _hal.ui->setLogRow(row, "-", "corrupt"); continue; }
+    formatTimestamp(rec.epoch, timestamp, sizeof(timestamp));
+    snprintf(event, sizeof(event), "%s %d %u", eventKindLabel(rec.kind), rec.httpCode, (unsigned)rec.latencyMs);
+    _hal.ui->setLogRow(row, timestamp, event);
+  }
+}
+
+void App::updateDiagPageData() { // Current profiling window: stage p50/p99/max in ms, uploads, heap and RSSI
+  if (!_diagDirty) return;
+  _diagDirty = false;
+  size_t rows = _hal.ui->diagRows(), row = 0;
+  char value[32];
+  for (size_t i = 0; i < LOOP_STAGES && row < rows; ++i, ++row) {
+    const LatencyHistogram& h = _prof.stage((LoopStage)i);
+    snprintf(value, sizeof(value), "%.2f %.2f %.2f", h.percentile(0.5f) / 1000.0f, h.percentile(0.99f) / 1000.0f, h.max() / 1000.0f);
+    _hal.ui->setDiagRow(row, loopStageName((LoopStage)i), value);
+  }
+  if (row < rows) {
+    snprintf(value, sizeof(value), "%u/%u %lums", (unsigned)_prof.httpOk(), (unsigned)_prof.httpFailed(),
+             (unsigned long)_prof.http().percentile(0.99f));
+    _hal.ui->setDiagRow(row++, "http", value);
+  }
+  if (row < rows) {
+    const SystemStats& sys = _prof.system();
+    snprintf(value, sizeof(value), "%lu/%lu/%luk %d", (unsigned long)(sys.freeHeap / 1024), (unsigned long)(sys.minFreeHeap / 1024),
+             (unsigned long)(_prof.minLargestBlock() / 1024), sys.rssi);
+    _hal.ui->setDiagRow(row++, "heap", value);
+  }
+  for (; row < rows; ++row) _hal.ui->setDiagRow(row, "", "");
+}
+
+void App::clearPopup() { // Puts back the pixels the popup covered; full redraw only if they could not be saved
+  _showShakePopup = false; // Reset flag FIRST
+  _sched.cancel(AppTask::Popup);
+  if (!_hal.ui->hidePopup()) drawScreen();
+}
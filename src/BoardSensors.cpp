@@ -0,0 +1,45 @@
+#include "BoardSensors.h"
+
+// --- VCNL4040 ---
+
+bool Vcnl4040Light::collect(SensorData& out) {
+  out.ambientLight = _chip.getLux(); out.whiteLight = _chip.getWhiteLight();
+  return true;
+}
+
+// --- SHT4x ---
+
+static const uint8_t SHT4X_MEASURE_HIGH_PRECISION = 0xFD;
+static const uint32_t SHT4X_HIGH_PRECISION_MS = 9; // Datasheet max 8.3 ms
+
+bool Sht4xChannel::trigger(uint32_t& waitMs) {
+  _wire.beginTransmission(_address);
+  _wire.write(SHT4X_MEASURE_HIGH_PRECISION);
+  if (_wire.endTransmission() != 0) return false;
+  waitMs = SHT4X_HIGH_PRECISION_MS;
+  return true;
+}
+
+bool Sht4xChannel::collect(SensorData& out) {
+  // The sensor NACKs its address while still converting: not ready yet, SensorHub retries
+  uint8_t raw[6];
+  if (_wire.requestFrom(_address, (uint8_t)sizeof(raw)) != sizeof(raw)) return false;
+  for (uint8_t& b : raw) b = _wire.read();
+  if (crc8(raw, 2) != raw[2] || crc8(raw + 3, 2) != raw[5]) { _crcErrors++; return false; }
+
+  uint16_t rawT = (raw[0] << 8) | raw[1], rawRh = (raw[3] << 8) | raw[4];
+  float rh = -6.0f + 125.0f * rawRh / 65535.0f;
+  out.temp = -45.0f + 175.0f * rawT / 65535.0f;
+  out.rHum = rh < 0.0f ? 0.0f : (rh > 100.0f ? 100.0f : rh);
+  return true;
+}
+
+// CRC-8, polynomial 0x31, init 0xFF (Sensirion)
+uint8_t Sht4xChannel::crc8(const uint8_t* data, size_t len) {
+  uint8_t crc = 0xFF;
+  for (size_t i = 0; i < len; ++i) {
+    crc ^= data[i];
+    for (int bit = 0; bit < 8; ++bit) crc = (crc & 0x80) ? (crc << 1) ^ 0x31 : crc << 1;
+  }
+  return crc;
+}
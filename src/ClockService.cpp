@@ -0,0 +1,130 @@
+#include "ClockService.h"
+#include <M5Unified.h>
+#include <esp_timer.h>
+#include <esp_sntp.h>
+
+namespace {
+  ClockService* sntpTarget = nullptr; // The SNTP callback has no user argument
+
+  const uint32_t MIN_DRIFT_INTERVAL_S = 600;  // Shorter spans are dominated by SNTP jitter
+  const float DRIFT_SMOOTHING = 0.3f;         // Weight of the newest drift measurement
+  const uint32_t RTC_WRITE_WINDOW_MS = 100;   // Write the RTC this close after a second boundary
+  const int64_t MAX_HOLD_US = 1000000;        // Larger back-corrections step the clock instead of freezing it
+
+  // Days since 1970-01-01 for a proleptic Gregorian date (no time zone involved, unlike mktime)
+  int64_t daysFromCivil(int y, unsigned m, unsigned d) {
+    y -= m <= 2;
+    int era = (y >= 0 ? y : y - 399) / 400;
+    unsigned yoe = (unsigned)(y - era * 400);
+    unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return (int64_t)era * 146097 + (int64_t)doe - 719468;
+  }
+}
+
+void ClockService::begin(int32_t utcOffsetS, const char* ntpServer, uint32_t syncIntervalMs) {
+  _utcOffsetS = utcOffsetS; _ntpServer = ntpServer; _syncIntervalMs = syncIntervalMs;
+  uint64_t rtcUs;
+  if (readRtc(rtcUs)) {
+    portENTER_CRITICAL(&_lock);
+    _baseTimerUs = esp_timer_get_time(); _baseUtcUs = rtcUs;
+    _source = Source::Rtc;
+    portEXIT_CRITICAL(&_lock);
+    Serial.printf("Clock: seeded from RTC, %llu UTC\n", (unsigned long long)(rtcUs / 1000000));
+  } else {
+    Serial.println("Clock: RTC not set, waiting for SNTP.");
+  }
+}
+
+void ClockService::startSntp() {
+  if (_sntpStarted) return;
+  _sntpStarted = true;
+  sntpTarget = this;
+  sntp_set_sync_interval(_syncIntervalMs);
+  sntp_set_time_sync_notification_cb(onSntpSync);
+  configTime(0, 0, _ntpServer); // lwIP polls in the background; we only use its results
+}
+
+void ClockService::onSntpSync(struct timeval* tv) {
+  int64_t timerUs = esp_timer_get_time();
+  if (sntpTarget != nullptr) sntpTarget->sync((uint64_t)tv->tv_sec * 1000000 + tv->tv_usec, timerUs);
+}
+
+// Re-anchors the mapping on an SNTP result and updates the drift estimate (runs on the lwIP task)
+void ClockService::sync(uint64_t utcUs, int64_t timerUs) {
+  portENTER_CRITICAL(&_lock);
+  bool anchored = _source != Source::None;
+  int64_t errorUs = anchored ? (int64_t)(utcUs - mapLocked(timerUs)) : 0;
+  if (_syncs > 0) {
+    int64_t spanUs = timerUs - _lastSyncTimerUs;
+    if (spanUs >= (int64_t)MIN_DRIFT_INTERVAL_S * 1000000) {
+      float measured = (float)((int64_t)(utcUs - _lastSyncUtcUs) - spanUs) / spanUs;
+      _drift = _syncs == 1 ? measured : _drift + DRIFT_SMOOTHING * (measured - _drift);
+      const float maxDrift = MAX_DRIFT_PPM * 1e-6f;
+      _drift = _drift > maxDrift ? maxDrift : (_drift < -maxDrift ? -maxDrift : _drift);
+    }
+  }
+  _baseTimerUs = timerUs; _baseUtcUs = utcUs;
+  if (errorUs < -MAX_HOLD_US) _lastReadUs = 0; // Bad RTC seed or a server that was wrong: step back now
+  _lastSyncTimerUs = timerUs; _lastSyncUtcUs = utcUs;
+  _syncs++;
+  _lastCorrectionMs = (int32_t)(errorUs / 1000);
+  _source = Source::Sntp;
+  _rtcWritePending = true;
+  portEXIT_CRITICAL(&_lock);
+}
+
+uint64_t ClockService::mapLocked(int64_t timerUs) const {
+  int64_t elapsed = timerUs - _baseTimerUs;
+  return _baseUtcUs + elapsed + (int64_t)(elapsed * _drift);
+}
+
+uint64_t ClockService::utcUs() {
+  int64_t timerUs = esp_timer_get_time();
+  portENTER_CRITICAL(&_lock);
+  uint64_t us = mapLocked(timerUs);
+  if (us < _lastReadUs) us = _lastReadUs; // A sync stepped back: hold until real time catches up
+  else _lastReadUs = us;
+  portEXIT_CRITICAL(&_lock);
+  return us;
+}
+
+void ClockService::service() {
+  if (!_rtcWritePending) return;
+  uint64_t us = utcUs();
+  if (us % 1000000 >= RTC_WRITE_WINDOW_MS * 1000) return; // RTC has 1 s resolution: set it at the top of a second
+  _rtcWritePending = false;
+  writeRtc(us);
+}
+
+ClockService::Status ClockService::status() {
+  int64_t timerUs = esp_timer_get_time();
+  portENTER_CRITICAL(&_lock);
+  Status s = { _source, _syncs, _lastCorrectionMs, _drift * 1e6f, (uint32_t)((timerUs - _baseTimerUs) / 1000000) };
+  portEXIT_CRITICAL(&_lock);
+  return s;
+}
+
+const char* ClockService::sourceName(Source source) {
+  return source == Source::Sntp ? "sntp" : source == Source::Rtc ? "rtc" : "none";
+}
+
+// --- BM8563 (kept in UTC) ---
+
+bool ClockService::readRtc(uint64_t& utcUs) {
+  if (!M5.Rtc.isEnabled() || M5.Rtc.getVoltLow()) return false; // Lost power: contents are garbage
+  m5::rtc_datetime_t dt = M5.Rtc.getDateTime();
+  if (dt.date.year < 2024) return false; // Never set
+  int64_t days = daysFromCivil(dt.date.year, dt.date.month, dt.date.date);
+  int64_t seconds = days * 86400 + dt.time.hours * 3600 + dt.time.minutes * 60 + dt.time.seconds;
+  utcUs = (uint64_t)seconds * 1000000 + 500000; // Unknown position within the second: take the middle
+  return true;
+}
+
+void ClockService::writeRtc(uint64_t utcUs) {
+  if (!M5.Rtc.isEnabled()) return;
+  time_t seconds = utcUs / 1000000;
+  struct tm t;
+  gmtime_r(&seconds, &t);
+  M5.Rtc.setDateTime(&t);
+}
@@ -0,0 +1,146 @@
+#include "CommandChannel.h"
+#include <WiFi.h>
+#include <ArduinoJson.h>
+#include "NetWorker.h"
+
+namespace {
+  const char* COLLECTED_HEADERS[] = { "ETag", "Content-Type" };
+  const size_t COLLECTED_HEADER_COUNT = sizeof(COLLECTED_HEADERS) / sizeof(COLLECTED_HEADERS[0]);
+
+  // Server returned "not supported" for the event stream: switch to long-polling
+  bool streamUnsupported(int httpCode) {
+    return httpCode == HTTP_CODE_NOT_FOUND || httpCode == HTTP_CODE_METHOD_NOT_ALLOWED ||
+           httpCode == HTTP_CODE_NOT_ACCEPTABLE || httpCode == HTTP_CODE_NOT_IMPLEMENTED;
+  }
+}
+
+bool CommandChannel::begin(const CommandChannelConfig& config) {
+  _cfg = config;
+  _mode = config.mode;
+  if (_cfg.longPollWaitS > MAX_LONG_POLL_WAIT_S) _cfg.longPollWaitS = MAX_LONG_POLL_WAIT_S; // Asked for and waited for alike
+  return xTaskCreatePinnedToCore(taskEntry, "cmd", TASK_STACK, this, 1, &_task, TASK_CORE) == pdPASS;
+}
+
+void CommandChannel::taskEntry(void* arg) {
+  static_cast<CommandChannel*>(arg)->run();
+}
+
+void CommandChannel::run() {
+  for (;;) {
+    if (WiFi.status() != WL_CONNECTED) { _cfg.session->close(); vTaskDelay(pdMS_TO_TICKS(500)); continue; }
+    uint32_t start = millis();
+    if (_mode == CommandMode::Sse) streamEvents(); // Returns when the stream drops or the server lacks support
+    else checkCloudCommand(_mode == CommandMode::LongPoll);
+
+    // Never faster than pollIntervalMs: a server that ignores &wait degrades to plain conditional polling
+    uint32_t elapsed = millis() - start;
+    if (elapsed < _cfg.pollIntervalMs) vTaskDelay(pdMS_TO_TICKS(_cfg.pollIntervalMs - elapsed));
+  }
+}
+
+// One conditional GET. 304 means the state is unchanged and nothing is read.
+int CommandChannel::checkCloudCommand(bool longPoll) {
+  HttpSession& session = *_cfg.session;
+  char query[96];
+  StatePoll::query(query, sizeof(query), _cfg.userId, longPoll ? _cfg.longPollWaitS : 0);
+  if (!session.begin(query)) { _stats.errors++; return HTTPC_ERROR_CONNECTION_REFUSED; }
+
+  HTTPClient& http = session.http();
+  http.collectHeaders(COLLECTED_HEADERS, COLLECTED_HEADER_COUNT);
+  if (_poll.etag()[0] != '\0') http.addHeader("If-None-Match", _poll.etag());
+  http.setTimeout(longPoll ? (uint16_t)((_cfg.longPollWaitS + LONG_POLL_GRACE_S) * 1000) : HTTPCLIENT_DEFAULT_TCP_TIMEOUT);
+  _stats.requests++;
+  int httpCode = session.sendRequest("GET");
+
+  if (httpCode == HTTP_CODE_NOT_MODIFIED) {
+    _stats.notModified++;
+  } else if (httpCode == HTTP_CODE_OK) {
+    String etag = http.header("ETag");
+    bool state;
+    // Stream-parse when the length is known; chunked bodies need HTTPClient to de-chunk them
+    bool ok = (http.getSize() > 0) ? parseState(http.getStream(), state) : parseState(http.getString().c_str(), state);
+    _poll.setEtag(ok ? etag.c_str() : ""); // After a bad body the next poll must get a full 200, not a 304
+    if (ok) report(state, httpCode);
+  } else {
+    _stats.errors++;
+  }
+  session.end();
+  return httpCode;
+}
+
+// Holds a text/event-stream open and reports every "data:" event.
+bool CommandChannel::streamEvents() {
+  HttpSession& session = *_cfg.session;
+  char query[96];
+  snprintf(query, sizeof(query), "?userId=%s&stream=1", _cfg.userId);
+  if (!session.begin(query)) { _stats.errors++; return false; }
+
+  HTTPClient& http = session.http();
+  http.collectHeaders(COLLECTED_HEADERS, COLLECTED_HEADER_COUNT);
+  http.addHeader("Accept", "text/event-stream");
+  _stats.requests++;
+  int httpCode = session.sendRequest("GET");
+  if (httpCode != HTTP_CODE_OK) {
+    _stats.errors++; session.end();
+    if (streamUnsupported(httpCode)) { Serial.println("Command channel: no event stream, using long-poll."); _mode = CommandMode::LongPoll; }
+    return false;
+  }
+  if (http.header("Content-Type").indexOf("text/event-stream") < 0) {
+    // Plain JSON answer: the server does not stream. Use it, then long-poll from now on.
+    String etag = http.header("ETag");
+    bool state;
+    bool ok = parseState(http.getString().c_str(), state);
+    _poll.setEtag(ok ? etag.c_str() : "");
+    if (ok) report(state, httpCode);
+    session.end();
+    Serial.println("Command channel: no event stream, using long-poll.");
+    _mode = CommandMode::LongPoll;
+    return false;
+  }
+
+  WiFiClient* stream = http.getStreamPtr();
+  char line[128];
+  uint32_t lastData = millis();
+  while (stream->connected() && WiFi.status() == WL_CONNECTED && millis() - lastData < SSE_IDLE_TIMEOUT_MS) {
+    if (stream->available() == 0) { vTaskDelay(pdMS_TO_TICKS(50)); continue; }
+    size_t n = stream->readBytesUntil('\n', line, sizeof(line) - 1);
+    line[n] = '\0'; lastData = millis();
+    if (n > 0 && line[n - 1] == '\r') line[--n] = '\0';
+    if (strncmp(line, "data:", 5) == 0) {
+      bool state;
+      if (parseState(line + 5, state)) report(state, httpCode);
+    } else if (strncmp(line, "id:", 3) == 0) { // Event id doubles as the ETag for a later fallback
+      const char* id = line + 3; while (*id == ' ') id++;
+      _poll.setEtag(id);
+    } // ":" lines are keep-alive pings
+  }
+  session.close(); // A stream connection cannot be reused
+  return true;
+}
+
+// Only "fanState" survives deserialization; the rest of the response is skipped as it streams by
+bool CommandChannel::parseState(Stream& in, bool& state) {
+  bool hasKey = false;
+  return handleParsed(_poll.parse(in, state, hasKey), hasKey);
+}
+
+bool CommandChannel::parseState(const char* json, bool& state) {
+  bool hasKey = false;
+  return handleParsed(_poll.parse(json, state, hasKey), hasKey);
+}
+
+bool CommandChannel::handleParsed(DeserializationError error, bool hasKey) {
+  if (error) { Serial.print("State JSON parsing failed: "); Serial.println(error.c_str()); _stats.errors++; return false; }
+  _stats.parsed++;
+  if (!hasKey) { Serial.println("State JSON response missing 'fanState' key."); return false; } // Still using "fanState" key as discussed
+  return true;
+}
+
+// Only the first state and changes go to loop(); it decides what a change triggers
+void CommandChannel::report(bool state, int httpCode) {
+  if (!_poll.isNews(state)) return;
+  NetEvent ev = {};
+  ev.type = NetEventType::CloudState; ev.success = true; ev.cloudState = state; ev.httpCode = httpCode;
+  ev.handshakeMs = _cfg.session->lastTiming().handshakeMs; ev.transferMs = _cfg.session->lastTiming().transferMs;
+  if (_cfg.events->postEvent(ev)) { _poll.markReported(state); _stats.changes++; }
+}
@@ -0,0 +1,156 @@
+#include "FlashEventLog.h"
+
+namespace {
+  // Completes a torn record with zeros so later records stay aligned (it then reads as corrupt)
+  bool padRecord(File& f, size_t partial, size_t recordSize) {
+    static const uint8_t zeros[32] = {};
+    size_t missing = recordSize - partial;
+    while (missing > 0) {
+      size_t n = missing < sizeof(zeros) ? missing : sizeof(zeros);
+      if (f.write(zeros, n) != n) return false;
+      missing -= n;
+    }
+    return true;
+  }
+}
+
+String FlashEventLog::segmentPath(uint32_t seg) const { return flashSegmentPath(_dir, seg, "log"); }
+
+bool FlashEventLog::begin(fs::FS& fs, const char* dir, uint32_t maxSegments) {
+  _fs = &fs; _dir = dir; _maxSegments = max<uint32_t>(maxSegments, 1);
+  delete[] _index;
+  _indexSlots = _maxSegments * (RECORDS_PER_SEGMENT / INDEX_STRIDE);
+  _index = new uint32_t[_indexSlots]();
+  if (!_fs->exists(_dir) && !_fs->mkdir(_dir)) return false;
+
+  uint32_t minSeg = UINT32_MAX, maxSeg = 0;
+  File root = _fs->open(_dir);
+  if (!root || !root.isDirectory()) return false;
+  for (File f = root.openNextFile(); f; f = root.openNextFile()) {
+    uint32_t seg;
+    if (!flashSegmentId(f.name(), "log", seg)) continue;
+    minSeg = min(minSeg, seg); maxSeg = max(maxSeg, seg);
+  }
+  root.close();
+  if (maxSeg == 0) { _headSeg = _tailSeg = 1; _tailCount = 0; return true; } // Empty log
+
+  _headSeg = minSeg; _tailSeg = maxSeg;
+  while (segmentCount() > _maxSegments) _fs->remove(segmentPath(_headSeg++)); // maxSegments was lowered
+  File tail = _fs->open(segmentPath(_tailSeg), FILE_APPEND);
+  if (!tail) return false;
+  size_t tailBytes = tail.size();
+  _tailCount = tailBytes / RECORD_SIZE;
+  if (tailBytes % RECORD_SIZE != 0 && padRecord(tail, tailBytes % RECORD_SIZE, RECORD_SIZE)) _tailCount++;
+  tail.close();
+  if (_tailCount > RECORDS_PER_SEGMENT) _tailCount = RECORDS_PER_SEGMENT;
+
+  // Time index: the first record of every stride
+  for (uint32_t seg = _headSeg; seg <= _tailSeg; ++seg) {
+    uint32_t records = (seg == _tailSeg) ? _tailCount : RECORDS_PER_SEGMENT;
+    uint32_t seq = (seg - 1) * RECORDS_PER_SEGMENT;
+    File f = _fs->open(segmentPath(seg), FILE_READ);
+    for (uint32_t slot = 0; slot < records; slot += INDEX_STRIDE) {
+      Record rec;
+      EventRecord event = {};
+      event.flags = EVENT_CORRUPT;
+      if (!(f && f.seek(slot * RECORD_SIZE) && f.read((uint8_t*)&rec, RECORD_SIZE) == RECORD_SIZE && decode(rec, event))) _corrupt++;
+      indexRecord(seq + slot, event);
+    }
+    if (f) f.close();
+  }
+  return true;
+}
+
+bool FlashEventLog::append(const EventRecord& record) {
+  if (_fs == nullptr) return false; // begin() was not called (no filesystem)
+  if (_tailCount >= RECORDS_PER_SEGMENT) { // Roll over to a new segment, dropping the oldest one if the log is full
+    if (_tail) _tail.close();
+    _tailSeg++; _tailCount = 0;
+    while (segmentCount() > _maxSegments) _fs->remove(segmentPath(_headSeg++));
+  }
+  if (!_tail) {
+    _tail = _fs->open(segmentPath(_tailSeg), FILE_APPEND);
+    if (!_tail) return false;
+  }
+
+  Record rec;
+  rec.seal(record);
+  size_t written = _tail.write((const uint8_t*)&rec, RECORD_SIZE);
+  if (written != RECORD_SIZE) { // Keep the segment aligned; the record reads back as corrupt
+    if (written > 0 && padRecord(_tail, written, RECORD_SIZE)) {
+      EventRecord torn = {};
+      torn.flags = EVENT_CORRUPT;
+      _tailCount++; _corrupt++; indexRecord(end() - 1, torn);
+    }
+    _tail.close();
+    return false;
+  }
+  _tail.flush(); // One record per upload result, so commit each
+  _tailCount++;
+  indexRecord(end() - 1, record);
+  return true;
+}
+
+size_t FlashEventLog::read(uint32_t seq, EventRecord* out, size_t count) {
+  size_t n = 0;
+  if (seq < first()) return 0;
+  uint32_t last = end();
+  while (n < count && seq < last) {
+    uint32_t seg = seq / RECORDS_PER_SEGMENT + 1, slot = seq % RECORDS_PER_SEGMENT;
+    File f = _fs->open(segmentPath(seg), FILE_READ);
+    if (!f || !f.seek(slot * RECORD_SIZE)) break;
+    Record rec;
+    while (n < count && seq < last && slot < RECORDS_PER_SEGMENT && f.read((uint8_t*)&rec, RECORD_SIZE) == RECORD_SIZE) {
+      decode(rec, out[n++]);
+      seq++; slot++;
+    }
+    f.close();
+    if (slot < RECORDS_PER_SEGMENT && seq < last && n < count) break; // Segment shorter than it should be
+  }
+  return n;
+}
+
+uint32_t FlashEventLog::seek(uint32_t epoch) {
+  if (first() == end()) return end();
+  // Binary search over the index for the first stride starting at or after epoch...
+  uint32_t lo = first() / INDEX_STRIDE, hi = (end() - 1) / INDEX_STRIDE;
+  while (lo < hi) {
+    uint32_t mid = lo + (hi - lo) / 2;
+    if (_index[mid % _indexSlots] >= epoch) hi = mid; else lo = mid + 1;
+  }
+  // ...then scan the stride before it (or the records after the last stride start)
+  uint32_t from, limit;
+  if (_index[lo % _indexSlots] >= epoch) {
+    limit = lo * INDEX_STRIDE;
+    from = (limit > first()) ? limit - INDEX_STRIDE + 1 : limit;
+  } else {
+    from = lo * INDEX_STRIDE + 1; limit = end();
+  }
+  EventRecord chunk[8];
+  while (from < limit) {
+    size_t want = min<uint32_t>(limit - from, sizeof(chunk) / sizeof(chunk[0]));
+    size_t n = read(from, chunk, want);
+    if (n == 0) break;
+    for (size_t i = 0; i < n; ++i) {
+      if (!(chunk[i].flags & EVENT_CORRUPT) && chunk[i].epoch >= epoch) return from + i;
+    }
+    from += n;
+  }
+  return limit;
+}
+
+bool FlashEventLog::decode(const Record& rec, EventRecord& out) {
+  if (!rec.valid()) {
+    out = {}; out.flags = EVENT_CORRUPT;
+    return false;
+  }
+  out = rec.data;
+  return true;
+}
+
+// Index entries hold the stride's first timestamp; a corrupt record, or one logged before the clock was
+// set (epoch 0), borrows the newest valid timestamp before it so the index stays sorted for seek()
+void FlashEventLog::indexRecord(uint32_t seq, const EventRecord& event) {
+  if (!(event.flags & EVENT_CORRUPT) && event.epoch != 0) _lastEpoch = event.epoch;
+  if (seq % INDEX_STRIDE == 0) indexEntry(seq) = _lastEpoch;
+}
@@ -0,0 +1,154 @@
+#include "FlashQueue.h"
+
+namespace {
+  struct Cursor { uint32_t seg; uint32_t offset; };
+}
+
+String FlashQueue::segmentPath(uint32_t seg) const { return flashSegmentPath(_dir, seg, "seg"); }
+
+uint32_t FlashQueue::segmentRecords(uint32_t seg) {
+  if (seg == _tailSeg) return _tailCount;
+  File f = _fs->open(segmentPath(seg), FILE_READ);
+  if (!f) return 0;
+  uint32_t n = f.size() / RECORD_SIZE;
+  f.close();
+  return n;
+}
+
+bool FlashQueue::begin(fs::FS& fs, const char* dir, uint32_t maxSegments) {
+  _fs = &fs; _dir = dir; _maxSegments = maxSegments;
+  if (!_fs->exists(_dir) && !_fs->mkdir(_dir)) return false;
+
+  // Find the oldest and newest segment and count what they hold
+  uint32_t minSeg = UINT32_MAX, maxSeg = 0, totalRecords = 0;
+  File root = _fs->open(_dir);
+  if (!root || !root.isDirectory()) return false;
+  for (File f = root.openNextFile(); f; f = root.openNextFile()) {
+    uint32_t seg;
+    if (!flashSegmentId(f.name(), "seg", seg)) continue;
+    minSeg = min(minSeg, seg); maxSeg = max(maxSeg, seg);
+    totalRecords += f.size() / RECORD_SIZE; // A torn trailing record is ignored
+  }
+  root.close();
+
+  if (maxSeg == 0) { // Empty queue
+    loadCursor();
+    _headSeg = _tailSeg = max<uint32_t>(_headSeg, 1); _headOffset = 0; _tailCount = 0; _count = 0;
+    return true;
+  }
+
+  _tailSeg = maxSeg;
+  File tail = _fs->open(segmentPath(_tailSeg), FILE_READ);
+  size_t tailBytes = tail ? tail.size() : 0;
+  if (tail) tail.close();
+  _tailCount = tailBytes / RECORD_SIZE;
+  // A torn record at the end would misalign further appends: leave that segment as is and start a new one
+  if (tailBytes % RECORD_SIZE != 0) { _tailSeg++; _tailCount = 0; }
+
+  loadCursor();
+  if (_headSeg < minSeg) { _headSeg = minSeg; _headOffset = 0; }
+  // Segments before the cursor were fully replayed but not yet deleted (reset mid-consume)
+  for (uint32_t seg = minSeg; seg < _headSeg && seg <= maxSeg; ++seg) {
+    totalRecords -= segmentRecords(seg);
+    _fs->remove(segmentPath(seg));
+  }
+  if (_headSeg > maxSeg) { _tailSeg = _headSeg; _headOffset = 0; _tailCount = 0; } // Everything was replayed
+  _count = (totalRecords > _headOffset) ? totalRecords - _headOffset : 0;
+  return true;
+}
+
+size_t FlashQueue::append(const WindowSample* samples, size_t count) {
+  size_t written = 0;
+  while (written < count) {
+    if (_tailCount >= RECORDS_PER_SEGMENT) { // Roll over to a new segment
+      if (_tail) _tail.close();
+      _tailSeg++; _tailCount = 0;
+      while (segmentCount() > _maxSegments) removeHeadSegment();
+    }
+    if (!_tail) {
+      _tail = _fs->open(segmentPath(_tailSeg), FILE_APPEND);
+      if (!_tail) break;
+    }
+
+    Record rec;
+    rec.seal(samples[written]);
+    if (_tail.write((const uint8_t*)&rec, RECORD_SIZE) != RECORD_SIZE) break;
+    _tailCount++; _count++; written++;
+  }
+  if (_tail) _tail.flush(); // Commit once per call, not per record
+  return written;
+}
+
+size_t FlashQueue::peek(WindowSample* out, size_t maxCount) {
+  size_t n = 0, span = 0;
+  uint32_t seg = _headSeg, offset = _headOffset;
+  while (n < maxCount && span < _count) {
+    uint32_t segCount = segmentRecords(seg);
+    if (offset >= segCount) { if (seg >= _tailSeg) break; seg++; offset = 0; continue; }
+
+    File f = _fs->open(segmentPath(seg), FILE_READ);
+    if (!f) break;
+    f.seek(offset * RECORD_SIZE);
+    Record rec;
+    while (n < maxCount && offset < segCount && f.read((uint8_t*)&rec, RECORD_SIZE) == RECORD_SIZE) {
+      offset++; span++;
+      if (!rec.valid()) { _corrupt++; continue; }
+      out[n++] = rec.data;
+    }
+    f.close();
+  }
+  _lastPeekCount = n; _lastPeekSpan = span;
+  return n;
+}
+
+void FlashQueue::consume(size_t count) {
+  size_t span = (count == _lastPeekCount) ? _lastPeekSpan : count; // Step over corrupt records too
+  if (span > _count) span = _count;
+  _count -= span; _headOffset += span;
+  _lastPeekCount = _lastPeekSpan = 0;
+
+  // Delete segments that were fully replayed
+  while (_headSeg < _tailSeg) {
+    uint32_t segCount = segmentRecords(_headSeg);
+    if (_headOffset < segCount) break;
+    _fs->remove(segmentPath(_headSeg));
+    _headOffset -= segCount; _headSeg++;
+  }
+  if (_headSeg == _tailSeg && _headOffset >= _tailCount && _tailCount > 0) { // Fully drained: start a fresh segment
+    if (_tail) _tail.close();
+    _fs->remove(segmentPath(_tailSeg));
+    _tailSeg++; _headSeg = _tailSeg; _headOffset = 0; _tailCount = 0;
+  }
+  saveCursor();
+}
+
+void FlashQueue::removeHeadSegment() {
+  uint32_t segCount = segmentRecords(_headSeg);
+  uint32_t lost = (segCount > _headOffset) ? segCount - _headOffset : 0;
+  _fs->remove(segmentPath(_headSeg));
+  _count -= min(lost, _count); _dropped += lost;
+  _headSeg++; _headOffset = 0;
+  saveCursor();
+}
+
+void FlashQueue::clear() {
+  if (_tail) _tail.close();
+  for (uint32_t seg = _headSeg; seg <= _tailSeg; ++seg) _fs->remove(segmentPath(seg));
+  _tailSeg++; _headSeg = _tailSeg; _headOffset = 0; _tailCount = 0; _count = 0;
+  saveCursor();
+}
+
+void FlashQueue::loadCursor() {
+  File f = _fs->open(_dir + "/cursor", FILE_READ);
+  Cursor c;
+  if (f && f.read((uint8_t*)&c, sizeof(c)) == sizeof(c)) { _headSeg = c.seg; _headOffset = c.offset; }
+  if (f) f.close();
+}
+
+void FlashQueue::saveCursor() {
+  File f = _fs->open(_dir + "/cursor", FILE_WRITE);
+  if (!f) return;
+  Cursor c = { _headSeg, _headOffset };
+  f.write((const uint8_t*)&c, sizeof(c));
+  f.close();
+}
@@ -0,0 +1,203 @@
+#include "HttpSession.h"
+
+HttpSession::HttpSession(const char* baseUrl) {
+  // Split "http[s]://host[:port]/path" so we can open the socket ourselves and time it.
+  strlcpy(_baseUrl, baseUrl, sizeof(_baseUrl));
+  if (strncmp(_baseUrl, "http://", 7) == 0) { _client = &_plainClient; _port = 80; }
+  const char* hostStart = strstr(_baseUrl, "://");
+  hostStart = (hostStart == nullptr) ? _baseUrl : hostStart + 3;
+  const char* pathStart = strchr(hostStart, '/');
+  if (pathStart != nullptr) _path = pathStart;
+  size_t hostLen = (pathStart == nullptr) ? strlen(hostStart) : (size_t)(pathStart - hostStart);
+  const char* colon = (const char*)memchr(hostStart, ':', hostLen);
+  if (colon != nullptr) { _port = atoi(colon + 1); _defaultPort = false; hostLen = colon - hostStart; }
+  if (hostLen >= sizeof(_host)) hostLen = sizeof(_host) - 1;
+  memcpy(_host, hostStart, hostLen); _host[hostLen] = '\0';
+
+  _secureClient.setInsecure();
+  _http.setReuse(true);
+}
+
+bool HttpSession::ensureConnected() {
+  if (_client->connected()) return true;
+  unsigned long start = millis();
+  bool ok = _client->connect(_host, _port);
+  _timing.handshakeMs = millis() - start;
+  _timing.reused = false;
+  if (ok) _handshakes++;
+  return ok;
+}
+
+// --- Fixed-buffer requests ---
+
+int HttpSession::request(const char* method, const HttpHeader* headers, size_t headerCount, const uint8_t* body, size_t bodyLen) {
+  _timing = HttpTiming();
+  _timing.reused = _client->connected();
+  if (!formatHead(method, headers, headerCount, bodyLen)) return HTTPC_ERROR_TOO_LESS_RAM;
+  if (!ensureConnected()) return HTTPC_ERROR_CONNECTION_REFUSED;
+  _requests++;
+  unsigned long start = millis();
+  int code = exchange(body, bodyLen);
+
+  // A reused socket may have been closed by the server while idle; retry once on a fresh one.
+  // Not after a timeout: the server may have received the request.
+  bool staleSocket = (code == HTTPC_ERROR_SEND_HEADER_FAILED || code == HTTPC_ERROR_SEND_PAYLOAD_FAILED ||
+                      code == HTTPC_ERROR_CONNECTION_LOST);
+  if (staleSocket && _timing.reused) {
+    _client->stop();
+    if (ensureConnected()) {
+      start = millis();
+      code = exchange(body, bodyLen);
+    }
+  }
+  _timing.transferMs = millis() - start;
+  if (code < 0 || !_keepAlive) _client->stop();
+  return code;
+}
+
+bool HttpSession::formatHead(const char* method, const HttpHeader* headers, size_t headerCount, size_t bodyLen) {
+  int n = _defaultPort
+      ? snprintf(_head, sizeof(_head), "%s %s HTTP/1.1\r\nHost: %s\r\n", method, _path, _host)
+      : snprintf(_head, sizeof(_head), "%s %s HTTP/1.1\r\nHost: %s:%u\r\n", method, _path, _host, (unsigned)_port);
+  if (n < 0 || (size_t)n >= sizeof(_head)) return false;
+  size_t len = n;
+  for (size_t i = 0; i < headerCount; ++i) {
+    n = snprintf(_head + len, sizeof(_head) - len, "%s: %s\r\n", headers[i].name, headers[i].value);
+    if (n < 0 || (size_t)n >= sizeof(_head) - len) return false;
+    len += n;
+  }
+  n = snprintf(_head + len, sizeof(_head) - len, "Connection: keep-alive\r\nContent-Length: %u\r\n\r\n", (unsigned)bodyLen);
+  if (n < 0 || (size_t)n >= sizeof(_head) - len) return false;
+  _headLen = len + n;
+  return true;
+}
+
+int HttpSession::exchange(const uint8_t* body, size_t bodyLen) {
+  if (_client->write((const uint8_t*)_head, _headLen) != _headLen) return HTTPC_ERROR_SEND_HEADER_FAILED;
+  if (bodyLen > 0 && _client->write(body, bodyLen) != bodyLen) return HTTPC_ERROR_SEND_PAYLOAD_FAILED;
+  return readResponse();
+}
+
+// Status line and headers; the body is read and dropped so the connection can be reused.
+int HttpSession::readResponse() {
+  uint32_t deadline = millis() + RESPONSE_TIMEOUT_MS;
+  int status;
+  long contentLength;
+  bool chunked;
+  do { // Skip interim 1xx responses
+    int n = readLine(deadline);
+    if (n < 0) return n;
+    if (strncmp(_line, "HTTP/1.", 7) != 0 || n < 12) return HTTPC_ERROR_NO_HTTP_SERVER;
+    _keepAlive = _line[7] == '1'; // HTTP/1.1 defaults to keep-alive, 1.0 does not
+    status = atoi(_line + 9);
+    contentLength = -1; chunked = false;
+    while ((n = readLine(deadline)) > 0) {
+      if (strncasecmp(_line, "Content-Length:", 15) == 0) contentLength = atol(_line + 15);
+      else if (strncasecmp(_line, "Transfer-Encoding:", 18) == 0) chunked = strstr(_line + 18, "chunked") != nullptr;
+      else if (strncasecmp(_line, "Connection:", 11) == 0) _keepAlive = strcasestr(_line + 11, "close") == nullptr;
+    }
+    if (n < 0) return n;
+  } while (status >= 100 && status < 200);
+
+  if (status == 204 || status == 304) return status;
+  if (chunked) {
+    for (;;) {
+      int n = readLine(deadline);
+      if (n < 0) return n;
+      size_t chunk = strtoul(_line, nullptr, 16);
+      if (chunk == 0) { while ((n = readLine(deadline)) > 0) {} return n < 0 ? n : status; } // Trailers
+      if ((n = discard(chunk, deadline)) < 0) return n;
+      if ((n = readLine(deadline)) < 0) return n; // CRLF after the chunk
+    }
+  }
+  if (contentLength >= 0) {
+    int n = discard(contentLength, deadline);
+    return n < 0 ? n : status;
+  }
+  _keepAlive = false; // Body ends when the server closes the connection
+  return status;
+}
+
+// Reads one line into _line without the line ending (long lines are truncated). Returns its length.
+int HttpSession::readLine(uint32_t deadline) {
+  size_t n = 0;
+  for (;;) {
+    int c = _client->read();
+    if (c < 0) {
+      if (!_client->connected()) return HTTPC_ERROR_CONNECTION_LOST;
+      if ((int32_t)(millis() - deadline) >= 0) return HTTPC_ERROR_READ_TIMEOUT;
+      delay(1);
+      continue;
+    }
+    if (c == '\n') break;
+    if (c != '\r' && n < sizeof(_line) - 1) _line[n++] = (char)c;
+  }
+  _line[n] = '\0';
+  return n;
+}
+
+int HttpSession::discard(size_t length, uint32_t deadline) {
+  while (length > 0) {
+    int n = _client->read((uint8_t*)_line, length < sizeof(_line) ? length : sizeof(_line));
+    if (n > 0) { length -= n; continue; }
+    if (!_client->connected()) return HTTPC_ERROR_CONNECTION_LOST;
+    if ((int32_t)(millis() - deadline) >= 0) return HTTPC_ERROR_READ_TIMEOUT;
+    delay(1);
+  }
+  return 0;
+}
+
+// --- HTTPClient requests ---
+
+bool HttpSession::begin(const char* urlSuffix) {
+  _timing = HttpTiming();
+  _timing.reused = _client->connected();
+  if (!ensureConnected()) return false;
+  snprintf(_url, sizeof(_url), "%s%s", _baseUrl, urlSuffix);
+  return _http.begin(*_client, _url);
+}
+
+int HttpSession::sendRequest(const char* method, const uint8_t* body, size_t bodyLen) {
+  _requests++;
+  unsigned long start = millis();
+  int code = _http.sendRequest(method, const_cast<uint8_t*>(body), bodyLen);
+
+  // A reused socket may have been closed by the server while idle; retry once on a fresh one.
+  bool staleSocket = (code == HTTPC_ERROR_SEND_HEADER_FAILED || code == HTTPC_ERROR_SEND_PAYLOAD_FAILED ||
+                      code == HTTPC_ERROR_CONNECTION_LOST || code == HTTPC_ERROR_NOT_CONNECTED);
+  if (staleSocket && _timing.reused) {
+    _client->stop();
+    if (ensureConnected()) {
+      start = millis();
+      code = _http.sendRequest(method, const_cast<uint8_t*>(body), bodyLen);
+    }
+  }
+  _timing.transferMs = millis() - start;
+  return code;
+}
+
+void HttpSession::end() {
+  _http.end(); // With setReuse(true) this keeps the socket open if the response allowed it
+}
+
+void HttpSession::close() {
+  _http.end();
+  _client->stop();
+}
+
+const char* httpErrorName(int code) {
+  switch (code) {
+    case HTTPC_ERROR_CONNECTION_REFUSED: return "connection refused";
+    case HTTPC_ERROR_SEND_HEADER_FAILED: return "send header failed";
+    case HTTPC_ERROR_SEND_PAYLOAD_FAILED: return "send payload failed";
+    case HTTPC_ERROR_NOT_CONNECTED: return "not connected";
+    case HTTPC_ERROR_CONNECTION_LOST: return "connection lost";
+    case HTTPC_ERROR_NO_STREAM: return "no stream";
+    case HTTPC_ERROR_NO_HTTP_SERVER: return "no HTTP server";
+    case HTTPC_ERROR_TOO_LESS_RAM: return "too less ram";
+    case HTTPC_ERROR_ENCODING: return "Transfer-Encoding not supported";
+    case HTTPC_ERROR_STREAM_WRITE: return "Stream write error";
+    case HTTPC_ERROR_READ_TIMEOUT: return "read Timeout";
+    default: return "unknown error";
+  }
+}
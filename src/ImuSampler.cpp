@@ -0,0 +1,121 @@
+#include "ImuSampler.h"
+
+namespace {
+  // MPU6886 registers (datasheet rev 1.1)
+  const uint8_t MPU6886_ADDR = 0x68;
+  const uint8_t REG_SMPLRT_DIV = 0x19;
+  const uint8_t REG_CONFIG = 0x1A;        // bit6 FIFO_MODE (1: stop when full), bits2:0 gyro DLPF
+  const uint8_t REG_ACCEL_CONFIG = 0x1C;  // bits4:3 full scale
+  const uint8_t REG_ACCEL_CONFIG2 = 0x1D; // bits2:0 accel DLPF
+  const uint8_t REG_FIFO_EN = 0x23;       // bit4 gyro, bit3 accel (temperature always comes along)
+  const uint8_t REG_INT_STATUS = 0x3A;    // bit4 FIFO overflow (clears on read)
+  const uint8_t REG_USER_CTRL = 0x6A;     // bit6 FIFO enable, bit2 FIFO reset
+  const uint8_t REG_FIFO_COUNTH = 0x72;
+  const uint8_t REG_FIFO_R_W = 0x74;
+
+  // Accel only, but the chip (an ICM-20602) still queues TEMP_OUT with it: each packet is
+  // accel X, Y, Z then temperature, big-endian int16; only the first 6 bytes are used
+  const size_t PACKET_BYTES = 8;
+  const size_t FIFO_BYTES = 1024;
+  const uint32_t I2C_FREQ = 400000;
+
+  // Accel DLPF setting whose bandwidth stays below half the sample rate
+  uint8_t accelDlpfFor(uint16_t rateHz) {
+    if (rateHz >= 500) return 1; // 218 Hz
+    if (rateHz >= 200) return 2; // 99 Hz
+    if (rateHz >= 100) return 3; // 45 Hz
+    return 4;                    // 21 Hz
+  }
+
+  int16_t be16(const uint8_t* p) { return (int16_t)((p[0] << 8) | p[1]); }
+}
+
+bool ImuSampler::writeReg(uint8_t reg, uint8_t value) {
+  return M5.In_I2C.writeRegister8(MPU6886_ADDR, reg, value, I2C_FREQ);
+}
+
+bool ImuSampler::readRegs(uint8_t reg, uint8_t* out, size_t len) {
+  return M5.In_I2C.readRegister(MPU6886_ADDR, reg, out, len, I2C_FREQ);
+}
+
+bool ImuSampler::begin(uint16_t rateHz, uint16_t pollRateHz) {
+  _rateHz = _pollRateHz = pollRateHz; _fifo = false;
+  if (!M5.Imu.isEnabled()) return false;
+  if (M5.Imu.getType() != m5::imu_t::imu_mpu6886) { Serial.println("IMU: no FIFO driver for this chip, polling."); return true; }
+
+  // M5Unified has already woken the chip and set the full scale; keep that range
+  uint8_t accelConfig = 0;
+  if (!readRegs(REG_ACCEL_CONFIG, &accelConfig, 1)) return true;
+  _lsbPerG = 16384.0f / (1 << ((accelConfig >> 3) & 0x03));
+
+  uint8_t div = (uint8_t)(1000 / rateHz - 1); // Internal rate is 1 kHz with the DLPF on
+  uint16_t fifoRate = 1000 / (div + 1);
+  bool ok = writeReg(REG_SMPLRT_DIV, div)
+         && writeReg(REG_CONFIG, 0x40 | 0x01)                 // Stop-when-full keeps packets aligned on overflow
+         && writeReg(REG_ACCEL_CONFIG2, accelDlpfFor(fifoRate))
+         && writeReg(REG_FIFO_EN, 0x08);                     // Accel (+ temp): 8 B packets, 128 fit
+  if (!ok) { Serial.println("IMU: FIFO setup failed, polling."); return true; }
+  _rateHz = fifoRate;
+  resetFifo();
+  _fifo = true;
+  Serial.printf("IMU: MPU6886 FIFO at %u Hz (%.0f LSB/g)\n", _rateHz, _lsbPerG);
+  return true;
+}
+
+// The IMU's interrupt line is not wired to a wake-capable pin, so a sleeping loop() comes back
+// for the FIFO on a deadline, leaving a third of it as slack for a slow pass
+uint32_t ImuSampler::maxDrainIntervalMs() {
+  if (!_fifo) return _pollRateHz ? 1000 / _pollRateHz : 0;
+  const uint32_t fifoPackets = FIFO_BYTES / PACKET_BYTES;
+  return fifoPackets * 1000 / _rateHz * 2 / 3;
+}
+
+void ImuSampler::resetFifo() {
+  writeReg(REG_USER_CTRL, 0x04); // Reset (self-clearing)
+  writeReg(REG_USER_CTRL, 0x40); // Enable
+  uint8_t status; readRegs(REG_INT_STATUS, &status, 1); // Clear a stale overflow flag
+  _nextSampleMs = millis();
+}
+
+size_t ImuSampler::drain(ImuSample* out, size_t max) {
+  if (max == 0) return 0;
+  uint32_t now = millis();
+  if (!_fifo) {
+    M5.Imu.getAccelData(&out[0].ax, &out[0].ay, &out[0].az); out[0].tMs = now;
+    _samples++;
+    return 1;
+  }
+
+  uint8_t countBytes[2], status;
+  if (!readRegs(REG_INT_STATUS, &status, 1) || !readRegs(REG_FIFO_COUNTH, countBytes, 2)) return 0;
+  if (status & 0x10) { // Full: the samples in it are older than we can place in time, start over
+    _overflows++; resetFifo();
+    return 0;
+  }
+  size_t packets = (((countBytes[0] & 0x1F) << 8) | countBytes[1]) / PACKET_BYTES;
+  if (packets > _maxBacklog) _maxBacklog = packets;
+
+  // Timestamps: packets come out at exactly 1/rate apart; resync if we drifted from the clock.
+  // The oldest packet is placed from the whole backlog, not just the part read this call.
+  uint32_t periodUs = 1000000UL / _rateHz;
+  uint32_t firstMs = now - (uint32_t)((packets * (uint64_t)periodUs) / 1000);
+  if ((int32_t)(firstMs - _nextSampleMs) > 50 || (int32_t)(_nextSampleMs - firstMs) > 50) _nextSampleMs = firstMs;
+  if (packets > max) packets = max;
+
+  uint8_t buf[PACKET_BYTES * 8];
+  size_t done = 0;
+  while (done < packets) {
+    size_t chunk = packets - done; if (chunk > 8) chunk = 8;
+    if (!readRegs(REG_FIFO_R_W, buf, chunk * PACKET_BYTES)) break;
+    for (size_t i = 0; i < chunk; ++i) {
+      const uint8_t* p = buf + i * PACKET_BYTES;
+      ImuSample& s = out[done + i];
+      s.ax = be16(p) / _lsbPerG; s.ay = be16(p + 2) / _lsbPerG; s.az = be16(p + 4) / _lsbPerG;
+      s.tMs = _nextSampleMs + (uint32_t)(((done + i) * (uint64_t)periodUs) / 1000);
+    }
+    done += chunk;
+  }
+  _nextSampleMs += (uint32_t)((done * (uint64_t)periodUs) / 1000);
+  _samples += done;
+  return done;
+}
@@ -0,0 +1,96 @@
+#include "LoopProfiler.h"
+
+// --- LatencyHistogram ---
+
+size_t LatencyHistogram::bucketOf(uint32_t value) {
+  if (value < 8) return value;
+  int e = 31 - __builtin_clz(value);           // 2^e <= value, e >= 3
+  size_t bucket = 8 + (e - 3) * 4 + ((value >> (e - 2)) & 3);
+  return bucket < BUCKETS ? bucket : BUCKETS - 1;
+}
+
+uint32_t LatencyHistogram::bucketUpper(size_t bucket) {
+  if (bucket < 8) return bucket;
+  int e = (bucket - 8) / 4 + 3;
+  uint32_t step = 1u << (e - 2);
+  return (4 + (bucket - 8) % 4) * step + step - 1;
+}
+
+void LatencyHistogram::record(uint32_t value) {
+  _counts[bucketOf(value)]++; _count++;
+  if (value > _max) _max = value;
+}
+
+void LatencyHistogram::reset() {
+  for (auto& c : _counts) c = 0;
+  _count = 0; _max = 0;
+}
+
+uint32_t LatencyHistogram::percentile(float p) const {
+  if (_count == 0) return 0;
+  uint32_t rank = (uint32_t)(p * _count + 0.5f);
+  if (rank == 0) rank = 1;
+  uint32_t seen = 0;
+  for (size_t b = 0; b < BUCKETS; ++b) {
+    seen += _counts[b];
+    if (seen >= rank) { uint32_t upper = bucketUpper(b); return upper < _max ? upper : _max; }
+  }
+  return _max;
+}
+
+// --- LoopProfiler ---
+
+void LoopProfiler::begin(uint32_t nowMs) {
+  clockChanged();
+  _windowStartMs = nowMs;
+}
+
+void LoopProfiler::clockChanged() {
+#ifdef ARDUINO
+  _ticksPerUs = getCpuFrequencyMhz();
+#else
+  _ticksPerUs = 1000;
+#endif
+}
+
+uint32_t LoopProfiler::lap(LoopStage stage, uint32_t start) {
+  uint32_t t = profilerTicks();
+  _stages[(size_t)stage].record((t - start) / _ticksPerUs);
+  return t;
+}
+
+void LoopProfiler::recordHttp(int16_t httpCode, uint32_t latencyMs) {
+  if (httpCode <= 0) { _httpErr++; return; }
+  if (httpCode >= 200 && httpCode < 300) _httpOk++;
+  else if (httpCode >= 500) _http5xx++;
+  else _http4xx++; // Other 1xx/3xx/4xx: the request was not accepted either
+  _http.record(latencyMs);
+}
+
+void LoopProfiler::recordSystem(const SystemStats& stats) {
+  _system = stats;
+  if (stats.largestBlock < _minLargestBlock) _minLargestBlock = stats.largestBlock;
+}
+
+const PerfSummary& LoopProfiler::roll(uint32_t nowMs) {
+  PerfSummary& s = _last;
+  s.seq = ++_seq;
+  s.windowMs = nowMs - _windowStartMs;
+  s.passes = _stages[(size_t)LoopStage::Touch].count();
+  for (size_t i = 0; i < LOOP_STAGES; ++i) {
+    s.stages[i].p50Us = _stages[i].percentile(0.5f);
+    s.stages[i].p99Us = _stages[i].percentile(0.99f);
+    s.stages[i].maxUs = _stages[i].max();
+    _stages[i].reset();
+  }
+  s.httpOk = _httpOk; s.http4xx = _http4xx; s.http5xx = _http5xx; s.httpErr = _httpErr;
+  s.httpP50Ms = _http.percentile(0.5f); s.httpP99Ms = _http.percentile(0.99f);
+  s.freeHeap = _system.freeHeap; s.minFreeHeap = _system.minFreeHeap;
+  s.minLargestBlock = minLargestBlock();
+  s.rssi = _system.rssi;
+
+  _http.reset(); _httpOk = _http4xx = _http5xx = _httpErr = 0;
+  _minLargestBlock = UINT32_MAX;
+  _windowStartMs = nowMs;
+  return s;
+}
@@ -0,0 +1,144 @@
+#include "M5Ui.h"
+
+namespace {
+  bool pointInRect(int x, int y, int rx, int ry, int rw, int rh) {
+    return (x >= rx && x <= rx + rw && y >= ry && y <= ry + rh);
+  }
+}
+
+void M5Ui::begin(const char* userId, unsigned long touchDebounceMs, uint32_t displayTimeoutMs) { // Sprite-backed fields for everything that changes at runtime
+  _userId = userId; _touchDebounceMs = touchDebounceMs;
+  _displayTimeoutMs = displayTimeoutMs; _lastActivityMs = millis();
+  M5.Touch.begin(&M5.Display); // Initialize Touch for buttons
+  _renderer.begin(M5.Display);
+  bool ok = _clockField.begin(_renderer, Layout::dataValueX + 1, Layout::headerY + 1, 320 - Layout::dataValueX - 12, Layout::headerH - 2,
+                              WHITE, BLACK, 4, 4);
+  for (size_t i = 0; i < VALUE_ROWS; ++i) {
+    ok &= _valueFields[i].begin(_renderer, Layout::dataValueX, Layout::dataAreaY + i * Layout::dataRowH, 320 - Layout::dataValueX - 10, Layout::dataRowH);
+  }
+  ok &= _logStatusField.begin(_renderer, Layout::logStatusX, Layout::logTitleY, 320 - Layout::logStatusX - 5, Layout::headerH - 5,
+                              TFT_LIGHTGREY, BLACK);
+  for (int row = 0; row < Layout::logRows; ++row) {
+    ok &= _logRowFields[row].begin(_renderer, Layout::logTimestampX, Layout::logEntryY + row * Layout::logEntryH, 320 - Layout::logTimestampX,
+                                   Layout::logEntryH, WHITE, BLACK, 0, 0, Layout::logEventX - Layout::logTimestampX);
+  }
+  for (int row = 0; row < Layout::diagRows; ++row) {
+    ok &= _diagRowFields[row].begin(_renderer, Layout::logTimestampX, Layout::diagEntryY + row * Layout::diagEntryH, 320 - Layout::logTimestampX,
+                                    Layout::diagEntryH, WHITE, BLACK, 0, 0, Layout::diagValueX - Layout::logTimestampX);
+  }
+  if (!ok) Serial.println("Sprite allocation failed, drawing text directly.");
+}
+
+void M5Ui::showPage(UiPage page) { // Main drawing router
+  _page = page;
+  _renderer.clearScreen(BLACK); // Clear screen before drawing page (fields redraw on their next set())
+  if (page == UiPage::Main) drawMainPage();
+  else if (page == UiPage::Log) drawLogPage();
+  else drawDiagPage();
+}
+
+void M5Ui::drawMainPage() { // Draw static parts of Main Page
+  M5.Lcd.setTextSize(2); M5.Lcd.setTextColor(WHITE, BLACK);
+  // Header
+  M5.Lcd.drawRect(Layout::dataValueX, Layout::headerY, 320 - Layout::dataValueX - 10, Layout::headerH, WHITE);
+  M5.Lcd.setCursor(10, Layout::headerY + 5); M5.Lcd.print(_userId);
+  // Sensor Labels
+  int currentY = Layout::dataAreaY;
+  M5.Lcd.setCursor(Layout::dataLabelX, currentY); M5.Lcd.print("Proximity:"); currentY += Layout::dataRowH;
+  M5.Lcd.setCursor(Layout::dataLabelX, currentY); M5.Lcd.print("Amb Light:"); currentY += Layout::dataRowH;
+  M5.Lcd.setCursor(Layout::dataLabelX, currentY); M5.Lcd.print("White Light:"); currentY += Layout::dataRowH;
+  M5.Lcd.setCursor(Layout::dataLabelX, currentY); M5.Lcd.print("Temp (C):"); currentY += Layout::dataRowH;
+  M5.Lcd.setCursor(Layout::dataLabelX, currentY); M5.Lcd.print("Humidity (%):");
+  drawButton(Layout::logButtonX, Layout::logButtonW, TFT_BLUE, "View Log");
+  drawButton(Layout::diagButtonX, Layout::diagButtonW, TFT_DARKGREEN, "Diagnostics");
+}
+
+void M5Ui::drawLogPage() { // Draw static parts of Log Page
+  M5.Lcd.setTextSize(2); M5.Lcd.setTextColor(WHITE, BLACK);
+  M5.Lcd.setCursor(Layout::dataLabelX, Layout::logTitleY); M5.Lcd.print("Upload Log");
+  drawButton(Layout::backButtonX, Layout::backButtonW, TFT_DARKGREY, "Back");
+  drawButton(Layout::olderButtonX, Layout::pageButtonW, TFT_BLUE, "Older");
+  drawButton(Layout::newerButtonX, Layout::pageButtonW, TFT_BLUE, "Newer");
+}
+
+void M5Ui::drawDiagPage() { // Draw static parts of Diagnostics Page
+  M5.Lcd.setTextSize(2); M5.Lcd.setTextColor(WHITE, BLACK);
+  M5.Lcd.setCursor(Layout::dataLabelX, Layout::logTitleY); M5.Lcd.print("Stage ms: p50 p99 max");
+  drawButton(Layout::backButtonX, Layout::backButtonW, TFT_DARKGREY, "Back");
+}
+
+void M5Ui::drawButton(int x, int w, uint16_t fill, const char* label) {
+  M5.Lcd.fillRect(x, Layout::buttonY, w, Layout::buttonH, fill);
+  M5.Lcd.drawRect(x, Layout::buttonY, w, Layout::buttonH, TFT_WHITE);
+  M5.Lcd.setTextColor(TFT_WHITE);
+  int textWidth = M5.Lcd.textWidth(label); int textHeight = M5.Lcd.fontHeight();
+  M5.Lcd.setCursor(x + (w - textWidth) / 2, Layout::buttonY + (Layout::buttonH - textHeight) / 2);
+  M5.Lcd.print(label); M5.Lcd.setTextColor(WHITE, BLACK);
+}
+
+void M5Ui::setLogRow(size_t row, const char* time, const char* event) {
+  if (row >= (size_t)Layout::logRows) return;
+  _logRowFields[row].set(time, (event && event[0]) ? event : nullptr);
+}
+
+void M5Ui::setDiagRow(size_t row, const char* label, const char* value) {
+  if (row >= (size_t)Layout::diagRows) return;
+  _diagRowFields[row].set(label, (value && value[0]) ? value : nullptr);
+}
+
+void M5Ui::showPopup(const char* message) { // Composited over the page, which is kept underneath
+  _renderer.showPopup(message, TFT_ORANGE, TFT_WHITE);
+}
+
+UiButton M5Ui::pollButton() {
+  auto t = M5.Touch.getDetail(); // Read touch status structure
+  uint32_t now = millis();
+  if (t.isPressed()) _lastActivityMs = now;
+  if (_asleep && t.wasPressed()) { wakeDisplay(); _swallowTouch = true; }
+  if (_swallowTouch) { if (!t.isPressed()) _swallowTouch = false; return UiButton::None; }
+  if (!_asleep && _displayTimeoutMs != 0 && now - _lastActivityMs >= _displayTimeoutMs) sleepDisplay();
+  if (_asleep) return UiButton::None;
+  if (_page == UiPage::Log && t.wasFlicked()) return pollFlick(t); // Reported on release, no debounce needed
+  if (!t.wasPressed()) return UiButton::None;
+  // Check debounce only on initial press
+  if (millis() - _lastTouchTime < _touchDebounceMs) return UiButton::None;
+  _lastTouchTime = millis(); // Record time of valid press
+
+  if (_page == UiPage::Main && pointInRect(t.x, t.y, Layout::logButtonX, Layout::buttonY, Layout::logButtonW, Layout::buttonH)) {
+    return UiButton::ViewLog;
+  }
+  if (_page == UiPage::Main && pointInRect(t.x, t.y, Layout::diagButtonX, Layout::buttonY, Layout::diagButtonW, Layout::buttonH)) {
+    return UiButton::ViewDiag;
+  }
+  if (_page != UiPage::Main && pointInRect(t.x, t.y, Layout::backButtonX, Layout::buttonY, Layout::backButtonW, Layout::buttonH)) {
+    return UiButton::Back;
+  }
+  if (_page == UiPage::Log && pointInRect(t.x, t.y, Layout::olderButtonX, Layout::buttonY, Layout::pageButtonW, Layout::buttonH)) {
+    return UiButton::LogOlder;
+  }
+  if (_page == UiPage::Log && pointInRect(t.x, t.y, Layout::newerButtonX, Layout::buttonY, Layout::pageButtonW, Layout::buttonH)) {
+    return UiButton::LogNewer;
+  }
+  return UiButton::None;
+}
+
+// Backlight off and the panel in sleep mode; its memory keeps the page for the wake
+void M5Ui::sleepDisplay() {
+  _brightness = M5.Display.getBrightness();
+  M5.Display.setBrightness(0);
+  M5.Display.sleep();
+  _asleep = true;
+}
+
+void M5Ui::wakeDisplay() {
+  M5.Display.wakeup();
+  M5.Display.setBrightness(_brightness);
+  _asleep = false; _lastActivityMs = millis();
+}
+
+// Log rows are newest first: flicking up brings older ones in; sideways steps an hour (right: back in time)
+UiButton M5Ui::pollFlick(const m5::touch_detail_t& t) {
+  int dx = t.distanceX(), dy = t.distanceY();
+  if (abs(dy) >= abs(dx)) return dy < 0 ? UiButton::ScrollOlder : UiButton::ScrollNewer;
+  return dx > 0 ? UiButton::HourOlder : UiButton::HourNewer;
+}
@@ -0,0 +1,111 @@
+#include "MotionAnalyzer.h"
+#include <math.h>
+
+namespace {
+  const float GRAVITY_CUTOFF_HZ = 0.5f; // Slower than any shake; tracks orientation changes
+  const float SDFT_DAMPING = 0.9999f;
+  const float PI_F = 3.14159265f;
+}
+
+void MotionAnalyzer::WindowMax::push(float v, uint32_t n) {
+  while (count && seq[head] + WINDOW <= n) { head = (head + 1) % WINDOW; count--; } // Expired
+  while (count && value[(head + count - 1) % WINDOW] <= v) count--;                 // Dominated
+  size_t tail = (head + count) % WINDOW;
+  value[tail] = v; seq[tail] = n; count++;
+}
+
+void MotionAnalyzer::begin(const MotionConfig& config) {
+  _cfg = config;
+  _gravityAlpha = 1.0f - expf(-2.0f * PI_F * GRAVITY_CUTOFF_HZ / config.sampleRateHz);
+  for (size_t k = 0; k <= BINS; ++k) {
+    float w = 2.0f * PI_F * k / WINDOW;
+    _twRe[k] = SDFT_DAMPING * cosf(w); _twIm[k] = SDFT_DAMPING * sinf(w);
+    for (int a = 0; a < 3; ++a) _binRe[a][k] = _binIm[a][k] = 0;
+  }
+  _rN = powf(SDFT_DAMPING, (float)WINDOW);
+  for (size_t i = 0; i < WINDOW; ++i) { _dyn[i] = 0; for (int a = 0; a < 3; ++a) _axis[a][i] = 0; }
+  _pos = 0; _sumSq = 0; _n = 0; _primed = false;
+  _peak.reset(); _jerk.reset();
+  _active = false; _haveEnded = false; _event = {};
+}
+
+float MotionAnalyzer::rms() const {
+  size_t n = _n < WINDOW ? _n : WINDOW;
+  return n ? sqrtf((float)(_sumSq / n)) : 0.0f;
+}
+
+float MotionAnalyzer::dominantFrequency() const {
+  size_t best = 0; float bestPower = 0;
+  for (size_t k = 1; k <= BINS; ++k) { // Bin 0 is the window mean, not a vibration
+    float p = 0;
+    for (int a = 0; a < 3; ++a) p += _binRe[a][k] * _binRe[a][k] + _binIm[a][k] * _binIm[a][k];
+    if (p > bestPower) { bestPower = p; best = k; }
+  }
+  return best * _cfg.sampleRateHz / WINDOW;
+}
+
+MotionAnalyzer::Result MotionAnalyzer::addSample(float ax, float ay, float az, uint32_t tMs) {
+  if (!_primed) { _gx = _lx = ax; _gy = _ly = ay; _gz = _lz = az; _primed = true; }
+
+  // Gravity removal and per-sample features
+  _gx += _gravityAlpha * (ax - _gx); _gy += _gravityAlpha * (ay - _gy); _gz += _gravityAlpha * (az - _gz);
+  float dx = ax - _gx, dy = ay - _gy, dz = az - _gz;
+  float dyn = sqrtf(dx * dx + dy * dy + dz * dz);
+  float total = sqrtf(ax * ax + ay * ay + az * az);
+  float jx = ax - _lx, jy = ay - _ly, jz = az - _lz;
+  float jerk = sqrtf(jx * jx + jy * jy + jz * jz) * _cfg.sampleRateHz;
+  _lx = ax; _ly = ay; _lz = az;
+
+  // Window updates: the sample leaving the window is the one being overwritten
+  float old = _dyn[_pos];
+  const float in[3] = { dx, dy, dz };
+  for (int a = 0; a < 3; ++a) {
+    float delta = in[a] - _rN * _axis[a][_pos];
+    _axis[a][_pos] = in[a];
+    for (size_t k = 1; k <= BINS; ++k) {
+      float re = _binRe[a][k] + delta, im = _binIm[a][k];
+      _binRe[a][k] = re * _twRe[k] - im * _twIm[k];
+      _binIm[a][k] = re * _twIm[k] + im * _twRe[k];
+    }
+  }
+  _dyn[_pos] = dyn; _pos = (_pos + 1) % WINDOW;
+  _sumSq += (double)dyn * dyn - (double)old * old;
+  if (_pos == 0) { // Once per window: recompute the sum so rounding cannot accumulate
+    _sumSq = 0;
+    for (size_t i = 0; i < WINDOW; ++i) _sumSq += (double)_dyn[i] * _dyn[i];
+  }
+  _peak.push(total, _n); _jerk.push(jerk, _n);
+  _n++;
+  if (_n < WINDOW) return Result::None; // Gravity estimate and window still settling
+
+  float windowRms = rms();
+  if (!_active) {
+    bool cooling = _haveEnded && tMs - _lastEndMs < _cfg.cooldownMs;
+    if (cooling || (windowRms < _cfg.shakeRmsG && total < _cfg.impactPeakG)) return Result::None;
+    _active = true; _quiet = false;
+    _event = {};
+    _event.kind = MotionKind::Impact; _event.startMs = tMs;
+    _event.rmsG = windowRms; _event.freqHz = dominantFrequency();
+    _lastLoudMs = tMs;
+  }
+
+  // Active event: keep the extremes
+  _event.samples++;
+  _event.durationMs = (uint16_t)(tMs - _event.startMs);
+  if (windowRms > _event.rmsG) { _event.rmsG = windowRms; _event.freqHz = dominantFrequency(); }
+  if (total > _event.peakG) _event.peakG = total;
+  if (jerk > _event.jerkGps) _event.jerkGps = jerk;
+  if (dyn >= _cfg.shakeRmsG) _lastLoudMs = tMs;
+  if (_event.samples == 1) return Result::Onset;
+
+  if (windowRms >= _cfg.shakeRmsG * 0.5f) _quiet = false;
+  else if (!_quiet) { _quiet = true; _quietSinceMs = tMs; }
+  bool released = _quiet && tMs - _quietSinceMs >= _cfg.releaseMs;
+  if (!released && tMs - _event.startMs < _cfg.maxEventMs) return Result::None;
+
+  // The window keeps a knock "loud" for WINDOW samples; its duration is the span of loud samples
+  _event.durationMs = (uint16_t)(_lastLoudMs - _event.startMs);
+  _event.kind = (_event.durationMs >= _cfg.minShakeMs && _event.rmsG >= _cfg.shakeRmsG) ? MotionKind::Shake : MotionKind::Impact;
+  _active = false; _haveEnded = true; _lastEndMs = tMs;
+  return Result::Completed;
+}
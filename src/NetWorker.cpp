@@ -0,0 +1,260 @@
+#include "NetWorker.h"
+#include <assert.h>
+#include <WiFi.h>
+#include "ClockService.h"
+#include <ArduinoJson.h>
+#include "AllocCounter.h"
+
+// Build with -DNET_SIM_DELAY_MS=<ms> to emulate a slow server on every request.
+#ifndef NET_SIM_DELAY_MS
+#define NET_SIM_DELAY_MS 0
+#endif
+
+namespace {
+  const uint32_t WIFI_CONNECT_TIMEOUT_MS = 10000;
+  const uint32_t FAST_CONNECT_TIMEOUT_MS = 2000; // Cached AP: association takes ~100-300 ms when it works
+  const uint32_t CONNECT_POLL_MS = 100;          // Fallback to the WiFi events while waiting for an IP
+  const uint32_t WIFI_RETRY_MIN_MS = 1000;
+  const uint32_t WIFI_RETRY_MAX_MS = 60000;
+
+  static_assert(NET_ERROR_NOT_CONNECTED == HTTPC_ERROR_NOT_CONNECTED, "NetTypes.h error code out of sync with HTTPClient");
+  static_assert(NET_ERROR_TOO_LESS_RAM == HTTPC_ERROR_TOO_LESS_RAM, "NetTypes.h error code out of sync with HTTPClient");
+
+  void simulateServerDelay() {
+    if (NET_SIM_DELAY_MS > 0) vTaskDelay(pdMS_TO_TICKS(NET_SIM_DELAY_MS));
+  }
+}
+
+bool NetWorker::begin(const NetWorkerConfig& config) {
+  _cfg = config;
+  _format = config.payloadFormat;
+  _wifiRetryDelayMs = WIFI_RETRY_MIN_MS;
+  _spooledSamples = _cfg.spool ? _cfg.spool->size() : 0;
+  _jobs = xQueueCreate(JOB_QUEUE_DEPTH, sizeof(UploadJob));
+  _events = xQueueCreate(EVENT_QUEUE_DEPTH, sizeof(NetEvent));
+  if (_jobs == nullptr || _events == nullptr) return false;
+  if (_cfg.fastConnect != FastConnect::Off) _wifiCache.load(_cfg.wifiSsid);
+  // Runs on the WiFi event task: wakes the connect wait in connect() instead of it polling
+  WiFi.onEvent([this](arduino_event_id_t event, arduino_event_info_t) {
+    if (event == ARDUINO_EVENT_WIFI_STA_DISCONNECTED) { _disconnectMs = millis(); _connectFailed = true; }
+    if (_task != nullptr) xTaskNotifyGive(_task);
+  });
+  return xTaskCreatePinnedToCore(taskEntry, "net", TASK_STACK, this, 1, &_task, TASK_CORE) == pdPASS;
+}
+
+bool NetWorker::submitUpload(const UploadJob& job) {
+  return xQueueSend(_jobs, &job, 0) == pdTRUE;
+}
+
+bool NetWorker::pollEvent(NetEvent& event) {
+  return xQueueReceive(_events, &event, 0) == pdTRUE;
+}
+
+const char* NetWorker::errorString(int16_t httpCode) {
+  return httpErrorName(httpCode);
+}
+
+bool NetWorker::postEvent(const NetEvent& event) {
+  if (xQueueSend(_events, &event, 0) == pdTRUE) return true;
+  Serial.println("NetWorker: event queue full, result dropped.");
+  return false;
+}
+
+void NetWorker::taskEntry(void* arg) {
+  static_cast<NetWorker*>(arg)->run();
+}
+
+void NetWorker::run() {
+#ifdef ALLOC_COUNT
+  AllocCounter::watchCurrentTask();
+#endif
+  uint32_t lastDrainTime = 0;
+  WiFi.persistent(false); // The SDK's own flash copy of the config is not needed and costs a write per begin()
+  WiFi.mode(WIFI_STA);
+  for (;;) {
+    if (!ensureWiFi()) continue; // Backs off inside; loop() keeps running meanwhile
+
+    // Wait for a job, waking up regularly to watch WiFi and replay the backlog
+    if (xQueueReceive(_jobs, &_job, pdMS_TO_TICKS(BACKLOG_DRAIN_INTERVAL_MS)) == pdTRUE) {
+      doUpload(_job);
+    } else if (_cfg.spool != nullptr && !_cfg.spool->empty() && millis() - lastDrainTime >= BACKLOG_DRAIN_INTERVAL_MS) {
+      drainBacklog(); // Live uploads go first; the backlog only uses idle time
+      lastDrainTime = millis();
+    }
+  }
+}
+
+bool NetWorker::ensureWiFi() {
+  if (WiFi.status() == WL_CONNECTED) { _wifiRetryDelayMs = WIFI_RETRY_MIN_MS; return true; }
+  if (_linkUp) { // Dropped: time-to-first-upload counts from the disconnect
+    _linkUp = false; _linkStats.drops++;
+    _linkDownMs = _disconnectMs; _firstUploadPending = true;
+  }
+
+  _cfg.uploadSession->close();
+  uint32_t start = millis();
+  bool cached = _cfg.fastConnect != FastConnect::Off && _wifiCache.valid();
+  if (cached && !connect(true)) {
+    Serial.println("NetWorker: cached AP did not answer, scanning.");
+    _linkStats.cacheMisses++;
+    _wifiCache.invalidate();
+    WiFi.disconnect();
+    cached = false;
+  }
+  if (cached || connect(false)) {
+    linkUp(start, cached);
+    return true;
+  }
+
+  // Offline: spool queued batches to flash (or hand them back to loop()), then back off
+  Serial.printf("NetWorker: WiFi connect failed, retrying in %lu ms\n", (unsigned long)_wifiRetryDelayMs);
+  WiFi.disconnect();
+  failQueuedJobs(HTTPC_ERROR_NOT_CONNECTED);
+  vTaskDelay(pdMS_TO_TICKS(_wifiRetryDelayMs));
+  _wifiRetryDelayMs = min(_wifiRetryDelayMs * 2, WIFI_RETRY_MAX_MS);
+  return false;
+}
+
+// Starts an association and waits for the IP, woken by the WiFi events. cached: no scan, straight
+// to the last AP (and its lease with ChannelAndIp); gives up early once the AP turns it down.
+bool NetWorker::connect(bool cached) {
+  const WiFiCache::Entry& entry = _wifiCache.entry();
+  if (cached && _cfg.fastConnect == FastConnect::ChannelAndIp) {
+    WiFi.config(IPAddress(entry.ip), IPAddress(entry.gateway), IPAddress(entry.subnet), IPAddress(entry.dns));
+  } else {
+    WiFi.config(INADDR_NONE, INADDR_NONE, INADDR_NONE); // DHCP
+  }
+  Serial.printf("NetWorker: connecting to WiFi%s...\n", cached ? " (cached AP)" : "");
+  ulTaskNotifyTake(pdTRUE, 0); // Drop wakeups from earlier events
+  _connectFailed = false;
+  if (cached) WiFi.begin(_cfg.wifiSsid, _cfg.wifiPassword, entry.channel, entry.bssid);
+  else WiFi.begin(_cfg.wifiSsid, _cfg.wifiPassword);
+
+  uint32_t start = millis(), timeout = cached ? FAST_CONNECT_TIMEOUT_MS : WIFI_CONNECT_TIMEOUT_MS;
+  for (;;) {
+    if (WiFi.status() == WL_CONNECTED) return true;
+    uint32_t elapsed = millis() - start;
+    if (elapsed >= timeout || (cached && _connectFailed)) return false;
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(min(timeout - elapsed, CONNECT_POLL_MS)));
+  }
+}
+
+void NetWorker::linkUp(uint32_t startMs, bool cached) {
+  _linkUp = true;
+  _wifiRetryDelayMs = WIFI_RETRY_MIN_MS;
+  _linkStats.connects++;
+  if (cached) _linkStats.cachedConnects++;
+  _linkStats.lastConnectMs = millis() - startMs;
+  Serial.printf("NetWorker: connected in %lu ms (%s), IP %s\n", (unsigned long)_linkStats.lastConnectMs,
+                cached ? "cached AP" : "scan", WiFi.localIP().toString().c_str());
+  if (_cfg.fastConnect != FastConnect::Off) _wifiCache.store(_cfg.wifiSsid); // Written only if the AP or lease changed
+  _cfg.clock->startSntp(); // First connect only; lwIP keeps it synced from then on
+
+  NetEvent ev = {};
+  ev.type = NetEventType::LinkUp; ev.success = true; ev.cached = cached; ev.handshakeMs = _linkStats.lastConnectMs;
+  postEvent(ev);
+  _cfg.uploadSession->preconnect(); // TLS handshake while loop() prepares the first batch
+}
+
+// Time from boot or the last drop to the first upload that got through
+void NetWorker::noteUpload(bool success) {
+  if (!success || !_firstUploadPending) return;
+  _firstUploadPending = false;
+  _linkStats.lastFirstUploadMs = millis() - _linkDownMs;
+  Serial.printf("NetWorker: first upload %lu ms after %s (connect %lu ms)\n", (unsigned long)_linkStats.lastFirstUploadMs,
+                _linkStats.drops ? "the link dropped" : "boot", (unsigned long)_linkStats.lastConnectMs);
+}
+
+void NetWorker::failQueuedJobs(int16_t httpCode) {
+  while (xQueueReceive(_jobs, &_job, 0) == pdTRUE) {
+    NetEvent ev = {};
+    ev.type = NetEventType::UploadDone; ev.httpCode = httpCode;
+    ev.count = _job.count; ev.triggerEvent = _job.triggerEvent;
+    ev.spooled = spool(_job);
+    postEvent(ev);
+  }
+}
+
+void NetWorker::doUpload(const UploadJob& job) {
+  NetEvent ev = {};
+#ifdef ALLOC_COUNT
+  uint64_t allocsBefore = AllocCounter::count();
+  bool ok = postBatch(job, ev);
+  checkAllocations(AllocCounter::count() - allocsBefore);
+#else
+  bool ok = postBatch(job, ev);
+#endif
+  if (!ok && uploadRetryable(ev.httpCode)) ev.spooled = spool(job);
+  else if (!ok) drop(ev);
+  postEvent(ev);
+}
+
+#ifdef ALLOC_COUNT
+// An upload over an already open connection must not touch the heap. Opening one (TLS
+// handshake, socket buffers) allocates by design and is only reported.
+void NetWorker::checkAllocations(uint64_t allocs) {
+  bool reused = _cfg.uploadSession->lastTiming().reused;
+  _allocCheckedUploads++;
+  Serial.printf("NetWorker: upload #%lu made %u allocations (%s connection)\n", (unsigned long)_allocCheckedUploads,
+                (unsigned)allocs, reused ? "reused" : "new");
+#ifdef ALLOC_COUNT_ASSERT
+  if (reused) assert(allocs == 0 && "heap allocation on the upload path");
+#endif
+}
+#endif
+
+// Sends one batch as a POST; fills in the result fields of ev. True on a 2xx response.
+bool NetWorker::postBatch(const UploadJob& job, NetEvent& ev) {
+  ev.type = NetEventType::UploadDone; ev.count = job.count; ev.triggerEvent = job.triggerEvent;
+  ev.httpCode = HTTPC_ERROR_CONNECTION_REFUSED;
+
+  const MotionEvent* motion = job.motion.kind != MotionKind::None ? &job.motion : nullptr;
+  const PerfSummary* perf = job.perf.seq != 0 ? &job.perf : nullptr;
+  size_t bodyLen = buildBatch(_format, _body, sizeof(_body), _cfg.userId, job.triggerEvent, job.samples, job.count, motion, perf);
+  // Latest snapshot for the existing backend; a server that takes a binary body reads it from there
+  bool json = _format == PayloadFormat::Json;
+  size_t detailsLen = json ? generateM5DetailsHeader(_details, sizeof(_details), job.samples[job.count - 1], _cfg.userId, job.triggerEvent, motion) : 1;
+  if (bodyLen == 0 || detailsLen == 0) { Serial.println("Upload body overflow."); ev.httpCode = HTTPC_ERROR_TOO_LESS_RAM; return false; }
+
+  HttpSession& session = *_cfg.uploadSession;
+  simulateServerDelay();
+  const HttpHeader headers[] = { { "Content-Type", payloadContentType(_format) }, { "M5-Details", _details } };
+  ev.bodyBytes = bodyLen;
+  ev.httpCode = session.request("POST", headers, json ? 2 : 1, (const uint8_t*)_body, bodyLen);
+  ev.success = (ev.httpCode >= 200 && ev.httpCode < 300);
+  ev.handshakeMs = session.lastTiming().handshakeMs; ev.transferMs = session.lastTiming().transferMs;
+  if (ev.httpCode == 415 && !json) { // Unsupported Media Type: stay on JSON until reboot
+    Serial.printf("NetWorker: server does not accept %s bodies, falling back to JSON.\n", payloadFormatName(_format));
+    _format = PayloadFormat::Json;
+    return postBatch(job, ev);
+  }
+  noteUpload(ev.success);
+  return ev.success;
+}
+
+// Replays the oldest spooled samples; they stay in flash until a 2xx or a failure that a retry
+// cannot fix, so one rejected batch does not block everything queued behind it
+void NetWorker::drainBacklog() {
+  _backlogJob.triggerEvent = "backlog";
+  _backlogJob.count = _cfg.spool->peek(_backlogJob.samples, MAX_BATCH_SAMPLES);
+  if (_backlogJob.count == 0) { _cfg.spool->consume(0); _spooledSamples = _cfg.spool->size(); return; } // Only corrupt records were left
+  NetEvent ev = {};
+  ev.backlog = true;
+  bool ok = postBatch(_backlogJob, ev);
+  if (!ok && !uploadRetryable(ev.httpCode)) drop(ev);
+  if (ok || ev.dropped) { _cfg.spool->consume(_backlogJob.count); _spooledSamples = _cfg.spool->size(); }
+  postEvent(ev);
+}
+
+void NetWorker::drop(NetEvent& ev) {
+  ev.dropped = true;
+  _droppedBatches++; _droppedSamples += ev.count;
+  Serial.printf("NetWorker: dropping %u samples, HTTP code %d will not change on retry\n", (unsigned)ev.count, ev.httpCode);
+}
+
+bool NetWorker::spool(const UploadJob& job) {
+  if (_cfg.spool == nullptr) return false;
+  bool saved = _cfg.spool->append(job.samples, job.count) == job.count;
+  _spooledSamples = _cfg.spool->size();
+  return saved;
+}
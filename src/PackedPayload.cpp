@@ -0,0 +1,131 @@
+#include "PackedPayload.h"
+#include <math.h>
+#include <string.h>
+
+namespace {
+  const uint8_t PACKED_VERSION = 2; // 2: epochMs per window
+  const uint8_t FLAG_MOTION = 1, FLAG_PERF = 2;
+
+  int32_t hundredths(float v) { return (int32_t)lroundf(v * 100.0f); }
+  uint32_t zigzag(int32_t v) { return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31); }
+  int32_t unzigzag(uint32_t v) { return (int32_t)(v >> 1) ^ -(int32_t)(v & 1); }
+
+  // Bounded writer: a write past the end marks it failed, so callers check once at the end
+  struct Writer {
+    uint8_t* p; uint8_t* end; bool ok = true;
+    void byte(uint8_t b) { if (p < end) *p++ = b; else ok = false; }
+    void varint(uint32_t v) {
+      while (v >= 0x80) { byte((uint8_t)v | 0x80); v >>= 7; }
+      byte((uint8_t)v);
+    }
+    void svarint(int32_t v) { varint(zigzag(v)); }
+    void str(const char* s) {
+      size_t n = strlen(s);
+      varint(n);
+      if ((size_t)(end - p) < n) { ok = false; return; }
+      memcpy(p, s, n); p += n;
+    }
+  };
+
+  struct Reader {
+    const uint8_t* p; const uint8_t* end; bool ok = true;
+    uint8_t byte() { if (p < end) return *p++; ok = false; return 0; }
+    uint32_t varint() {
+      uint32_t v = 0;
+      for (int shift = 0; shift < 35; shift += 7) {
+        uint8_t b = byte();
+        v |= (uint32_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) return v;
+      }
+      ok = false; return 0;
+    }
+    int32_t svarint() { return unzigzag(varint()); }
+    void str(char* out, size_t outSize) {
+      uint32_t n = varint();
+      if (!ok || (size_t)(end - p) < n || n >= outSize) { ok = false; out[0] = '\0'; return; }
+      memcpy(out, p, n); out[n] = '\0'; p += n;
+    }
+  };
+}
+
+size_t buildBatchPacked(uint8_t* out, size_t outSize, const char* userId, const char* triggerEvent,
+                        const WindowSample* samples, size_t count, const MotionEvent* motion, const PerfSummary* perf) {
+  if (count > MAX_BATCH_SAMPLES) count = MAX_BATCH_SAMPLES;
+  Writer w = { out, out + outSize };
+  w.byte('M'); w.byte('5'); w.byte(PACKED_VERSION);
+  w.byte((motion ? FLAG_MOTION : 0) | (perf ? FLAG_PERF : 0));
+  w.str(userId); w.str(triggerEvent ? triggerEvent : "regular");
+  w.varint(count);
+
+  uint32_t prevEpoch = 0;
+  int32_t prevMean[ENV_CHANNELS] = {};
+  for (size_t i = 0; i < count; ++i) {
+    const WindowSample& s = samples[i];
+    if (i == 0) w.varint(s.epoch); else w.svarint((int32_t)(s.epoch - prevEpoch));
+    prevEpoch = s.epoch;
+    w.varint(s.epochMs); w.varint(s.durationMs); w.varint(s.count); w.byte(s.reported);
+    for (size_t ch = 0; ch < ENV_CHANNELS; ++ch) {
+      if (!(s.reported & (1 << ch))) continue;
+      const ChannelStats& c = s.stats[ch];
+      int32_t mean = hundredths(c.mean);
+      w.svarint(mean - prevMean[ch]); prevMean[ch] = mean;
+      w.varint(mean - hundredths(c.min)); w.varint(hundredths(c.max) - mean); w.varint(hundredths(c.stdDev));
+    }
+  }
+  if (motion != nullptr) {
+    w.byte((uint8_t)motion->kind); w.varint(motion->durationMs); w.varint(motion->samples);
+    w.varint(hundredths(motion->rmsG)); w.varint(hundredths(motion->peakG));
+    w.varint(lroundf(motion->jerkGps)); w.varint(hundredths(motion->freqHz));
+  }
+  if (perf != nullptr) {
+    w.varint(perf->seq); w.varint(perf->windowMs); w.varint(perf->passes);
+    for (size_t i = 0; i < LOOP_STAGES; ++i) { w.varint(perf->stages[i].p50Us); w.varint(perf->stages[i].p99Us); w.varint(perf->stages[i].maxUs); }
+    w.varint(perf->httpOk); w.varint(perf->http4xx); w.varint(perf->http5xx); w.varint(perf->httpErr);
+    w.varint(perf->httpP50Ms); w.varint(perf->httpP99Ms);
+    w.varint(perf->freeHeap); w.varint(perf->minFreeHeap); w.varint(perf->minLargestBlock);
+    w.svarint(perf->rssi);
+  }
+  return w.ok ? w.p - out : 0;
+}
+
+bool decodeBatchPacked(const uint8_t* data, size_t len, PackedBatch& out) {
+  out = {};
+  Reader r = { data, data + len };
+  if (r.byte() != 'M' || r.byte() != '5' || r.byte() != PACKED_VERSION) return false;
+  uint8_t flags = r.byte();
+  r.str(out.userId, sizeof(out.userId)); r.str(out.triggerEvent, sizeof(out.triggerEvent));
+  uint32_t count = r.varint();
+  if (!r.ok || count > MAX_BATCH_SAMPLES) return false;
+  out.count = count;
+
+  int32_t prevMean[ENV_CHANNELS] = {};
+  for (size_t i = 0; i < count; ++i) {
+    WindowSample& s = out.samples[i];
+    s.epoch = i == 0 ? r.varint() : out.samples[i - 1].epoch + r.svarint();
+    s.epochMs = r.varint(); s.durationMs = r.varint(); s.count = r.varint(); s.reported = r.byte();
+    for (size_t ch = 0; ch < ENV_CHANNELS; ++ch) {
+      if (!(s.reported & (1 << ch))) continue;
+      int32_t mean = prevMean[ch] + r.svarint(); prevMean[ch] = mean;
+      int32_t below = r.varint(), above = r.varint(), sd = r.varint();
+      s.stats[ch] = { (mean - below) / 100.0f, (mean + above) / 100.0f, mean / 100.0f, sd / 100.0f };
+    }
+  }
+  if (flags & FLAG_MOTION) {
+    MotionEvent& m = out.motion;
+    out.hasMotion = true;
+    m.kind = (MotionKind)r.byte(); m.durationMs = r.varint(); m.samples = r.varint();
+    m.rmsG = r.varint() / 100.0f; m.peakG = r.varint() / 100.0f;
+    m.jerkGps = r.varint(); m.freqHz = r.varint() / 100.0f;
+  }
+  if (flags & FLAG_PERF) {
+    PerfSummary& p = out.perf;
+    out.hasPerf = true;
+    p.seq = r.varint(); p.windowMs = r.varint(); p.passes = r.varint();
+    for (size_t i = 0; i < LOOP_STAGES; ++i) { p.stages[i].p50Us = r.varint(); p.stages[i].p99Us = r.varint(); p.stages[i].maxUs = r.varint(); }
+    p.httpOk = r.varint(); p.http4xx = r.varint(); p.http5xx = r.varint(); p.httpErr = r.varint();
+    p.httpP50Ms = r.varint(); p.httpP99Ms = r.varint();
+    p.freeHeap = r.varint(); p.minFreeHeap = r.varint(); p.minLargestBlock = r.varint();
+    p.rssi = r.svarint();
+  }
+  return r.ok && r.p == r.end;
+}
@@ -0,0 +1,97 @@
+#include "PowerManager.h"
+#include <M5Unified.h>
+#include <WiFi.h>
+#include <driver/gpio.h>
+#include <esp_pm.h>
+#include <esp_sleep.h>
+
+void PowerManager::begin(const PowerConfig& config) {
+  _cfg = config;
+  _loopTask = xTaskGetCurrentTaskHandle();
+  _lastSampleMs = millis();
+
+#if CONFIG_PM_ENABLE
+  esp_pm_config_esp32_t pm = { (int)_cfg.activeCpuMhz, (int)_cfg.activeCpuMhz, false };
+  _pm = esp_pm_configure(&pm) == ESP_OK;
+#endif
+#if CONFIG_PM_ENABLE && CONFIG_FREERTOS_USE_TICKLESS_IDLE
+  _lightSleep = _pm;
+#endif
+  Serial.printf("Power: %s, light sleep %s\n", _pm ? "esp_pm" : "fixed clock", _lightSleep ? "on when idle" : "unavailable");
+
+  if (_cfg.touchIntPin < 0) return;
+  gpio_num_t pin = (gpio_num_t)_cfg.touchIntPin;
+  gpio_install_isr_service(0); // Already installed if anything used attachInterrupt()
+  gpio_set_intr_type(pin, GPIO_INTR_LOW_LEVEL);
+  gpio_isr_handler_add(pin, onTouch, this);
+  gpio_intr_disable(pin); // Enabled by wait()
+  if (_lightSleep) { gpio_wakeup_enable(pin, GPIO_INTR_LOW_LEVEL); esp_sleep_enable_gpio_wakeup(); }
+}
+
+// Level interrupt: disables itself until the next wait(), which keeps a held finger from storming
+void IRAM_ATTR PowerManager::onTouch(void* arg) {
+  PowerManager* self = (PowerManager*)arg;
+  gpio_intr_disable((gpio_num_t)self->_cfg.touchIntPin);
+  BaseType_t woken = pdFALSE;
+  vTaskNotifyGiveFromISR(self->_loopTask, &woken);
+  if (woken) portYIELD_FROM_ISR();
+}
+
+bool PowerManager::setMode(PowerMode mode) {
+  if (mode == _mode) return false;
+  PowerMode previous = _mode;
+  _mode = mode;
+  WiFi.setSleep(mode == PowerMode::Idle ? WIFI_PS_MAX_MODEM : WIFI_PS_MIN_MODEM); // Applied once the STA is up
+  uint32_t mhz = mode == PowerMode::Idle ? _cfg.idleCpuMhz : _cfg.activeCpuMhz;
+  bool clockChanged = (previous == PowerMode::Idle) != (mode == PowerMode::Idle) && _cfg.idleCpuMhz != _cfg.activeCpuMhz;
+  applyClock(mhz, mode == PowerMode::Idle && _lightSleep);
+  return clockChanged;
+}
+
+void PowerManager::applyClock(uint32_t mhz, bool lightSleep) {
+#if CONFIG_PM_ENABLE
+  if (_pm) {
+    esp_pm_config_esp32_t pm = { (int)mhz, (int)mhz, lightSleep };
+    esp_pm_configure(&pm);
+    return;
+  }
+#endif
+  (void)lightSleep;
+  setCpuFrequencyMhz(mhz);
+}
+
+void PowerManager::wait(uint32_t ms) {
+  if (_mode == PowerMode::Baseline) { delay(_cfg.baselineLoopMs); return; }
+  if (ms < 1) ms = 1;
+  if (ms > _cfg.maxSleepMs) ms = _cfg.maxSleepMs;
+  // Only arm the touch wake while the panel is released; a held finger is polled by loop() anyway
+  if (_cfg.touchIntPin >= 0 && gpio_get_level((gpio_num_t)_cfg.touchIntPin)) gpio_intr_enable((gpio_num_t)_cfg.touchIntPin);
+  if (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(ms)) != 0) _wakeups++;
+  if (_cfg.touchIntPin >= 0) gpio_intr_disable((gpio_num_t)_cfg.touchIntPin);
+}
+
+// AXP192 battery current: negative while discharging. USB-powered or charging samples say
+// nothing about the board's draw and are left out.
+void PowerManager::service(uint32_t nowMs) {
+  uint32_t elapsed = nowMs - _lastSampleMs;
+  if (elapsed < _cfg.currentSampleMs) return;
+  _lastSampleMs = nowMs;
+  float mA = M5.Power.getBatteryCurrent();
+  if (mA >= 0.0f) return;
+  _mAms[(size_t)_mode] += -mA * elapsed;
+  _ms[(size_t)_mode] += elapsed;
+}
+
+PowerManager::Stats PowerManager::stats(PowerMode mode) const {
+  uint32_t ms = _ms[(size_t)mode];
+  return { ms ? (float)(_mAms[(size_t)mode] / ms) : 0.0f, ms / 1000 };
+}
+
+const char* PowerManager::modeName(PowerMode mode) {
+  switch (mode) {
+    case PowerMode::Baseline: return "baseline";
+    case PowerMode::Active: return "active";
+    case PowerMode::Idle: return "idle";
+    default: return "?";
+  }
+}
@@ -0,0 +1,113 @@
+#include "Renderer.h"
+
+namespace {
+  const int POPUP_W = 200;
+  const int POPUP_H = 50;
+}
+
+// --- TextField ---
+
+bool TextField::begin(Renderer& renderer, int x, int y, int w, int h, uint16_t fg, uint16_t bg, int padX, int padY, int col2X) {
+  _renderer = &renderer;
+  _x = x; _y = y; _w = w; _h = h; _fg = fg; _bg = bg; _padX = padX; _padY = padY; _col2X = col2X;
+  _sprite.setColorDepth(16);
+  _sprite.setPsram(true); // Sprites live in PSRAM; internal RAM is kept for WiFi/TLS
+  _hasSprite = _sprite.createSprite(w, h) != nullptr;
+  if (_hasSprite) { _sprite.setTextSize(2); _sprite.setTextColor(fg, bg); }
+  renderer.registerField(this);
+  invalidate();
+  return _hasSprite;
+}
+
+void TextField::set(const char* text, const char* col2) {
+  char next[sizeof(_shown)];
+  snprintf(next, sizeof(next), "%.*s\t%.*s", (int)MAX_TEXT, text, (int)MAX_TEXT, col2 ? col2 : "");
+  if (_valid && strcmp(next, _shown) == 0) return; // Unchanged: nothing to push
+  strcpy(_shown, next); _valid = true;
+
+  if (_hasSprite) {
+    _sprite.fillSprite(_bg);
+    _sprite.setCursor(_padX, _padY); _sprite.print(text);
+    if (col2) { _sprite.setCursor(_col2X, _padY); _sprite.print(col2); }
+  }
+  _renderer->pushField(*this);
+}
+
+void TextField::push() {
+  M5GFX& lcd = _renderer->display();
+  if (_hasSprite) {
+    _sprite.pushSprite(&lcd, _x, _y);
+  } else { // No PSRAM: draw straight to the panel (flickers, but still only when changed)
+    lcd.fillRect(_x, _y, _w, _h, _bg);
+    lcd.setTextSize(2); lcd.setTextColor(_fg, _bg);
+    const char* tab = strchr(_shown, '\t');
+    lcd.setCursor(_x + _padX, _y + _padY); lcd.printf("%.*s", (int)(tab ? tab - _shown : strlen(_shown)), _shown);
+    if (tab && tab[1]) { lcd.setCursor(_x + _col2X, _y + _padY); lcd.print(tab + 1); }
+  }
+  _renderer->countPixels((uint32_t)_w * _h);
+  _deferred = false;
+}
+
+// --- Renderer ---
+
+void Renderer::begin(M5GFX& display) {
+  _display = &display;
+  _popup.setColorDepth(16); _popup.setPsram(true); _popup.createSprite(POPUP_W, POPUP_H);
+  _popupBehind.setColorDepth(16); _popupBehind.setPsram(true);
+  _haveBehind = _popupBehind.createSprite(POPUP_W, POPUP_H) != nullptr;
+}
+
+void Renderer::registerField(TextField* field) {
+  if (_fieldCount < MAX_FIELDS) _fields[_fieldCount++] = field;
+}
+
+void Renderer::endFrame() {
+  _lastFramePixels = _framePixels;
+  if (_framePixels > _maxFramePixels) _maxFramePixels = _framePixels;
+  _frames++;
+}
+
+void Renderer::clearScreen(uint16_t color) {
+  _display->fillScreen(color);
+  countPixels((uint32_t)_display->width() * _display->height());
+  _popupVisible = false; // Whatever the popup covered is gone too
+  invalidateAll();
+}
+
+void Renderer::invalidateAll() {
+  for (size_t i = 0; i < _fieldCount; ++i) { _fields[i]->invalidate(); _fields[i]->_deferred = false; }
+}
+
+void Renderer::pushField(TextField& field) {
+  if (_popupVisible && field.overlaps(_popupX, _popupY, POPUP_W, POPUP_H)) { field._deferred = true; return; }
+  field.push();
+}
+
+void Renderer::showPopup(const char* message, uint16_t bgColor, uint16_t textColor) {
+  _popupX = (_display->width() - POPUP_W) / 2; _popupY = (_display->height() - POPUP_H) / 2;
+  // Save what is underneath so hidePopup() can put it back without redrawing the page
+  if (!_popupVisible && _haveBehind) {
+    _display->readRect(_popupX, _popupY, POPUP_W, POPUP_H, (lgfx::swap565_t*)_popupBehind.getBuffer());
+  }
+  // Composite off-screen and push once (straight to the panel if the sprite could not be allocated)
+  LovyanGFX* target = _popup.getBuffer() ? (LovyanGFX*)&_popup : (LovyanGFX*)_display;
+  int ox = _popup.getBuffer() ? 0 : _popupX, oy = _popup.getBuffer() ? 0 : _popupY;
+  target->fillRect(ox, oy, POPUP_W, POPUP_H, bgColor); target->drawRect(ox, oy, POPUP_W, POPUP_H, textColor);
+  target->setTextSize(2); target->setTextColor(textColor);
+  int textX = ox + (POPUP_W - target->textWidth(message)) / 2; int textY = oy + (POPUP_H - target->fontHeight()) / 2;
+  target->setCursor(textX, textY); target->print(message);
+  if (_popup.getBuffer()) _popup.pushSprite(_display, _popupX, _popupY);
+  countPixels(POPUP_W * POPUP_H);
+  _popupVisible = true;
+}
+
+bool Renderer::hidePopup() {
+  if (!_popupVisible) return true;
+  _popupVisible = false;
+  if (!_haveBehind) return false; // Nothing saved (no PSRAM): caller redraws the page
+  _popupBehind.pushSprite(_display, _popupX, _popupY);
+  countPixels(POPUP_W * POPUP_H);
+  // Fields that changed while they were covered
+  for (size_t i = 0; i < _fieldCount; ++i) { if (_fields[i]->_deferred && _fields[i]->_valid) _fields[i]->push(); }
+  return true;
+}
@@ -0,0 +1,101 @@
+#include "SensorHub.h"
+
+bool SensorHub::add(SensorChannel& channel, uint32_t periodMs, uint32_t maxPeriodMs) {
+  if (_count == MAX_CHANNELS || periodMs == 0) return false;
+  Slot& slot = _slots[_count++];
+  slot = {};
+  slot.channel = &channel; slot.periodMs = slot.basePeriodMs = periodMs;
+  slot.maxPeriodMs = maxPeriodMs > periodMs ? maxPeriodMs : periodMs;
+  slot.nextMs = _clock.millis(); // First conversion on the next service()
+  return true;
+}
+
+uint8_t SensorHub::read(SensorData& out, uint32_t (&capturedMs)[ENV_CHANNELS]) {
+  service();
+  out = _data;
+  for (size_t i = 0; i < ENV_CHANNELS; ++i) capturedMs[i] = _capturedMs[i];
+  uint8_t updated = _updated;
+  _updated = 0;
+  return updated;
+}
+
+void SensorHub::setDeadbands(const float (&deadband)[ENV_CHANNELS]) {
+  for (size_t i = 0; i < ENV_CHANNELS; ++i) _deadband[i] = deadband[i];
+}
+
+// Leaving adaptive mode brings every channel back to its base rate right away
+void SensorHub::setAdaptive(bool adaptive) {
+  _adaptive = adaptive;
+  if (adaptive) return;
+  uint32_t now = _clock.millis();
+  for (size_t i = 0; i < _count; ++i) {
+    Slot& slot = _slots[i];
+    slot.periodMs = slot.basePeriodMs;
+    if ((int32_t)(slot.nextMs - (now + slot.periodMs)) > 0) slot.nextMs = now + slot.periodMs;
+  }
+}
+
+// Time until the next trigger or collect; what the board may sleep as far as the sensors go
+uint32_t SensorHub::msUntilDue(uint32_t nowMs) {
+  uint32_t best = UINT32_MAX;
+  for (size_t i = 0; i < _count; ++i) {
+    const Slot& slot = _slots[i];
+    int32_t left = (int32_t)((slot.pending ? slot.readyMs : slot.nextMs) - nowMs);
+    uint32_t ms = left > 0 ? (uint32_t)left : 0;
+    if (ms < best) best = ms;
+  }
+  return best;
+}
+
+void SensorHub::service() {
+  uint32_t now = _clock.millis();
+  for (size_t i = 0; i < _count; ++i) {
+    Slot& slot = _slots[i];
+    if (slot.pending) { collect(slot, now); continue; }
+    if ((int32_t)(now - slot.nextMs) < 0) continue;
+
+    // Keep the cadence, but after a stall start over instead of firing a burst of catch-up reads
+    slot.nextMs += slot.periodMs;
+    if ((int32_t)(now - slot.nextMs) >= 0) slot.nextMs = now + slot.periodMs;
+    uint32_t waitMs = 0;
+    if (!slot.channel->trigger(waitMs)) { slot.stats.errors++; continue; }
+    slot.pending = true;
+    slot.readyMs = now + waitMs;
+    if (waitMs == 0) collect(slot, now); // Free-running sensor: the result is already there
+  }
+}
+
+// Picks up a pending conversion once it is due; gives up after one period without a result
+void SensorHub::collect(Slot& slot, uint32_t now) {
+  if ((int32_t)(now - slot.readyMs) < 0) return;
+  if (slot.channel->collect(_data)) {
+    adapt(slot);
+    slot.pending = false;
+    slot.stats.reads++;
+    uint8_t channels = slot.channel->channels();
+    // Stamped when the conversion finished, not when a later pass got round to collecting it
+    for (size_t i = 0; i < ENV_CHANNELS; ++i) if (channels & (1 << i)) _capturedMs[i] = slot.readyMs;
+    _updated |= channels;
+  } else if (now - slot.readyMs >= slot.periodMs) {
+    slot.pending = false;
+    slot.stats.errors++;
+  }
+}
+
+// Adaptive mode: back off while the channel's readings stay within the deadbands of where
+// they were at its last change, back to the base period once one leaves them
+void SensorHub::adapt(Slot& slot) {
+  bool moved = false;
+  uint8_t owned = slot.channel->channels();
+  for (size_t i = 0; i < ENV_CHANNELS; ++i) {
+    if (!(owned & (1 << i))) continue;
+    float delta = envChannelValue(_data, (EnvChannel)i) - slot.ref[i];
+    if (delta >= _deadband[i] || -delta >= _deadband[i]) moved = true;
+  }
+  if (moved) {
+    for (size_t i = 0; i < ENV_CHANNELS; ++i) if (owned & (1 << i)) slot.ref[i] = envChannelValue(_data, (EnvChannel)i);
+    slot.periodMs = slot.basePeriodMs;
+  } else if (_adaptive) {
+    slot.periodMs = slot.periodMs * 2 < slot.maxPeriodMs ? slot.periodMs * 2 : slot.maxPeriodMs;
+  }
+}
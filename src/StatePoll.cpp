@@ -0,0 +1,24 @@
+#include "StatePoll.h"
+#include <stdio.h>
+
+size_t StatePoll::query(char* out, size_t outSize, const char* userId, uint32_t waitS) {
+  int n = waitS > 0 ? snprintf(out, outSize, "?userId=%s&wait=%lu", userId, (unsigned long)waitS)
+                    : snprintf(out, outSize, "?userId=%s", userId);
+  return n > 0 && (size_t)n < outSize ? (size_t)n : 0;
+}
+
+void StatePoll::setEtag(const char* etag, size_t length) {
+  if (length >= sizeof(_etag)) length = sizeof(_etag) - 1; // A cut tag never matches: costs a 200, not a wrong state
+  memcpy(_etag, etag, length);
+  _etag[length] = '\0';
+}
+
+StatePoll::Outcome StatePoll::onResponse(int httpCode, const char* etag, const char* body) {
+  if (httpCode == HTTP_NOT_MODIFIED) return Outcome::NotModified;
+  if (httpCode != HTTP_OK) return Outcome::Failed;
+  bool hasKey = false;
+  bool bad = parse(body != nullptr ? body : "", _state, hasKey) || !hasKey;
+  // Only a parsed body may make the next request conditional: a 304 would hide the state it carried
+  setEtag(!bad && etag != nullptr ? etag : "");
+  return bad ? Outcome::BadBody : Outcome::Parsed;
+}
@@ -0,0 +1,96 @@
+#include "UploadPayload.h"
+#include "PackedPayload.h"
+#include <ArduinoJson.h>
+#include <math.h>
+
+namespace {
+  constexpr size_t BATCH_DOC_CAPACITY =
+      JSON_OBJECT_SIZE(5) + JSON_ARRAY_SIZE(MAX_BATCH_SAMPLES) +
+      MAX_BATCH_SAMPLES * (JSON_OBJECT_SIZE(4 + ENV_CHANNELS) + ENV_CHANNELS * JSON_ARRAY_SIZE(4)) + JSON_OBJECT_SIZE(7) +
+      JSON_OBJECT_SIZE(7) + JSON_OBJECT_SIZE(LOOP_STAGES) + LOOP_STAGES * JSON_ARRAY_SIZE(3) + JSON_ARRAY_SIZE(6) + JSON_ARRAY_SIZE(3);
+  StaticJsonDocument<BATCH_DOC_CAPACITY> batchDoc; // Static: too large for the loop task stack
+  constexpr size_t DETAILS_DOC_CAPACITY =
+      JSON_OBJECT_SIZE(3) + JSON_OBJECT_SIZE(3) + JSON_OBJECT_SIZE(2) + JSON_OBJECT_SIZE(4) + JSON_OBJECT_SIZE(7);
+
+  float round2(float v) { return roundf(v * 100.0f) / 100.0f; }
+
+  void addMotion(JsonObject o, const MotionEvent& m) {
+    o["kind"] = motionKindName(m.kind); o["durMs"] = m.durationMs; o["n"] = m.samples;
+    o["rms"] = round2(m.rmsG); o["peak"] = round2(m.peakG);
+    o["jerk"] = (int32_t)lroundf(m.jerkGps); o["freq"] = round2(m.freqHz);
+  }
+
+  void addPerf(JsonObject o, const PerfSummary& p) {
+    o["seq"] = p.seq; o["winMs"] = p.windowMs; o["n"] = p.passes;
+    JsonObject us = o.createNestedObject("us");
+    for (size_t i = 0; i < LOOP_STAGES; ++i) {
+      JsonArray a = us.createNestedArray(loopStageName((LoopStage)i));
+      a.add(p.stages[i].p50Us); a.add(p.stages[i].p99Us); a.add(p.stages[i].maxUs);
+    }
+    JsonArray http = o.createNestedArray("http");
+    http.add(p.httpOk); http.add(p.http4xx); http.add(p.http5xx); http.add(p.httpErr); http.add(p.httpP50Ms); http.add(p.httpP99Ms);
+    JsonArray heap = o.createNestedArray("heap");
+    heap.add(p.freeHeap); heap.add(p.minFreeHeap); heap.add(p.minLargestBlock);
+    o["rssi"] = p.rssi;
+  }
+}
+
+// Fills batchDoc; false if it overflowed
+static bool fillBatchDoc(const char* userId, const char* triggerEvent, const WindowSample* samples, size_t count,
+                         const MotionEvent* motion, const PerfSummary* perf) {
+  if (count > MAX_BATCH_SAMPLES) count = MAX_BATCH_SAMPLES;
+  batchDoc.clear();
+  batchDoc["userId"] = userId;
+  batchDoc["triggerEvent"] = triggerEvent ? triggerEvent : "regular";
+  JsonArray arr = batchDoc.createNestedArray("samples");
+  for (size_t i = 0; i < count; ++i) {
+    const WindowSample& s = samples[i];
+    JsonObject o = arr.createNestedObject();
+    o["t"] = s.epoch; o["ms"] = s.epochMs; o["dur"] = s.durationMs; o["n"] = s.count;
+    for (size_t ch = 0; ch < ENV_CHANNELS; ++ch) {
+      if (!(s.reported & (1 << ch))) continue; // Inside its deadband: the backend keeps the last value
+      const ChannelStats& c = s.stats[ch];
+      JsonArray a = o.createNestedArray(envChannelName((EnvChannel)ch));
+      a.add(round2(c.mean)); a.add(round2(c.min)); a.add(round2(c.max)); a.add(round2(c.stdDev));
+    }
+  }
+  if (motion != nullptr) addMotion(batchDoc.createNestedObject("motion"), *motion);
+  if (perf != nullptr) addPerf(batchDoc.createNestedObject("perf"), *perf);
+  return !batchDoc.overflowed();
+}
+
+size_t buildBatchBody(char* out, size_t outSize, const char* userId, const char* triggerEvent,
+                      const WindowSample* samples, size_t count, const MotionEvent* motion, const PerfSummary* perf) {
+  if (!fillBatchDoc(userId, triggerEvent, samples, count, motion, perf) || measureJson(batchDoc) >= outSize) return 0;
+  return serializeJson(batchDoc, out, outSize);
+}
+
+size_t buildBatchMsgPack(char* out, size_t outSize, const char* userId, const char* triggerEvent,
+                         const WindowSample* samples, size_t count, const MotionEvent* motion, const PerfSummary* perf) {
+  if (!fillBatchDoc(userId, triggerEvent, samples, count, motion, perf) || measureMsgPack(batchDoc) > outSize) return 0;
+  return serializeMsgPack(batchDoc, out, outSize);
+}
+
+size_t buildBatch(PayloadFormat format, char* out, size_t outSize, const char* userId, const char* triggerEvent,
+                  const WindowSample* samples, size_t count, const MotionEvent* motion, const PerfSummary* perf) {
+  switch (format) {
+    case PayloadFormat::MsgPack: return buildBatchMsgPack(out, outSize, userId, triggerEvent, samples, count, motion, perf);
+    case PayloadFormat::Packed: return buildBatchPacked((uint8_t*)out, outSize, userId, triggerEvent, samples, count, motion, perf);
+    default: return buildBatchBody(out, outSize, userId, triggerEvent, samples, count, motion, perf);
+  }
+}
+
+size_t generateM5DetailsHeader(char* out, size_t outSize, const WindowSample& sample, const char* userId,
+                               const char* triggerEvent, const MotionEvent* motion) {
+    auto mean = [&](EnvChannel ch) { return sample.stats[(size_t)ch].mean; };
+    StaticJsonDocument<DETAILS_DOC_CAPACITY> doc; JsonObject vcnl = doc.createNestedObject("vcnlDetails");
+    vcnl["prox"] = lroundf(mean(EnvChannel::Prox)); vcnl["al"] = lroundf(mean(EnvChannel::AmbientLight));
+    vcnl["wl"] = lroundf(mean(EnvChannel::WhiteLight));
+    JsonObject sht = doc.createNestedObject("shtDetails");
+    sht["temp"] = round2(mean(EnvChannel::Temp)); sht["rHum"] = round2(mean(EnvChannel::RHum));
+    JsonObject other = doc.createNestedObject("otherDetails"); other["timeCaptured"] = sample.epoch; other["userId"] = userId;
+    if (triggerEvent != nullptr) { other["triggerEvent"] = triggerEvent; }
+    if (motion != nullptr) { addMotion(other.createNestedObject("motion"), *motion); }
+    if (doc.overflowed() || measureJson(doc) >= outSize) return 0;
+    return serializeJson(doc, out, outSize);
+}
@@ -0,0 +1,50 @@
+#include "WiFiCache.h"
+#include <Preferences.h>
+#include <WiFi.h>
+
+namespace {
+  const char NVS_NAMESPACE[] = "wifi";
+  const char NVS_KEY[] = "assoc";
+}
+
+uint32_t WiFiCache::hash(const char* text) { // FNV-1a
+  uint32_t h = 2166136261u;
+  for (; *text; ++text) h = (h ^ (uint8_t)*text) * 16777619u;
+  return h;
+}
+
+bool WiFiCache::load(const char* ssid) {
+  Preferences prefs;
+  _valid = false;
+  if (!prefs.begin(NVS_NAMESPACE, true)) return false; // Namespace missing until the first store()
+  _valid = prefs.getBytes(NVS_KEY, &_entry, sizeof(_entry)) == sizeof(_entry) && _entry.ssidHash == hash(ssid) &&
+           _entry.channel != 0 && _entry.ip != 0;
+  prefs.end();
+  return _valid;
+}
+
+void WiFiCache::store(const char* ssid) {
+  Entry entry;
+  memset(&entry, 0, sizeof(entry)); // Padding too: entries are compared bytewise
+  entry.ssidHash = hash(ssid);
+  entry.channel = WiFi.channel();
+  const uint8_t* bssid = WiFi.BSSID();
+  if (bssid == nullptr || entry.channel == 0) return;
+  memcpy(entry.bssid, bssid, sizeof(entry.bssid));
+  entry.ip = WiFi.localIP(); entry.gateway = WiFi.gatewayIP(); entry.subnet = WiFi.subnetMask(); entry.dns = WiFi.dnsIP(0);
+  if (_valid && memcmp(&entry, &_entry, sizeof(entry)) == 0) return;
+
+  Preferences prefs;
+  if (!prefs.begin(NVS_NAMESPACE, false)) return;
+  if (prefs.putBytes(NVS_KEY, &entry, sizeof(entry)) == sizeof(entry)) { _entry = entry; _valid = true; }
+  prefs.end();
+}
+
+void WiFiCache::invalidate() {
+  if (!_valid) return;
+  _valid = false;
+  Preferences prefs;
+  if (!prefs.begin(NVS_NAMESPACE, false)) return;
+  prefs.remove(NVS_KEY);
+  prefs.end();
+}
@@ -0,0 +1,58 @@
+#include "WindowAggregator.h"
+#include <math.h>
+
+// --- RunningStats ---
+
+ChannelStats RunningStats::summary() const {
+  return { _min, _max, _mean, sqrtf(variance()) };
+}
+
+// --- WindowAggregator ---
+
+void WindowAggregator::begin(const AggregationConfig& config, uint32_t nowMs) {
+  _cfg = config;
+  for (auto& s : _stats) s.reset();
+  _windowStartMs = nowMs;
+  _everSent = 0;
+}
+
+void WindowAggregator::add(const SensorData& data, uint8_t channels) {
+  for (size_t i = 0; i < ENV_CHANNELS; ++i) if (channels & (1 << i)) _stats[i].add(envChannelValue(data, (EnvChannel)i));
+}
+
+uint32_t WindowAggregator::readings() const {
+  uint32_t n = 0;
+  for (const RunningStats& s : _stats) if (s.count() > n) n = s.count();
+  return n;
+}
+
+bool WindowAggregator::close(uint32_t nowMs, bool force, WindowSample& out) {
+  out = {};
+  out.uptimeMs = nowMs;
+  out.durationMs = nowMs - _windowStartMs;
+  uint32_t n = readings();
+  out.count = n > UINT16_MAX ? UINT16_MAX : n;
+  _windowStartMs = nowMs;
+  _moved = 0;
+  if (n == 0) return false;
+  _windows++;
+
+  for (size_t i = 0; i < ENV_CHANNELS; ++i) {
+    if (_stats[i].count() == 0) continue; // Not read in this window (slow channel, or not yet)
+    ChannelStats s = _stats[i].summary();
+    _stats[i].reset();
+    out.stats[i] = s;
+    uint8_t bit = 1 << i;
+    float ref = _lastSentMean[i], band = _cfg.deadband[i];
+    bool moved = fabsf(s.mean - ref) >= band || s.max - ref >= band || ref - s.min >= band;
+    bool heartbeat = nowMs - _lastSentMs[i] >= _cfg.heartbeatMs;
+    if (moved && (_everSent & bit)) _moved |= bit;
+    if (!force && (_everSent & bit) && !moved && !heartbeat) continue;
+    out.reported |= bit;
+    _lastSentMean[i] = s.mean; _lastSentMs[i] = nowMs; _everSent |= bit;
+    _channelsSent[i]++;
+  }
+  if (out.reported == 0) return false;
+  _sent++;
+  return true;
+}
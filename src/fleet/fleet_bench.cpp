@@ -0,0 +1,628 @@
+// Virtual device fleet against the stand-in backend (tools/standin_server.py), or anything that
+// serves the same upload and get-device-state API (pio run -e fleet && .pio/build/fleet/program).
+// Each virtual device holds two keep-alive connections like the firmware does (NetWorker's upload
+// session, CommandChannel's state session) and sends what the firmware would, built by the
+// firmware's own code:
+//   - uploads: buildBatch() bodies, the M5-Details header from generateM5DetailsHeader(), the JSON
+//     fallback on 415; every --upload-s, plus "shake" bursts (--shake-every-s) and a
+//     "cloud_state_change" upload whenever a device sees its state change
+//   - state: StatePoll, the conditional GET / long-poll of CommandChannel::checkCloudCommand(),
+//     never spaced closer than --poll-ms
+// A driver flips fanState for --burst devices every --state-every-s (POST /state) and times how
+// long each change takes to reach its device. Everything runs on one thread: non-blocking sockets
+// and poll(), the request schedule in a timer heap.
+//
+// Reports request throughput and latency percentiles per request type (long-poll latency includes
+// the time the server held the request) and the state change propagation delay: POST /state sent
+// -> the device's poll returned the new fanState. Exits with status 1 if no request succeeded.
+//
+//   program [--host IP] [--port N] [--devices N] [--seconds N] [--upload-s N] [--batch N]
+//           [--format json|msgpack|packed] [--mode poll|longpoll] [--poll-ms N] [--wait-s N]
+//           [--shake-every-s N] [--state-every-s N] [--burst N] [--ramp-s N] [--report-s N] [--seed N]
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <queue>
+#include <random>
+#include <string>
+#include <vector>
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include "StatePoll.h"
+#include "UploadPayload.h"
+
+namespace {
+  struct Options {
+    const char* host = "127.0.0.1";
+    uint16_t port = 8080;
+    uint32_t devices = 1000;
+    uint32_t seconds = 60;
+    uint32_t uploadS = 60;        // Regular upload period (maxBatchAge in main.cpp)
+    uint32_t batch = 6;           // Windows per regular upload: a minute of 10 s windows
+    PayloadFormat format = PayloadFormat::Json;
+    bool longPoll = true;         // commandMode
+    uint32_t pollMs = 3000;       // commandCheckInterval
+    uint32_t waitS = 25;          // commandLongPollWait
+    uint32_t shakeEveryS = 30;    // 0: no shake bursts
+    uint32_t stateEveryS = 10;    // 0: no state changes
+    uint32_t burst = 100;         // Devices per burst
+    uint32_t rampS = 5;           // Devices come online spread over this long
+    uint32_t reportS = 5;
+    uint32_t seed = 1;
+  };
+
+  bool parseOptions(int argc, char** argv, Options& o) {
+    for (int i = 1; i < argc; ++i) {
+      const char* a = argv[i];
+      bool hasValue = i + 1 < argc;
+      if (strcmp(a, "--host") == 0 && hasValue) o.host = argv[++i];
+      else if (strcmp(a, "--port") == 0 && hasValue) o.port = atoi(argv[++i]);
+      else if (strcmp(a, "--devices") == 0 && hasValue) o.devices = atoi(argv[++i]);
+      else if (strcmp(a, "--seconds") == 0 && hasValue) o.seconds = atoi(argv[++i]);
+      else if (strcmp(a, "--upload-s") == 0 && hasValue) o.uploadS = atoi(argv[++i]);
+      else if (strcmp(a, "--batch") == 0 && hasValue) o.batch = atoi(argv[++i]);
+      else if (strcmp(a, "--poll-ms") == 0 && hasValue) o.pollMs = atoi(argv[++i]);
+      else if (strcmp(a, "--wait-s") == 0 && hasValue) o.waitS = atoi(argv[++i]);
+      else if (strcmp(a, "--shake-every-s") == 0 && hasValue) o.shakeEveryS = atoi(argv[++i]);
+      else if (strcmp(a, "--state-every-s") == 0 && hasValue) o.stateEveryS = atoi(argv[++i]);
+      else if (strcmp(a, "--burst") == 0 && hasValue) o.burst = atoi(argv[++i]);
+      else if (strcmp(a, "--ramp-s") == 0 && hasValue) o.rampS = atoi(argv[++i]);
+      else if (strcmp(a, "--report-s") == 0 && hasValue) o.reportS = atoi(argv[++i]);
+      else if (strcmp(a, "--seed") == 0 && hasValue) o.seed = atoi(argv[++i]);
+      else if (strcmp(a, "--mode") == 0 && hasValue) {
+        const char* m = argv[++i];
+        if (strcmp(m, "poll") == 0) o.longPoll = false;
+        else if (strcmp(m, "longpoll") != 0) { fprintf(stderr, "Unknown mode: %s\n", m); return false; }
+      }
+      else if (strcmp(a, "--format") == 0 && hasValue) {
+        const char* f = argv[++i];
+        if (strcmp(f, "msgpack") == 0) o.format = PayloadFormat::MsgPack;
+        else if (strcmp(f, "packed") == 0) o.format = PayloadFormat::Packed;
+        else if (strcmp(f, "json") != 0) { fprintf(stderr, "Unknown format: %s\n", f); return false; }
+      }
+      else { fprintf(stderr, "Unknown option: %s\n", a); return false; }
+    }
+    return o.devices > 0 && o.seconds > 0 && o.uploadS > 0 && o.batch > 0 && o.batch <= MAX_BATCH_SAMPLES &&
+           o.pollMs > 0 && o.reportS > 0;
+  }
+
+  uint64_t nowUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  double percentile(std::vector<uint32_t>& sorted, double p) {
+    if (sorted.empty()) return 0;
+    size_t rank = (size_t)(p / 100.0 * (sorted.size() - 1) + 0.5);
+    return sorted[rank];
+  }
+
+  // Request types, each with its own connection per device (Set: the driver's pool)
+  enum class Kind : uint8_t { Upload, State, Set, Count };
+  const char* const KIND_NAMES[(size_t)Kind::Count] = { "upload", "state", "set" };
+
+  struct KindStats {
+    uint32_t ok = 0, failed = 0;
+    uint32_t reportedOk = 0;       // ok at the last periodic report
+    uint64_t bytesOut = 0;
+    std::vector<uint32_t> latencyUs; // Request sent -> response complete, successful requests
+  };
+
+  enum class ConnState : uint8_t { Closed, Connecting, Sending, Receiving, Idle };
+
+  struct Conn {
+    int fd = -1;
+    ConnState state = ConnState::Closed;
+    Kind kind = Kind::Upload;
+    uint32_t device = 0;    // Owner; for Set the device whose state is being set
+    bool reused = false;    // Request went out on an already open connection
+    bool retried = false;   // ...and was resent on a fresh one after it turned out stale
+    uint64_t startUs = 0;
+    uint64_t deadlineUs = 0;
+    std::string out, in;
+    size_t sent = 0;
+  };
+
+  struct Device {
+    char userId[24];
+    StatePoll poll;
+    PayloadFormat format;
+    uint32_t windows = 0;           // Windows uploaded so far: stamps the next batch
+    const char* sending = nullptr;  // Trigger of the upload in flight
+    const char* queued = nullptr;   // Trigger of an upload waiting for the connection
+    uint64_t pollStartUs = 0;
+    bool setPending = false;        // Driver changed the state, device has not seen it yet
+    bool setTarget = false;
+    uint64_t setUs = 0;
+  };
+
+  struct Response {
+    int code = 0;
+    const char* etag = nullptr;
+    size_t etagLength = 0;
+    bool close = false;
+    size_t bodyStart = 0, bodyLength = 0;
+  };
+
+  // 1: complete response in `in`, 0: more bytes needed, -1: malformed
+  int parseResponse(const std::string& in, Response& r) {
+    size_t headEnd = in.find("\r\n\r\n");
+    if (headEnd == std::string::npos) return in.size() > 8192 ? -1 : 0;
+    if (sscanf(in.c_str(), "HTTP/1.%*d %d", &r.code) != 1) return -1;
+    size_t length = 0;
+    for (size_t pos = in.find("\r\n") + 2; pos < headEnd;) {
+      size_t eol = in.find("\r\n", pos);
+      const char* line = in.c_str() + pos;
+      const char* colon = (const char*)memchr(line, ':', eol - pos);
+      if (colon != nullptr) {
+        size_t nameLength = colon - line;
+        const char* value = colon + 1;
+        while (*value == ' ') value++;
+        size_t valueLength = in.c_str() + eol - value;
+        if (nameLength == 14 && strncasecmp(line, "Content-Length", 14) == 0) length = strtoul(value, nullptr, 10);
+        else if (nameLength == 4 && strncasecmp(line, "ETag", 4) == 0) { r.etag = value; r.etagLength = valueLength; }
+        else if (nameLength == 10 && strncasecmp(line, "Connection", 10) == 0) r.close = strncasecmp(value, "close", 5) == 0;
+      }
+      pos = eol + 2;
+    }
+    r.bodyStart = headEnd + 4;
+    r.bodyLength = length;
+    return in.size() >= r.bodyStart + length ? 1 : 0;
+  }
+
+  struct Timer {
+    uint64_t atUs;
+    uint32_t device;
+    Kind kind;
+    bool operator>(const Timer& other) const { return atUs > other.atUs; }
+  };
+
+  class Fleet {
+  public:
+    static constexpr size_t DRIVER_CONNS = 32;
+    static constexpr uint32_t TIMEOUT_MS = 5000; // HTTPCLIENT_DEFAULT_TCP_TIMEOUT; long-polls get wait + 10 s like the device
+
+    explicit Fleet(const Options& opt);
+    bool run();
+
+  private:
+    Conn& uploadConn(uint32_t device) { return _conns[2 * device]; }
+    Conn& stateConn(uint32_t device) { return _conns[2 * device + 1]; }
+
+    void startUpload(uint32_t device, const char* trigger);
+    void startPoll(uint32_t device);
+    void startSets();
+    void issue(size_t index, Kind kind, uint32_t device, uint64_t now);
+    bool open(size_t index);
+    void closeConn(size_t index);
+    void watch(size_t index);
+    void onWritable(size_t index, uint64_t now);
+    void onReadable(size_t index, uint64_t now);
+    void fail(size_t index, uint64_t now, bool transport);
+    void finish(size_t index, const Response& r, uint64_t now);
+    void shakeBurst();
+    void stateBurst();
+    void report(uint64_t now);
+    void summary(uint64_t now);
+
+    Options _opt;
+    sockaddr_in _addr = {};
+    std::vector<Device> _devices;
+    std::vector<Conn> _conns;           // Upload and state connection per device, then the driver pool
+    std::vector<pollfd> _pfds;          // Parallel to _conns
+    std::priority_queue<Timer, std::vector<Timer>, std::greater<Timer>> _timers;
+    std::deque<uint32_t> _sets;         // Devices waiting for a driver connection
+    std::mt19937 _rng;
+    KindStats _stats[(size_t)Kind::Count];
+    std::vector<uint32_t> _propagationUs;
+    uint32_t _notModified = 0, _badBodies = 0, _changes = 0, _superseded = 0, _fallbacks = 0, _retries = 0, _timeouts = 0;
+    uint32_t _eventUploads[2] = {}; // shake, cloud_state_change
+    uint32_t _coalesced = 0;        // Events folded into an upload that was already waiting
+    uint64_t _startUs = 0, _lastReportUs = 0;
+  };
+
+  Fleet::Fleet(const Options& opt) : _opt(opt), _rng(opt.seed) {
+    _addr.sin_family = AF_INET;
+    _addr.sin_port = htons(opt.port);
+    inet_pton(AF_INET, opt.host, &_addr.sin_addr);
+    _devices.resize(opt.devices);
+    for (uint32_t i = 0; i < opt.devices; ++i) {
+      snprintf(_devices[i].userId, sizeof(_devices[i].userId), "fleet_%u", (unsigned)i);
+      _devices[i].format = opt.format;
+    }
+    _conns.resize(2 * opt.devices + DRIVER_CONNS);
+    _pfds.resize(_conns.size());
+    for (pollfd& p : _pfds) p = { -1, 0, 0 };
+  }
+
+  bool Fleet::open(size_t index) {
+    Conn& c = _conns[index];
+    c.fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (c.fd < 0) return false;
+    fcntl(c.fd, F_SETFL, fcntl(c.fd, F_GETFL) | O_NONBLOCK);
+    int one = 1;
+    setsockopt(c.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if (connect(c.fd, (const sockaddr*)&_addr, sizeof(_addr)) != 0 && errno != EINPROGRESS) { closeConn(index); return false; }
+    c.state = ConnState::Connecting;
+    return true;
+  }
+
+  void Fleet::closeConn(size_t index) {
+    Conn& c = _conns[index];
+    if (c.fd >= 0) close(c.fd);
+    c.fd = -1;
+    c.state = ConnState::Closed;
+    watch(index);
+  }
+
+  void Fleet::watch(size_t index) {
+    const Conn& c = _conns[index];
+    _pfds[index].fd = c.fd;
+    _pfds[index].events = (c.state == ConnState::Connecting || c.state == ConnState::Sending) ? POLLOUT : POLLIN;
+  }
+
+  // Sends c.out over the open connection, or opens one first
+  void Fleet::issue(size_t index, Kind kind, uint32_t device, uint64_t now) {
+    Conn& c = _conns[index];
+    c.kind = kind; c.device = device;
+    c.in.clear(); c.sent = 0;
+    c.startUs = now;
+    uint32_t timeoutMs = kind == Kind::State && _opt.longPoll ? (_opt.waitS + 10) * 1000 : TIMEOUT_MS;
+    c.deadlineUs = now + timeoutMs * 1000ull;
+    c.reused = c.state == ConnState::Idle;
+    if (c.reused) c.state = ConnState::Sending;
+    else if (!open(index)) { fail(index, now, true); return; }
+    _stats[(size_t)kind].bytesOut += c.out.size();
+    watch(index);
+    if (c.reused) onWritable(index, now);
+  }
+
+  void Fleet::startUpload(uint32_t device, const char* trigger) {
+    Conn& c = uploadConn(device);
+    if (c.state != ConnState::Idle && c.state != ConnState::Closed) {
+      // Busy: like App, one batch in flight; an event outranks a waiting regular upload
+      Device& d = _devices[device];
+      if (d.queued != nullptr) _coalesced++;
+      if (d.queued == nullptr || strcmp(d.queued, "regular") == 0) d.queued = trigger;
+      return;
+    }
+    Device& d = _devices[device];
+    bool regular = strcmp(trigger, "regular") == 0;
+    uint32_t count = regular ? _opt.batch : 1; // An event closes the current window and sends it right away
+    WindowSample samples[MAX_BATCH_SAMPLES] = {};
+    uint32_t endEpoch = (uint32_t)time(nullptr);
+    std::uniform_real_distribution<float> noise(-1.0f, 1.0f);
+    const float base[ENV_CHANNELS] = { 40.0f, 300.0f, 500.0f, 22.5f, 45.0f };
+    const float spread[ENV_CHANNELS] = { 8.0f, 30.0f, 40.0f, 0.3f, 1.5f };
+    for (uint32_t i = 0; i < count; ++i) {
+      WindowSample& s = samples[i];
+      s.epoch = endEpoch - (count - 1 - i) * 10;
+      s.uptimeMs = (d.windows + i) * 10000;
+      s.durationMs = 10000; s.count = 200;
+      s.reported = (uint8_t)(1 << (size_t)EnvChannel::Temp) | (uint8_t)(_rng() & 0x1F); // Temp moves in every window
+      for (size_t ch = 0; ch < ENV_CHANNELS; ++ch) {
+        float mean = base[ch] + spread[ch] * noise(_rng);
+        s.stats[ch] = { mean - spread[ch] * 0.5f, mean + spread[ch] * 0.5f, mean, spread[ch] * 0.2f };
+      }
+    }
+    d.windows += count;
+    MotionEvent shake = { MotionKind::Shake, 0, 900, 180, 0.9f, 2.1f, 45.0f, 4.5f };
+    const MotionEvent* motion = strcmp(trigger, "shake") == 0 ? &shake : nullptr;
+
+    char body[UPLOAD_BODY_CAPACITY], details[M5_DETAILS_CAPACITY];
+    size_t bodyLength = buildBatch(d.format, body, sizeof(body), d.userId, trigger, samples, count, motion, nullptr);
+    bool json = d.format == PayloadFormat::Json;
+    size_t detailsLength = json ? generateM5DetailsHeader(details, sizeof(details), samples[count - 1], d.userId, trigger, motion) : 0;
+    if (bodyLength == 0 || (json && detailsLength == 0)) { _stats[(size_t)Kind::Upload].failed++; return; }
+
+    char head[192 + M5_DETAILS_CAPACITY];
+    int headLength = snprintf(head, sizeof(head), "POST /upload HTTP/1.1\r\nHost: %s:%u\r\nContent-Type: %s\r\n%s%s%sContent-Length: %zu\r\n\r\n",
+                              _opt.host, (unsigned)_opt.port, payloadContentType(d.format), json ? "M5-Details: " : "",
+                              json ? details : "", json ? "\r\n" : "", bodyLength);
+    c.out.assign(head, headLength);
+    c.out.append(body, bodyLength);
+    c.retried = false;
+    d.sending = trigger;
+    issue(2 * device, Kind::Upload, device, nowUs());
+  }
+
+  void Fleet::startPoll(uint32_t device) {
+    Device& d = _devices[device];
+    char query[96], head[256];
+    StatePoll::query(query, sizeof(query), d.userId, _opt.longPoll ? _opt.waitS : 0);
+    const char* etag = d.poll.etag();
+    int headLength = snprintf(head, sizeof(head), "GET /state%s HTTP/1.1\r\nHost: %s:%u\r\n%s%s%s\r\n", query, _opt.host,
+                              (unsigned)_opt.port, etag[0] ? "If-None-Match: " : "", etag, etag[0] ? "\r\n" : "");
+    Conn& c = stateConn(device);
+    c.out.assign(head, headLength);
+    c.retried = false;
+    d.pollStartUs = nowUs();
+    issue(2 * device + 1, Kind::State, device, d.pollStartUs);
+  }
+
+  // Hands queued state changes to idle driver connections
+  void Fleet::startSets() {
+    for (size_t i = 2 * _devices.size(); i < _conns.size() && !_sets.empty(); ++i) {
+      Conn& c = _conns[i];
+      if (c.state != ConnState::Idle && c.state != ConnState::Closed) continue;
+      uint32_t device = _sets.front();
+      _sets.pop_front();
+      Device& d = _devices[device];
+      char head[192];
+      int headLength = snprintf(head, sizeof(head), "POST /state?userId=%s&fanState=%s HTTP/1.1\r\nHost: %s:%u\r\nContent-Length: 0\r\n\r\n",
+                                d.userId, d.setTarget ? "true" : "false", _opt.host, (unsigned)_opt.port);
+      c.out.assign(head, headLength);
+      c.retried = false;
+      uint64_t now = nowUs();
+      d.setUs = now; // Propagation is timed from the moment the change is requested
+      issue(i, Kind::Set, device, now);
+    }
+  }
+
+  void Fleet::onWritable(size_t index, uint64_t now) {
+    Conn& c = _conns[index];
+    if (c.state == ConnState::Connecting) {
+      int error = 0; socklen_t length = sizeof(error);
+      if (getsockopt(c.fd, SOL_SOCKET, SO_ERROR, &error, &length) != 0 || error != 0) { fail(index, now, true); return; }
+      c.state = ConnState::Sending;
+    }
+    while (c.sent < c.out.size()) {
+      ssize_t n = send(c.fd, c.out.data() + c.sent, c.out.size() - c.sent, 0);
+      if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) { watch(index); return; }
+      if (n <= 0) { fail(index, now, true); return; }
+      c.sent += n;
+    }
+    c.state = ConnState::Receiving;
+    watch(index);
+  }
+
+  void Fleet::onReadable(size_t index, uint64_t now) {
+    Conn& c = _conns[index];
+    char buffer[4096];
+    for (;;) {
+      ssize_t n = recv(c.fd, buffer, sizeof(buffer), 0);
+      if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+      if (n <= 0) { // Closed by the server
+        if (c.state == ConnState::Idle) closeConn(index);
+        else fail(index, now, true);
+        return;
+      }
+      if (c.state != ConnState::Receiving) continue; // Stray bytes on an idle connection
+      c.in.append(buffer, n);
+    }
+    if (c.state != ConnState::Receiving) return;
+    Response r;
+    int parsed = parseResponse(c.in, r);
+    if (parsed < 0) fail(index, now, false);
+    else if (parsed > 0) finish(index, r, now);
+  }
+
+  // A reused connection that went stale is retried once on a fresh one, like HttpSession
+  void Fleet::fail(size_t index, uint64_t now, bool transport) {
+    Conn& c = _conns[index];
+    closeConn(index);
+    if (transport && c.reused && c.in.empty() && !c.retried) {
+      c.retried = true; _retries++;
+      issue(index, c.kind, c.device, now);
+      return;
+    }
+    Response r;
+    r.code = -1;
+    finish(index, r, now);
+  }
+
+  void Fleet::finish(size_t index, const Response& r, uint64_t now) {
+    Conn& c = _conns[index];
+    Kind kind = c.kind;
+    uint32_t device = c.device;
+    Device& d = _devices[device];
+    KindStats& stats = _stats[(size_t)kind];
+    if (kind == Kind::Upload && r.code == 415 && d.format != PayloadFormat::Json) { // Same fallback as NetWorker::postBatch()
+      c.in.clear();
+      if (r.close) closeConn(index);
+      else { c.state = ConnState::Idle; watch(index); }
+      d.format = PayloadFormat::Json; _fallbacks++;
+      startUpload(device, d.sending);
+      return;
+    }
+    bool ok = (r.code >= 200 && r.code < 300) || (kind == Kind::State && r.code == StatePoll::HTTP_NOT_MODIFIED);
+    if (ok) { stats.ok++; stats.latencyUs.push_back((uint32_t)(now - c.startUs)); }
+    else stats.failed++;
+
+    std::string body, etag; // Copied out: the next response reuses the buffer
+    if (r.code > 0) {
+      body.assign(c.in, r.bodyStart, r.bodyLength);
+      if (r.etag != nullptr) etag.assign(r.etag, r.etagLength);
+      c.in.erase(0, r.bodyStart + r.bodyLength);
+      if (r.close) closeConn(index);
+      else { c.state = ConnState::Idle; watch(index); }
+    }
+
+    switch (kind) {
+      case Kind::Upload:
+        if (d.queued != nullptr) { const char* trigger = d.queued; d.queued = nullptr; startUpload(device, trigger); }
+        break;
+
+      case Kind::State: {
+        StatePoll::Outcome outcome = d.poll.onResponse(r.code, etag.c_str(), body.c_str());
+        if (outcome == StatePoll::Outcome::NotModified) _notModified++;
+        if (outcome == StatePoll::Outcome::BadBody) _badBodies++;
+        if (outcome == StatePoll::Outcome::Parsed && d.poll.isNews(d.poll.state())) {
+          bool first = !d.poll.hasReported();
+          d.poll.markReported(d.poll.state());
+          if (!first) { _changes++; _eventUploads[1]++; startUpload(device, "cloud_state_change"); }
+          if (d.setPending && d.poll.state() == d.setTarget) {
+            d.setPending = false;
+            _propagationUs.push_back((uint32_t)(now - d.setUs));
+          }
+        }
+        // Never faster than pollMs, like CommandChannel::run()
+        uint64_t next = std::max<uint64_t>(d.pollStartUs + _opt.pollMs * 1000ull, now);
+        _timers.push({ next, device, Kind::State });
+        break;
+      }
+
+      default: // Set
+        if (!ok && d.setPending) { d.setPending = false; _superseded++; }
+        startSets();
+        break;
+    }
+  }
+
+  void Fleet::shakeBurst() {
+    std::uniform_int_distribution<uint32_t> pick(0, (uint32_t)_devices.size() - 1);
+    for (uint32_t i = 0; i < _opt.burst; ++i) { _eventUploads[0]++; startUpload(pick(_rng), "shake"); }
+  }
+
+  // Flips fanState for `burst` devices that have no change on its way yet
+  void Fleet::stateBurst() {
+    std::uniform_int_distribution<uint32_t> pick(0, (uint32_t)_devices.size() - 1);
+    for (uint32_t i = 0; i < _opt.burst; ++i) {
+      uint32_t device = pick(_rng);
+      Device& d = _devices[device];
+      if (d.setPending) { _superseded++; continue; }
+      d.setPending = true;
+      d.setTarget = !d.poll.state();
+      _sets.push_back(device);
+    }
+    startSets();
+  }
+
+  void Fleet::report(uint64_t now) {
+    double seconds = (now - _lastReportUs) / 1e6;
+    size_t open = 0, busy = 0;
+    for (const Conn& c : _conns) {
+      if (c.fd >= 0) open++;
+      if (c.state == ConnState::Connecting || c.state == ConnState::Sending || c.state == ConnState::Receiving) busy++;
+    }
+    printf("%5.0f s ", (now - _startUs) / 1e6);
+    for (KindStats& s : _stats) {
+      printf(" %s %7.1f/s", KIND_NAMES[&s - _stats], (s.ok - s.reportedOk) / seconds);
+      s.reportedOk = s.ok;
+    }
+    printf("  connections %zu open, %zu in flight  failed %u\n", open, busy,
+           (unsigned)(_stats[0].failed + _stats[1].failed + _stats[2].failed));
+    fflush(stdout);
+    _lastReportUs = now;
+  }
+
+  void Fleet::summary(uint64_t now) {
+    double seconds = (now - _startUs) / 1e6;
+    printf("\nFleet: %zu devices over %.0f s against %s:%u, %s (%s), uploads every %u s x %u windows (%s)\n", _devices.size(), seconds,
+           _opt.host, (unsigned)_opt.port, _opt.longPoll ? "long-poll" : "conditional poll",
+           _opt.longPoll ? "held up to --wait-s" : "every --poll-ms", (unsigned)_opt.uploadS, (unsigned)_opt.batch, payloadFormatName(_opt.format));
+    uint32_t total = 0;
+    for (KindStats& s : _stats) {
+      std::sort(s.latencyUs.begin(), s.latencyUs.end());
+      total += s.ok;
+      uint32_t sent = s.ok + s.failed;
+      printf("  %-7s %8u ok %6u failed %8.1f req/s  ms p50 %7.2f  p90 %7.2f  p99 %7.2f  max %8.2f  %5.0f B/req\n",
+             KIND_NAMES[&s - _stats], (unsigned)s.ok, (unsigned)s.failed, s.ok / seconds, percentile(s.latencyUs, 50) / 1000,
+             percentile(s.latencyUs, 90) / 1000, percentile(s.latencyUs, 99) / 1000,
+             s.latencyUs.empty() ? 0.0 : s.latencyUs.back() / 1000.0, sent ? (double)s.bytesOut / sent : 0.0);
+    }
+    printf("  total   %8.1f req/s, %u state requests answered 304, %u bad state bodies, %u stale connections retried, %u timed out\n",
+           total / seconds, (unsigned)_notModified, (unsigned)_badBodies, (unsigned)_retries, (unsigned)_timeouts);
+    std::sort(_propagationUs.begin(), _propagationUs.end());
+    uint32_t missed = 0;
+    for (const Device& d : _devices) missed += d.setPending;
+    printf("  propagation  %zu changes seen  ms p50 %.1f  p90 %.1f  p99 %.1f  max %.1f  (%u still on their way, %u skipped)\n",
+           _propagationUs.size(), percentile(_propagationUs, 50) / 1000, percentile(_propagationUs, 90) / 1000,
+           percentile(_propagationUs, 99) / 1000, _propagationUs.empty() ? 0.0 : _propagationUs.back() / 1000.0,
+           (unsigned)missed, (unsigned)_superseded);
+    printf("  events       %u shake, %u cloud_state_change uploads (%u folded into a waiting upload), %u JSON fallbacks\n",
+           (unsigned)_eventUploads[0], (unsigned)_eventUploads[1], (unsigned)_coalesced, (unsigned)_fallbacks);
+  }
+
+  bool Fleet::run() {
+    _startUs = _lastReportUs = nowUs();
+    uint64_t endUs = _startUs + _opt.seconds * 1000000ull;
+    std::uniform_int_distribution<uint64_t> phase(0, _opt.uploadS * 1000000ull - 1);
+    uint64_t rampUs = _opt.rampS * 1000000ull;
+    for (uint32_t i = 0; i < _devices.size(); ++i) {
+      uint64_t onlineUs = _startUs + rampUs * i / _devices.size();
+      _timers.push({ onlineUs, i, Kind::State });
+      _timers.push({ onlineUs + phase(_rng), i, Kind::Upload });
+    }
+    uint64_t nextShake = _opt.shakeEveryS ? _startUs + _opt.shakeEveryS * 1000000ull : UINT64_MAX;
+    uint64_t nextState = _opt.stateEveryS ? _startUs + _opt.stateEveryS * 1000000ull : UINT64_MAX;
+    uint64_t nextReport = _startUs + _opt.reportS * 1000000ull;
+    uint64_t nextSweep = _startUs;
+
+    for (uint64_t now = _startUs; now < endUs; now = nowUs()) {
+      while (!_timers.empty() && _timers.top().atUs <= now) {
+        Timer t = _timers.top();
+        _timers.pop();
+        if (t.kind == Kind::Upload) {
+          startUpload(t.device, "regular");
+          _timers.push({ t.atUs + _opt.uploadS * 1000000ull, t.device, Kind::Upload });
+        } else {
+          startPoll(t.device);
+        }
+      }
+      if (now >= nextShake) { shakeBurst(); nextShake += _opt.shakeEveryS * 1000000ull; }
+      if (now >= nextState) { stateBurst(); nextState += _opt.stateEveryS * 1000000ull; }
+      if (now >= nextReport) { report(now); nextReport += _opt.reportS * 1000000ull; }
+      if (now >= nextSweep) { // Requests past their timeout fail like on the device
+        for (size_t i = 0; i < _conns.size(); ++i) {
+          const Conn& c = _conns[i];
+          bool busy = c.state == ConnState::Connecting || c.state == ConnState::Sending || c.state == ConnState::Receiving;
+          if (busy && now > c.deadlineUs) { _timeouts++; _conns[i].retried = true; fail(i, now, true); }
+        }
+        nextSweep = now + 250000;
+      }
+
+      uint64_t wakeUs = std::min({ endUs, nextShake, nextState, nextReport, nextSweep });
+      if (!_timers.empty()) wakeUs = std::min(wakeUs, _timers.top().atUs);
+      now = nowUs();
+      int timeoutMs = wakeUs > now ? (int)((wakeUs - now + 999) / 1000) : 0;
+      if (poll(_pfds.data(), _pfds.size(), timeoutMs) <= 0) continue;
+      now = nowUs();
+      for (size_t i = 0; i < _pfds.size(); ++i) {
+        short events = _pfds[i].revents;
+        if (events == 0 || _pfds[i].fd < 0) continue;
+        _pfds[i].revents = 0;
+        if (events & POLLOUT) onWritable(i, now);
+        else if (events & (POLLIN | POLLHUP | POLLERR)) onReadable(i, now);
+      }
+    }
+    uint64_t now = nowUs();
+    summary(now);
+    return _stats[0].ok + _stats[1].ok + _stats[2].ok > 0;
+  }
+}
+
+int main(int argc, char** argv) {
+  Options opt;
+  if (!parseOptions(argc, argv, opt)) return 2;
+  signal(SIGPIPE, SIG_IGN); // A server closing mid-send shows up as a send() error instead
+
+  // Two sockets per device plus the driver pool
+  rlimit files;
+  size_t needed = 2 * opt.devices + Fleet::DRIVER_CONNS + 16;
+  if (getrlimit(RLIMIT_NOFILE, &files) == 0 && files.rlim_cur < needed) {
+    files.rlim_cur = std::min<rlim_t>(files.rlim_max, needed);
+    setrlimit(RLIMIT_NOFILE, &files);
+    if (files.rlim_cur < needed) fprintf(stderr, "Warning: %zu sockets needed, open file limit is %lu\n", needed, (unsigned long)files.rlim_cur);
+  }
+
+  in_addr probe;
+  if (inet_pton(AF_INET, opt.host, &probe) != 1) { fprintf(stderr, "--host takes an IPv4 address: %s\n", opt.host); return 2; }
+  Fleet* fleet = new Fleet(opt); // Large (per device buffers): keep it off the stack
+  bool ok = fleet->run();
+  delete fleet;
+  return ok ? 0 : 1;
+}
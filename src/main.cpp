@@ -5,57 +5,110 @@
 #include <ArduinoJson.h> // Ensure v6+ is installed
 #include <Adafruit_VCNL4040.h>
 #include <Adafruit_SHT4x.h>
-#include <WiFiUdp.h>
-#include <NTPClient.h>
-#include <cmath> // For sqrt
+#include <stdarg.h>
+#include "HttpSession.h"
+#include "ClockService.h"
+#include "NetWorker.h"
+#include "FlashQueue.h"
+#include "FlashEventLog.h"
+#include "CommandChannel.h"
+#include "ImuSampler.h"
+#include "M5Ui.h"
+#include "SensorHub.h"
+#include "BoardSensors.h"
+#include "PowerManager.h"
+#include "App.h"
+#include <LittleFS.h>
 
 // --- Configuration ---
 // WiFi credentials
 #define WIFI_SSID "SHaven"       // <-- IMPORTANT: Replace with your WiFi SSID
 #define WIFI_PASSWORD "27431sushi" // <-- IMPORTANT: Replace with your WiFi Password
+// Reconnect from the last good AP channel/BSSID (kept in NVS) without a scan. ChannelAndIp also reuses the
+// last DHCP lease as a static address with no expiry check: only for a router with a reservation for this device
+const FastConnect wifiFastConnect = FastConnect::Channel;
 
 // Cloud Function URLs
-const String URL_GCF_UPLOAD = "https://plant-data-upload-971602190698.us-central1.run.app";
-const String URL_GCF_GET_STATE = "https://get-device-state-971602190698.us-central1.run.app/"; // State check URL
+#ifdef LOCAL_BACKEND // e.g. -DLOCAL_BACKEND='"http://192.168.1.20:8080"' to use tools/standin_server.py
+const char URL_GCF_UPLOAD[] = LOCAL_BACKEND "/upload";
+const char URL_GCF_GET_STATE[] = LOCAL_BACKEND "/state";
+#else
+const char URL_GCF_UPLOAD[] = "https://plant-data-upload-971602190698.us-central1.run.app";
+const char URL_GCF_GET_STATE[] = "https://get-device-state-971602190698.us-central1.run.app/"; // State check URL
+#endif
 
 // Hardcoded userId for this device
-const String userId = "user_1";
+const char userId[] = "user_1";
 
 // Timing
-const unsigned long uploadInterval = 5000;
-const unsigned long commandCheckInterval = 3000;
-unsigned long lastCommandCheckTime = 0;
+const unsigned long commandCheckInterval = 3000; // Poll period / minimum spacing of cloud state requests
+const CommandMode commandMode = CommandMode::LongPoll; // Falls back to conditional polling if the server does not hold requests
+const uint32_t commandLongPollWait = 25;               // Seconds the server may hold a long-poll request
+static_assert(commandLongPollWait <= CommandChannel::MAX_LONG_POLL_WAIT_S, "long-poll read timeout would overflow HTTPClient's uint16_t");
 const unsigned long touchDebounce = 300; // Slightly longer debounce for UI stability
-unsigned long lastTouchTime = 0;
+const uint32_t DISPLAY_TIMEOUT = 60000;  // Display off after a minute without touches (0: always on)
+
+// --- Aggregation ---
+// Every reading is folded into per-window min/max/mean/stddev; a window is only buffered for upload
+// when a channel moved past its deadband or its heartbeat is due
+const AggregationConfig aggregationConfig = { 10000,  // windowMs
+                                              300000, // heartbeatMs: each channel at least every 5 min
+                                              { 5.0f,    // prox (counts)
+                                                10.0f,   // ambient light (lux)
+                                                20.0f,   // white light (counts)
+                                                0.2f,    // temp (C)
+                                                1.0f } }; // rHum (%)
+
+// --- Batched Upload Configuration ---
+const size_t uploadBatchSize = 15;          // Windows per upload request (<= MAX_BATCH_SAMPLES)
+const unsigned long maxBatchAge = 60000;    // Flush a partial batch once its oldest window is this old
+const unsigned long idleMaxBatchAge = 900000; // ...stretched up to this while the display is off and readings are steady
+static_assert(uploadBatchSize <= MAX_BATCH_SAMPLES, "uploadBatchSize exceeds MAX_BATCH_SAMPLES");
+const unsigned long flushRetryInterval = 5000; // Min spacing between flush attempts while uploads fail
+const FlushPolicy uploadFlushPolicy = { uploadBatchSize, maxBatchAge, idleMaxBatchAge };
+// Body encoding: Packed (~30 B per window, see PackedPayload.h) or MsgPack need a server that answers
+// 415 to encodings it does not know (tools/standin_server.py does), then uploads fall back to JSON
+const PayloadFormat uploadFormat = PayloadFormat::Json;
 
 // --- IMU & Vibration Configuration ---
-const float SHAKE_THRESHOLD = 2.5f;
+const uint16_t IMU_SAMPLE_RATE = 200;          // Hz, sampled by the IMU into its FIFO
+const float SHAKE_THRESHOLD = 2.5f;            // Total |a| (g) that counts as an impact by itself
+const float SHAKE_RMS_THRESHOLD = 0.6f;        // Windowed RMS (g, gravity removed) that starts a shake
 const unsigned long SHAKE_COOLDOWN = 2000;
+const MotionConfig motionConfig = { (float)IMU_SAMPLE_RATE, SHAKE_RMS_THRESHOLD, SHAKE_THRESHOLD,
+                                    200,   // releaseMs
+                                    300,   // minShakeMs
+                                    5000,  // maxEventMs
+                                    SHAKE_COOLDOWN };
 const uint8_t VIBRATION_INTENSITY = 200;
 const unsigned long VIBRATION_DURATION = 300;
-unsigned long lastShakeTime = 0;
 
 // --- Popup Configuration ---
-bool showShakePopup = false;
-unsigned long shakePopupStartTime = 0;
 const unsigned long SHAKE_POPUP_DURATION = 1500;
 
-// --- Cloud State Tracking ---
-bool lastCloudState = false;
-bool firstCloudCheck = true;
-
-// --- NEW: UI State & In-Memory Log ---
-enum Page { PAGE_MAIN, PAGE_LOG };
-Page currentPage = PAGE_MAIN;
-
-struct LogEntry {
-  time_t timestamp;
-  const char* eventType; // Store pointer to string literal (make sure literals are used)
-};
-const int MAX_LOG_ENTRIES = 8; // Store last 8 upload events in memory
-LogEntry logEntries[MAX_LOG_ENTRIES];
-int logEntryIndex = 0; // Index for next entry (circular buffer)
-int logEntryCount = 0; // Number of valid entries stored
+// --- Sensor Rates ---
+// Each sensor is read at its own period by SensorHub; every new reading goes into the aggregation window.
+// With the display off a steady channel backs off towards its max period (see the deadbands above).
+const uint32_t PROX_PERIOD = 50;     // Drives the live proximity readout
+const uint32_t PROX_MAX_PERIOD = 800;
+const uint32_t LIGHT_PERIOD = 200;
+const uint32_t LIGHT_MAX_PERIOD = 2000;
+const uint32_t CLIMATE_PERIOD = 2000; // Temperature/humidity change slowly; a conversion takes ~9 ms
+const uint32_t CLIMATE_MAX_PERIOD = 10000;
+
+// --- Power ---
+// Saving: loop() sleeps until App's next deadline instead of a fixed delay, and lowers the clock with
+// the display off. false: the fixed loopInterval delay at full clock, for measuring the difference.
+const bool POWER_SAVING = true;
+const PowerConfig powerConfig = { 50,     // baselineLoopMs
+                                  1000,   // maxSleepMs: network results are picked up at least this often
+                                  240,    // activeCpuMhz
+                                  80,     // idleCpuMhz
+                                  39,     // touchIntPin: FT6336U INT on the Core2
+                                  1000 }; // currentSampleMs
+
+// --- Profiling ---
+const unsigned long perfWindow = 60000; // Per-stage loop timing window; its summary goes out with the next upload
 
 // --- End Configuration ---
 
@@ -63,400 +116,209 @@ int logEntryCount = 0; // Number of valid entries stored
 Adafruit_VCNL4040 vcnl4040 = Adafruit_VCNL4040();
 Adafruit_SHT4x sht4 = Adafruit_SHT4x();
 
-// NTP client
-WiFiUDP ntpUDP;
-NTPClient timeClient(ntpUDP, "pool.ntp.org", -7 * 3600); // UTC-7
-
-// Sensor Data Structure
-struct SensorData {
-  uint16_t prox; uint16_t ambientLight; uint16_t whiteLight;
-  float temp; float rHum;
+// Wall clock: esp_timer disciplined by background SNTP, held across reboots by the RTC
+const int32_t UTC_OFFSET = -7 * 3600; // UTC-7, applied to displayed and uploaded times
+const char NTP_SERVER[] = "pool.ntp.org";
+const uint32_t CLOCK_SYNC_INTERVAL = 3600000; // SNTP once an hour; drift is corrected in between
+ClockService clockService;
+
+// Keep-alive HTTPS sessions, one per endpoint (reused across calls instead of a new TLS handshake each time)
+HttpSession uploadSession(URL_GCF_UPLOAD);
+HttpSession stateSession(URL_GCF_GET_STATE);
+
+// Network task: all radio work happens there, loop() only exchanges queue items with it
+NetWorker netWorker;
+CommandChannel commandChannel; // Cloud state via long-poll/SSE/conditional GET, on its own task
+
+// Store-and-forward queue on LittleFS: failed uploads are kept here across outages and reboots
+// (16 segments x 256 windows x 104 B = ~425 KB cap, 11+ hours of 10 s windows) and replayed by the
+// network task when online
+FlashQueue uploadSpool;
+const uint32_t SPOOL_MAX_SEGMENTS = 16;
+
+// Every upload result (status, HTTP code, latency, body size) for the log page: 32 segments x
+// 1024 records x 20 B = 640 KB, ~32k results (several weeks of uploads); oldest segment dropped when full
+FlashEventLog eventLog;
+const uint32_t EVENT_LOG_MAX_SEGMENTS = 32;
+
+// Loop timing: worst-case busy time of a pass (sleep not included) per report window
+const unsigned long loopStatsInterval = 10000;
+const unsigned long loopInterval = 50; // Pass period without power saving; also the IMU polling fallback rate
+unsigned long loopMaxTime = 0;
+unsigned long lastLoopStatsTime = 0;
+uint32_t loopPasses = 0;
+PowerManager power;
+
+// --- Device Hal ---
+// The application logic lives in App (portable, also built natively); these adapt the board to it.
+
+class BoardSystem : public SystemMonitor {
+public:
+  void read(SystemStats& out) override {
+    out.freeHeap = ESP.getFreeHeap(); out.minFreeHeap = ESP.getMinFreeHeap(); out.largestBlock = ESP.getMaxAllocHeap();
+    out.rssi = WiFi.status() == WL_CONNECTED ? WiFi.RSSI() : 0;
+  }
 };
-SensorData currentData;
-
-// State variables
-unsigned long lastUploadTime = 0;
-
-// --- Layout Constants ---
-namespace Layout {
-  const int headerY = 5; const int headerH = 25;
-  const int dataAreaY = 40; const int dataLabelX = 15;
-  const int dataValueX = 160; const int dataRowH = 28; // Slightly reduced row height for space
-
-  // Buttons (at the bottom)
-  const int buttonH = 35;
-  const int buttonY = 240 - buttonH - 5; // Position near bottom
-  const int logButtonX = 10;
-  const int logButtonW = 145;
-  const int backButtonX = 10; // Same position for Back button
-  const int backButtonW = 145;
-
-  // Log Page Layout
-  const int logTitleY = 10;
-  const int logEntryY = 40;
-  const int logEntryH = 22; // Reduced height for more entries
-  const int logTimestampX = 15;
-  const int logEventX = 175; // Adjusted X for event type
-}
-
-// --- Function Prototypes ---
-void connectWiFi();
-void updateSensors();
-void uploadData(const char* triggerEvent = nullptr);
-String generateM5DetailsHeader(const char* triggerEvent = nullptr);
-// UI Functions
-void drawScreen(); // Combined drawing logic based on currentPage
-void updateScreenData(); // Combined update logic
-void drawMainPage();
-void updateMainPageData();
-void drawLogPage();
-void updateLogPageData();
-void showPopup(const char* message, uint16_t bgColor, uint16_t textColor);
-void clearPopup();
-// Event/Action Functions
-void checkCloudCommand();
-void checkShakeAndVibrate();
-// Touch Handling added back
-void handleTouch();
-bool pointInRect(int x, int y, int rx, int ry, int rw, int rh);
-// Helper
-String formatTimestamp(time_t epochTime);
-// NEW: Log function
-void addLogEntry(const char* eventType);
-
-
-// --- Helper Functions ---
-bool pointInRect(int x, int y, int rx, int ry, int rw, int rh) {
-  return (x >= rx && x <= rx + rw && y >= ry && y <= ry + rh);
-}
-
-String formatTimestamp(time_t epochTime) {
-    if (epochTime == 0) return "No Time";
-    struct tm timeinfo;
-    // Use standard C function gmtime_r to convert epoch to UTC tm struct
-    gmtime_r(&epochTime, &timeinfo);
-    char buffer[20];
-    strftime(buffer, sizeof(buffer), "%m/%d %H:%M:%S", &timeinfo);
-    return String(buffer);
-}
-
-// --- NEW: Add Entry to In-Memory Log ---
-void addLogEntry(const char* eventType) {
-    if (eventType == nullptr) eventType = "regular"; // Default if null passed
-
-    timeClient.update(); // Ensure time is current before logging
-    time_t now_ts = timeClient.getEpochTime();
-
-    logEntries[logEntryIndex].timestamp = now_ts;
-    logEntries[logEntryIndex].eventType = eventType; // Store pointer to the literal
-
-    logEntryIndex = (logEntryIndex + 1) % MAX_LOG_ENTRIES; // Move index circularly
-    if (logEntryCount < MAX_LOG_ENTRIES) {
-        logEntryCount++; // Increment count until buffer is full
-    }
-     Serial.printf("Logged event: %s at %ld\n", eventType, now_ts); // Debug log
-}
-
-
-// --- UI Functions ---
-
-void drawScreen() { // Main drawing router
-    M5.Lcd.fillScreen(BLACK); // Clear screen before drawing page
-    if (currentPage == PAGE_MAIN) {
-        drawMainPage();
-    } else if (currentPage == PAGE_LOG) {
-        drawLogPage();
-    }
-}
-
-void updateScreenData() { // Main update router
-     if (currentPage == PAGE_MAIN) {
-        updateMainPageData();
-    } else if (currentPage == PAGE_LOG) {
-        updateLogPageData(); // Log page needs update if data changes
-    }
-    // Handle popup clearing regardless of page
-    unsigned long now = millis();
-    if (showShakePopup && (now - shakePopupStartTime > SHAKE_POPUP_DURATION)) {
-        clearPopup();
-    }
-}
-
-void drawMainPage() { // Draw static parts of Main Page
-    M5.Lcd.setTextSize(2); M5.Lcd.setTextColor(WHITE, BLACK);
-    // Header
-    M5.Lcd.drawRect(Layout::dataValueX, Layout::headerY, 320 - Layout::dataValueX - 10, Layout::headerH, WHITE);
-    M5.Lcd.setCursor(10, Layout::headerY + 5); M5.Lcd.print(userId);
-    // Sensor Labels
-    int currentY = Layout::dataAreaY;
-    M5.Lcd.setCursor(Layout::dataLabelX, currentY); M5.Lcd.print("Proximity:"); currentY += Layout::dataRowH;
-    M5.Lcd.setCursor(Layout::dataLabelX, currentY); M5.Lcd.print("Amb Light:"); currentY += Layout::dataRowH;
-    M5.Lcd.setCursor(Layout::dataLabelX, currentY); M5.Lcd.print("White Light:"); currentY += Layout::dataRowH;
-    M5.Lcd.setCursor(Layout::dataLabelX, currentY); M5.Lcd.print("Temp (C):"); currentY += Layout::dataRowH;
-    M5.Lcd.setCursor(Layout::dataLabelX, currentY); M5.Lcd.print("Humidity (%):");
-    // Draw "Log" Button
-    M5.Lcd.fillRect(Layout::logButtonX, Layout::buttonY, Layout::logButtonW, Layout::buttonH, TFT_BLUE);
-    M5.Lcd.drawRect(Layout::logButtonX, Layout::buttonY, Layout::logButtonW, Layout::buttonH, TFT_WHITE);
-    M5.Lcd.setTextColor(TFT_WHITE);
-    int textWidth = M5.Lcd.textWidth("View Log"); int textHeight = M5.Lcd.fontHeight();
-    M5.Lcd.setCursor(Layout::logButtonX + (Layout::logButtonW - textWidth) / 2, Layout::buttonY + (Layout::buttonH - textHeight) / 2);
-    M5.Lcd.print("View Log"); M5.Lcd.setTextColor(WHITE, BLACK);
-}
-
-void updateMainPageData() { // Update dynamic parts of Main Page
-    timeClient.update();
-    M5.Lcd.setTextSize(2); M5.Lcd.setTextColor(WHITE, BLACK);
-    M5.Lcd.fillRect(Layout::dataValueX + 1, Layout::headerY + 1, 320 - Layout::dataValueX - 10 - 2, Layout::headerH - 2, BLACK);
-    M5.Lcd.setCursor(Layout::dataValueX + 5, Layout::headerY + 5); M5.Lcd.print(timeClient.getFormattedTime());
-    // Sensor Values
-    char buffer[16]; int currentY = Layout::dataAreaY;
-    M5.Lcd.fillRect(Layout::dataValueX, currentY, 320 - Layout::dataValueX - 10, Layout::dataRowH * 5, BLACK);
-    sprintf(buffer, "%d", currentData.prox); M5.Lcd.setCursor(Layout::dataValueX, currentY); M5.Lcd.print(buffer); currentY += Layout::dataRowH;
-    sprintf(buffer, "%d lux", currentData.ambientLight); M5.Lcd.setCursor(Layout::dataValueX, currentY); M5.Lcd.print(buffer); currentY += Layout::dataRowH;
-    sprintf(buffer, "%d", currentData.whiteLight); M5.Lcd.setCursor(Layout::dataValueX, currentY); M5.Lcd.print(buffer); currentY += Layout::dataRowH;
-    sprintf(buffer, "%.1f", currentData.temp); M5.Lcd.setCursor(Layout::dataValueX, currentY); M5.Lcd.print(buffer); currentY += Layout::dataRowH;
-    sprintf(buffer, "%.1f", currentData.rHum); M5.Lcd.setCursor(Layout::dataValueX, currentY); M5.Lcd.print(buffer);
-}
-
-void drawLogPage() { // Draw static parts of Log Page
-    M5.Lcd.setTextSize(2); M5.Lcd.setTextColor(WHITE, BLACK);
-    M5.Lcd.setCursor(Layout::dataLabelX, Layout::logTitleY); M5.Lcd.print("Recent Upload Log (Device)");
-    // Draw "Back" Button
-    M5.Lcd.fillRect(Layout::backButtonX, Layout::buttonY, Layout::backButtonW, Layout::buttonH, TFT_DARKGREY);
-    M5.Lcd.drawRect(Layout::backButtonX, Layout::buttonY, Layout::backButtonW, Layout::buttonH, TFT_WHITE);
-    M5.Lcd.setTextColor(TFT_WHITE);
-    int textWidth = M5.Lcd.textWidth("Back"); int textHeight = M5.Lcd.fontHeight();
-    M5.Lcd.setCursor(Layout::backButtonX + (Layout::backButtonW - textWidth) / 2, Layout::buttonY + (Layout::buttonH - textHeight) / 2);
-    M5.Lcd.print("Back"); M5.Lcd.setTextColor(WHITE, BLACK);
-    // Update dynamic log data area
-    updateLogPageData();
-}
-
-void updateLogPageData() { // Update dynamic log entries display
-    M5.Lcd.fillRect(0, Layout::logEntryY, M5.Lcd.width(), Layout::buttonY - Layout::logEntryY, BLACK); // Clear log area
-    M5.Lcd.setTextSize(2); M5.Lcd.setTextColor(WHITE, BLACK);
-
-    if (logEntryCount == 0) {
-        M5.Lcd.setCursor(Layout::dataLabelX, Layout::logEntryY); M5.Lcd.print("No log entries yet.");
-        return;
-    }
-
-    int currentY = Layout::logEntryY;
-    // Iterate backwards from the *previous* index in the circular buffer
-    for (int i = 0; i < logEntryCount; ++i) {
-        int indexToShow = (logEntryIndex - 1 - i + MAX_LOG_ENTRIES) % MAX_LOG_ENTRIES; // Calculate index backwards circularly
 
-        M5.Lcd.setCursor(Layout::logTimestampX, currentY);
-        M5.Lcd.print(formatTimestamp(logEntries[indexToShow].timestamp));
-
-        M5.Lcd.setCursor(Layout::logEventX, currentY);
-        M5.Lcd.print(logEntries[indexToShow].eventType);
-
-        currentY += Layout::logEntryH;
-        if (currentY > Layout::buttonY - Layout::logEntryH) break; // Stop if exceeding display area
-    }
-}
-
-void showPopup(const char* message, uint16_t bgColor, uint16_t textColor) { /* ... same as before ... */
-    int popupW = 200; int popupH = 50; int popupX = (M5.Lcd.width() - popupW) / 2; int popupY = (M5.Lcd.height() - popupH) / 2;
-    M5.Lcd.fillRect(popupX, popupY, popupW, popupH, bgColor); M5.Lcd.drawRect(popupX, popupY, popupW, popupH, textColor);
-    M5.Lcd.setTextSize(2); M5.Lcd.setTextColor(textColor); int textWidth = M5.Lcd.textWidth(message); int textHeight = M5.Lcd.fontHeight();
-    int textX = popupX + (popupW - textWidth) / 2; int textY = popupY + (popupH - textHeight) / 2;
-    M5.Lcd.setCursor(textX, textY); M5.Lcd.print(message);
-}
-
-void clearPopup() { /* ... same as before, triggers redraw ... */
-    showShakePopup = false; // Reset flag FIRST
-    // Instead of clearing area, redraw the whole current screen cleanly
-    drawScreen();
-    // updateScreenData(); // Might not be needed if drawScreen calls the update
-}
-
-// --- Touch Handling Added Back ---
-void handleTouch() {
-  auto t = M5.Touch.getDetail(); // Read touch status structure
-
-  // Check if touch occurred (finger down event)
-  if (t.wasPressed()) {
-    // Check debounce only on initial press
-    if (millis() - lastTouchTime < touchDebounce) {
-        return; // Too soon, ignore
-    }
-    lastTouchTime = millis(); // Record time of valid press
-
-    if (currentPage == PAGE_MAIN) {
-      // Check "View Log" button
-      if (pointInRect(t.x, t.y, Layout::logButtonX, Layout::buttonY, Layout::logButtonW, Layout::buttonH)) {
-        Serial.println("Log button pressed.");
-        currentPage = PAGE_LOG;
-        drawScreen(); // Redraw screen for the log page
-      }
-    } else if (currentPage == PAGE_LOG) {
-      // Check "Back" button
-      if (pointInRect(t.x, t.y, Layout::backButtonX, Layout::buttonY, Layout::backButtonW, Layout::buttonH)) {
-        Serial.println("Back button pressed.");
-        currentPage = PAGE_MAIN;
-        drawScreen(); // Redraw screen for the main page
-        // Optional: immediately update dynamic data on main page after switching back
-        // updateMainPageData();
-      }
-    }
+#ifdef TRACE_RECORD
+// Build with -DTRACE_RECORD to print every reading as a trace line for the native simulator:
+//   pio device monitor | grep -E '^[SI],' > trace.csv
+class TracingSensors : public EnvSensors {
+public:
+  explicit TracingSensors(EnvSensors& inner) : _inner(inner) {}
+  uint8_t read(SensorData& out, uint32_t (&capturedMs)[ENV_CHANNELS]) override {
+    uint8_t updated = _inner.read(out, capturedMs);
+    if (updated) Serial.printf("S,%lu,%u,%u,%u,%.2f,%.2f\n", millis(), out.prox, out.ambientLight, out.whiteLight, out.temp, out.rHum);
+    return updated;
   }
-  // No complex logic needed for finger lift (isreleased) with this simple setup
-}
-
-// --- Sensor & Network Functions ---
-
-void updateSensors() { /* ... same as before ... */
-  currentData.prox = vcnl4040.getProximity(); currentData.ambientLight = vcnl4040.getLux(); currentData.whiteLight = vcnl4040.getWhiteLight();
-  sensors_event_t humidity, temperature; sht4.getEvent(&humidity, &temperature);
-  currentData.temp = temperature.temperature; currentData.rHum = humidity.relative_humidity;
-}
-
-// Modified uploadData to add log entry
-void uploadData(const char* triggerEvent) {
-  if (WiFi.status() != WL_CONNECTED) { Serial.println("WiFi disconnected. Cannot upload."); return; }
-
-  timeClient.update(); String headerValue = generateM5DetailsHeader(triggerEvent);
-  WiFiClientSecure client; client.setInsecure(); HTTPClient http;
-  Serial.print("Uploading data"); if (triggerEvent != nullptr) { Serial.printf(" (Trigger: %s)", triggerEvent); } Serial.print("...");
-
-  bool uploadSuccess = false;
-  if (http.begin(client, URL_GCF_UPLOAD)) {
-    http.addHeader("M5-Details", headerValue); int httpCode = http.GET();
-    if (httpCode > 0) {
-      Serial.printf(" Upload successful, HTTP code: %d\n", httpCode);
-      uploadSuccess = true; // Mark success
-    } else {
-      Serial.printf(" Upload failed, error: %s\n", http.errorToString(httpCode).c_str());
-    }
-    http.end();
-  } else { Serial.println(" Failed to connect to upload URL."); }
-
-  // Add log entry after attempting upload (could log success/failure too if needed)
-  addLogEntry(triggerEvent ? triggerEvent : "regular"); // Log event type
-}
-
-String generateM5DetailsHeader(const char* triggerEvent) { /* ... same as before ... */
-    StaticJsonDocument<512> doc; JsonObject vcnl = doc.createNestedObject("vcnlDetails");
-    vcnl["prox"] = currentData.prox; vcnl["al"] = currentData.ambientLight; vcnl["wl"] = currentData.whiteLight;
-    JsonObject sht = doc.createNestedObject("shtDetails"); sht["temp"] = currentData.temp; sht["rHum"] = currentData.rHum;
-    JsonObject other = doc.createNestedObject("otherDetails"); other["timeCaptured"] = timeClient.getEpochTime(); other["userId"] = userId;
-    if (triggerEvent != nullptr) { other["triggerEvent"] = triggerEvent; }
-    String output; serializeJson(doc, output); return output;
-}
+  uint32_t msUntilDue(uint32_t nowMs) override { return _inner.msUntilDue(nowMs); }
+  void setAdaptive(bool adaptive) override { _inner.setAdaptive(adaptive); }
+private:
+  EnvSensors& _inner;
+};
 
-void connectWiFi() { /* ... same as before ... */
-    WiFi.begin(WIFI_SSID, WIFI_PASSWORD); Serial.print("Connecting to WiFi");
-    M5.Lcd.setTextSize(2); M5.Lcd.setCursor(10, 10); M5.Lcd.print("Connecting WiFi..."); int attempt = 0;
-    while (WiFi.status() != WL_CONNECTED) { delay(500); Serial.print("."); if(++attempt > 20) { Serial.println("\nFailed to connect."); M5.Lcd.fillScreen(BLACK); M5.Lcd.setCursor(10, 10); M5.Lcd.setTextColor(TFT_RED); M5.Lcd.print("WiFi Connection Failed!"); while(true) delay(1000); } }
-    Serial.println("\nConnected! IP: " + WiFi.localIP().toString()); M5.Lcd.fillScreen(BLACK); M5.Lcd.setTextColor(WHITE, BLACK);
-}
+class TracingImu : public MotionSensor {
+public:
+  explicit TracingImu(MotionSensor& inner) : _inner(inner) {}
+  bool available() override { return _inner.available(); }
+  uint16_t rateHz() override { return _inner.rateHz(); }
+  uint32_t maxDrainIntervalMs() override { return _inner.maxDrainIntervalMs(); }
+  size_t drain(ImuSample* out, size_t max) override {
+    size_t n = _inner.drain(out, max);
+    for (size_t i = 0; i < n; ++i) Serial.printf("I,%lu,%.3f,%.3f,%.3f\n", (unsigned long)out[i].tMs, out[i].ax, out[i].ay, out[i].az);
+    return n;
+  }
+private:
+  MotionSensor& _inner;
+};
+#endif
 
-void checkCloudCommand() { /* ... same state change detection as before ... */
-    if (WiFi.status() != WL_CONNECTED) { return; } if (URL_GCF_GET_STATE == "" ) { return; }
-    WiFiClientSecure client; client.setInsecure(); HTTPClient http; String requestUrl = URL_GCF_GET_STATE; requestUrl += "?userId=" + String(userId);
-    if (http.begin(client, requestUrl)) {
-        int httpCode = http.GET();
-        if (httpCode == HTTP_CODE_OK) {
-            String payload = http.getString(); StaticJsonDocument<512> doc; DeserializationError error = deserializeJson(doc, payload);
-            if (error) { Serial.print("State JSON parsing failed: "); Serial.println(error.c_str()); }
-            else {
-                if (doc.containsKey("fanState")) { // Still using "fanState" key as discussed
-                    bool currentCloudState = doc["fanState"];
-                    if (firstCloudCheck) { lastCloudState = currentCloudState; firstCloudCheck = false; Serial.printf("Initial cloud state received: %s\n", currentCloudState ? "TRUE" : "FALSE"); }
-                    else if (currentCloudState != lastCloudState) {
-                        Serial.printf("Cloud state changed from %s to %s. Triggering actions.\n", lastCloudState ? "TRUE" : "FALSE", currentCloudState ? "TRUE" : "FALSE");
-                        Serial.println("Vibrating (Cloud State Change)..."); M5.Power.setVibration(VIBRATION_INTENSITY); delay(VIBRATION_DURATION); M5.Power.setVibration(0);
-                        uploadData("cloud_state_change"); // Log this specific event
-                        lastCloudState = currentCloudState;
-                    }
-                } else { Serial.println("State JSON response missing 'fanState' key."); }
-            }
-        } // else { /* Handle HTTP errors if needed */ }
-        http.end();
-    } // else { /* Handle connection error if needed */ }
+void logPrintf(const char* format, ...) {
+  char buffer[192];
+  va_list args; va_start(args, format); vsnprintf(buffer, sizeof(buffer), format, args); va_end(args);
+  Serial.print(buffer);
 }
 
-void checkShakeAndVibrate() { /* ... same as before, calls showPopup ... */
-    if (showShakePopup) return; float accX, accY, accZ; M5.Imu.getAccelData(&accX, &accY, &accZ); float magnitude = sqrt(accX * accX + accY * accY + accZ * accZ); unsigned long now = millis();
-    if (magnitude > SHAKE_THRESHOLD && (now - lastShakeTime > SHAKE_COOLDOWN)) {
-        Serial.printf("Shake detected! Magnitude: %.2f G\n", magnitude); lastShakeTime = now;
-        Serial.println("Vibrating (Shake)..."); M5.Power.setVibration(VIBRATION_INTENSITY); delay(VIBRATION_DURATION); M5.Power.setVibration(0);
-        showPopup("SHAKE DETECTED", TFT_ORANGE, TFT_WHITE); showShakePopup = true; shakePopupStartTime = now;
-        uploadData("shake"); // Log this specific event
-    }
-}
+SensorHub sensorHub(clockService); // Per-sensor rates, conversions never waited on in loop()
+Vcnl4040Proximity proxChannel(vcnl4040);
+Vcnl4040Light lightChannel(vcnl4040);
+Sht4xChannel climateChannel(Wire);
+BoardSystem boardSystem;
+ImuSampler imuSampler; // Accelerometer FIFO, drained by App every loop() pass
+#ifdef TRACE_RECORD
+TracingSensors tracingSensors(sensorHub);
+EnvSensors& sensorSource = tracingSensors;
+TracingImu tracingImu(imuSampler);
+MotionSensor& imuSource = tracingImu;
+#else
+EnvSensors& sensorSource = sensorHub;
+MotionSensor& imuSource = imuSampler;
+#endif
+M5Ui ui;
+App app;
 
 
 // --- Setup & Main Loop ---
 void setup() {
   auto cfg = M5.config(); M5.begin(cfg);
   M5.Lcd.setRotation(1); M5.Lcd.fillScreen(BLACK); Serial.begin(115200);
-  M5.Touch.begin(&M5.Display); // Initialize Touch for buttons
+  clockService.begin(UTC_OFFSET, NTP_SERVER, CLOCK_SYNC_INTERVAL); // Valid time from the RTC before WiFi is up
+
+  // Flash spool for offline uploads (formats the partition on first boot)
+  FlashQueue* spool = nullptr;
+  if (LittleFS.begin(true) && uploadSpool.begin(LittleFS, "/spool", SPOOL_MAX_SEGMENTS)) {
+    spool = &uploadSpool; Serial.printf("Upload spool OK, %u samples pending.\n", (unsigned)uploadSpool.size());
+  } else { Serial.println("LittleFS/spool Error! Offline uploads will not persist."); }
+  if (eventLog.begin(LittleFS, "/events", EVENT_LOG_MAX_SEGMENTS)) {
+    Serial.printf("Event log OK, %lu records (%lu corrupt index points).\n", (unsigned long)eventLog.size(), (unsigned long)eventLog.corruptRecords());
+  } else { Serial.println("Event log Error! Upload history will not persist."); }
+
+  // WiFi and HTTP run on the network task (SNTP in the background once it connects); setup() and loop() never wait for the radio.
+  // Started before the display and sensors so the radio associates while they come up.
+  NetWorkerConfig netConfig = { WIFI_SSID, WIFI_PASSWORD, userId, &uploadSession, &clockService, spool, uploadFormat, wifiFastConnect };
+  if (!netWorker.begin(netConfig)) { Serial.println("Network task failed to start!"); }
+  CommandChannelConfig commandConfig = { &stateSession, userId, &netWorker, commandMode, commandCheckInterval, commandLongPollWait };
+  if (URL_GCF_GET_STATE[0] != '\0' && !commandChannel.begin(commandConfig)) { Serial.println("Command channel failed to start!"); }
+
+  ui.begin(userId, touchDebounce, POWER_SAVING ? DISPLAY_TIMEOUT : 0);
 
   if (!M5.Imu.isEnabled()) { Serial.println("IMU Failed!"); M5.Lcd.setTextColor(TFT_RED); M5.Lcd.println("IMU Error!"); }
   else { Serial.println("IMU Initialized."); }
+  imuSampler.begin(IMU_SAMPLE_RATE, 1000 / loopInterval); // Polling fallback gets one sample per loop() pass
 
-  Serial.println("M5 Core 2 Sensor Upload + In-Memory Log");
+  Serial.println("M5 Core 2 Sensor Upload + Event Log");
 
   // Sensor Init
   if (!vcnl4040.begin()) { Serial.println("VCNL4040 Error!"); M5.Lcd.setTextColor(TFT_RED); M5.Lcd.println("VCNL4040 Error!"); while (1) delay(1); }
   else { Serial.println("VCNL4040 OK."); }
   if (!sht4.begin()) { Serial.println("SHT4x Error!"); M5.Lcd.setTextColor(TFT_RED); M5.Lcd.println("SHT4x Error!"); while (1) delay(1); }
   else { Serial.println("SHT4x OK."); }
-  sht4.setPrecision(SHT4X_HIGH_PRECISION); sht4.setHeater(SHT4X_NO_HEATER);
-
-  connectWiFi();
-  timeClient.begin(); timeClient.update();
-
-  drawScreen(); // Draw the initial page (Main Page)
-  updateSensors();
-  // updateScreenData(); // Called within drawScreen -> drawMainPage -> updateMainPageData? No, call explicitly.
-  updateMainPageData(); // Update dynamic data on initial page
+  sensorHub.add(proxChannel, PROX_PERIOD, PROX_MAX_PERIOD); sensorHub.add(lightChannel, LIGHT_PERIOD, LIGHT_MAX_PERIOD);
+  sensorHub.add(climateChannel, CLIMATE_PERIOD, CLIMATE_MAX_PERIOD); // SHT4x found and reset by sht4.begin(), then driven directly
+  sensorHub.setDeadbands(aggregationConfig.deadband); // A reading that would not be uploaded does not speed the channel up
+
+  AppConfig appConfig = { userId, aggregationConfig, uploadFlushPolicy, flushRetryInterval, motionConfig,
+                          VIBRATION_INTENSITY, VIBRATION_DURATION, SHAKE_POPUP_DURATION, perfWindow };
+  AppHal hal = { &clockService, &sensorSource, &imuSource, &ui, &netWorker, &boardSystem, &eventLog };
+  app.begin(appConfig, hal); // Draws the initial page (Main Page)
+  power.begin(powerConfig);
+  Serial.printf("Setup done at %lu ms after boot.\n", millis()); // The network task logs when the first upload got through
 }
 
 void loop() {
+  unsigned long loopStart = millis();
+  LoopProfiler& profiler = app.profiler();
+  uint32_t t = profiler.now();
   M5.update(); // Essential M5 update
-  handleTouch(); // Process button presses for navigation
-
-  // --- Run Checks and Updates ---
-  if (currentPage == PAGE_MAIN) { // Only check sensors/cloud/shake if on main page?
-      if (M5.Imu.isEnabled() && !showShakePopup) {
-          checkShakeAndVibrate();
-      }
-      // Cloud check (HTTP request throttled inside function by timer logic below)
-      checkCloudCommand();
-      updateSensors();
-  }
-
-  updateScreenData(); // Update screen based on currentPage, handles popup clearing
+  clockService.service(); // Writes the RTC after an SNTP sync (internal I2C, so from loop())
+  profiler.lap(LoopStage::Board, t);
+  app.loop();  // Touch, network results, IMU, sensors, screen, sampling and uploads (timed per stage)
 
-  // --- Timed Actions ---
+  // Display off: clock down, WiFi deeper modem sleep, light sleep between passes
+  PowerMode mode = !POWER_SAVING ? PowerMode::Baseline : ui.awake() ? PowerMode::Active : PowerMode::Idle;
+  if (power.setMode(mode)) profiler.clockChanged();
   unsigned long now = millis();
-
-  // Regular Upload Timer (runs regardless of page?)
-  if (now - lastUploadTime >= uploadInterval) {
-     Serial.println("Regular upload interval reached.");
-     uploadData("regular"); // This logs the event too
-     lastUploadTime = now;
+  power.service(now);
+  loopPasses++;
+  if (now - loopStart > loopMaxTime) loopMaxTime = now - loopStart;
+
+  // Loop Stats: report the worst pass (should stay under 60 ms even with a slow server)
+  if (now - lastLoopStatsTime >= loopStatsInterval) {
+     Renderer& renderer = ui.renderer();
+     Serial.printf("Loop max pass: %lu ms, %lu passes, pixels/frame last %lu max %lu avg %lu\n", loopMaxTime, (unsigned long)loopPasses,
+                   (unsigned long)renderer.lastFramePixels(), (unsigned long)renderer.maxFramePixels(),
+                   (unsigned long)(renderer.frames() ? renderer.totalPixels() / renderer.frames() : 0));
+     Serial.printf("IMU: %lu samples, %u max queued, %lu FIFO overflows\n", (unsigned long)imuSampler.samples(),
+                   (unsigned)imuSampler.maxBacklog(), (unsigned long)imuSampler.overflows());
+     Serial.print("Sensors:");
+     for (size_t i = 0; i < sensorHub.channelCount(); ++i) {
+       const SensorChannelStats& stats = sensorHub.channelStats(i);
+       Serial.printf(" %s %lu reads/%lu errors", sensorHub.channelName(i), (unsigned long)stats.reads, (unsigned long)stats.errors);
+     }
+     Serial.printf(", %lu SHT4x CRC errors\n", (unsigned long)climateChannel.crcErrors());
+     ClockService::Status clock = clockService.status();
+     Serial.printf("Clock: %s, %lu syncs, last correction %ld ms, drift %.2f ppm, %lu s since sync\n",
+                   ClockService::sourceName(clock.source), (unsigned long)clock.syncs, (long)clock.lastCorrectionMs,
+                   clock.driftPpm, (unsigned long)clock.sinceSyncS);
+     const LinkStats& link = netWorker.linkStats();
+     Serial.printf("WiFi: %lu connects (%lu cached, %lu cache misses), %lu drops, last connect %lu ms, first upload %lu ms after %s\n",
+                   (unsigned long)link.connects, (unsigned long)link.cachedConnects, (unsigned long)link.cacheMisses,
+                   (unsigned long)link.drops, (unsigned long)link.lastConnectMs, (unsigned long)link.lastFirstUploadMs,
+                   link.drops ? "the last drop" : "boot");
+     Serial.printf("Uploads: %lu batches (%lu samples) dropped as rejected\n", (unsigned long)netWorker.droppedBatches(),
+                   (unsigned long)netWorker.droppedSamples());
+     Serial.printf("Power: %s, %lu touch wakeups, sensor periods", PowerManager::modeName(power.mode()), (unsigned long)power.wakeups());
+     for (size_t i = 0; i < sensorHub.channelCount(); ++i) Serial.printf(" %lu", (unsigned long)sensorHub.channelPeriod(i));
+     Serial.print(" ms, battery");
+     for (size_t i = 0; i < (size_t)PowerMode::Count; ++i) {
+       PowerManager::Stats stats = power.stats((PowerMode)i);
+       if (stats.seconds) Serial.printf(" %s %.1f mA (%lu s)", PowerManager::modeName((PowerMode)i), stats.avgMa, (unsigned long)stats.seconds);
+     }
+     Serial.println();
+     loopMaxTime = 0; loopPasses = 0; lastLoopStatsTime = now; renderer.resetFrameStats(); imuSampler.resetStats();
   }
 
-  // Cloud State Check Timer (throttles HTTP requests in checkCloudCommand)
-  if (now - lastCommandCheckTime >= commandCheckInterval) {
-    // Only need to update the timer; the check itself runs every loop but respects this timer internally? No, the check needs to be here.
-    // Let's move the checkCloudCommand call here to throttle it properly.
-    // checkCloudCommand(); // Call it here based on the timer
-    // lastCommandCheckTime = now; // Reset timer
-     // Correction: The checkCloudCommand needs to run frequently to detect changes,
-     // but the HTTP request *within* it should be throttled. Let's revert the logic.
-     // Put the *timer update* here, and call checkCloudCommand every loop.
-     // The HTTP request *inside* checkCloudCommand should be the throttled part.
-     // --> Re-evaluating: The previous code called checkCloudCommand based on timer. Let's stick to that.
-     checkCloudCommand(); // Check cloud state if interval passed
-     lastCommandCheckTime = now;
-  }
-
-
-  delay(50); // Yield
-}
\ No newline at end of file
+  uint32_t sleepStartUs = micros(); // The cycle counter stops in light sleep; esp_timer does not
+  power.wait(app.msUntilDue());     // Until the next sensor/IMU/timer deadline, or a touch
+  profiler.recordUs(LoopStage::Idle, micros() - sleepStartUs);
+}
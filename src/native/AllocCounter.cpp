@@ -0,0 +1,28 @@
+#include "AllocCounter.h"
+#include <new>
+#include <stdlib.h>
+
+namespace {
+  uint64_t allocCount = 0;
+  uint64_t allocBytes = 0;
+
+  void* countedAlloc(size_t size) {
+    allocCount++; allocBytes += size;
+    void* p = malloc(size ? size : 1);
+    if (p == nullptr) throw std::bad_alloc();
+    return p;
+  }
+}
+
+namespace AllocCounter {
+  uint64_t count() { return allocCount; }
+  uint64_t bytes() { return allocBytes; }
+  void watchCurrentTask() {} // Single-threaded: everything is counted
+}
+
+void* operator new(size_t size) { return countedAlloc(size); }
+void* operator new[](size_t size) { return countedAlloc(size); }
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
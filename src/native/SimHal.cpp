@@ -0,0 +1,177 @@
+#include "SimHal.h"
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+#include "AllocCounter.h"
+
+// --- TraceChannel / TraceImu ---
+
+bool TraceChannel::collect(SensorData& out) {
+  const std::vector<EnvRow>& rows = _trace.env();
+  uint32_t now = _clock.millis();
+  // Advance to the last row at or before now, wrapping around the recording
+  for (;;) {
+    size_t next = _cursor + 1;
+    if (next == rows.size()) {
+      if (_loopBaseMs + _trace.durationMs() > now) break;
+      _loopBaseMs += _trace.durationMs(); _cursor = 0; continue;
+    }
+    if (_loopBaseMs + rows[next].tMs > now) break;
+    _cursor = next;
+  }
+  const SensorData& row = rows[_cursor].data;
+  if (_fields & PROX) out.prox = row.prox;
+  if (_fields & LIGHT) { out.ambientLight = row.ambientLight; out.whiteLight = row.whiteLight; }
+  if (_fields & CLIMATE) { out.temp = row.temp; out.rHum = row.rHum; }
+  return true;
+}
+
+size_t TraceImu::drain(ImuSample* out, size_t max) {
+  const std::vector<ImuSample>& samples = _trace.imu();
+  uint32_t now = _clock.millis();
+  size_t n = 0;
+  while (n < max) {
+    if (_cursor == samples.size()) { _cursor = 0; _loopBaseMs += _trace.durationMs(); }
+    const ImuSample& s = samples[_cursor];
+    uint32_t t = _loopBaseMs + s.tMs;
+    if (t > now) break;
+    out[n] = s; out[n].tMs = t;
+    n++; _cursor++;
+  }
+  _samples += n;
+  return n;
+}
+
+// --- SimUi ---
+
+void SimUi::showPage(UiPage page) {
+  _page = page; _pageDraws++;
+  _clockText[0] = '\0';
+  for (auto& v : _values) v[0] = '\0';
+  _logStatus[0] = '\0';
+  for (auto& r : _logRows) r[0] = '\0';
+  for (auto& r : _diagRows) r[0] = '\0';
+}
+
+void SimUi::setField(char* shown, const char* text, const char* col2) {
+  char next[TEXT];
+  snprintf(next, sizeof(next), "%.40s\t%.40s", text, col2 ? col2 : "");
+  _fieldSets++;
+  if (shown[0] != '\0' && strcmp(shown, next) == 0) return; // TextField would not push
+  strcpy(shown, next);
+  _fieldPushes++;
+}
+
+UiButton SimUi::pollButton() {
+  if (_pageSwitchMs == 0 || _clock.millis() - _lastSwitchMs < _pageSwitchMs) return UiButton::None;
+  bool wasAwake = awake();
+  _lastSwitchMs = _clock.millis();
+  if (!wasAwake) return UiButton::None; // Wake-up touch
+  if (_page == UiPage::Log) {
+    static const UiButton steps[] = { UiButton::LogOlder, UiButton::HourOlder, UiButton::ScrollNewer, UiButton::Back };
+    UiButton button = steps[_logStep];
+    _logStep = (_logStep + 1) % (sizeof(steps) / sizeof(steps[0]));
+    return button;
+  }
+  if (_page != UiPage::Main) return UiButton::Back;
+  UiButton button = _diagNext ? UiButton::ViewDiag : UiButton::ViewLog;
+  _diagNext = !_diagNext;
+  return button;
+}
+
+// --- SimEventLog ---
+
+size_t SimEventLog::read(uint32_t seq, EventRecord* out, size_t count) {
+  if (seq < first()) return 0;
+  size_t n = 0;
+  for (; n < count && seq < _end; ++n, ++seq) out[n] = _records[seq % CAPACITY];
+  _reads++; _recordsRead += n;
+  return n;
+}
+
+uint32_t SimEventLog::seek(uint32_t epoch) {
+  _seeks++;
+  uint32_t lo = first(), hi = _end;
+  while (lo < hi) {
+    uint32_t mid = lo + (hi - lo) / 2;
+    if (_records[mid % CAPACITY].epoch >= epoch) hi = mid; else lo = mid + 1;
+  }
+  return lo;
+}
+
+// --- SimLink ---
+
+bool SimLink::submitUpload(const UploadJob& job) {
+  if (_jobCount == JOB_QUEUE_DEPTH) return false;
+  _jobs[(_jobHead + _jobCount) % JOB_QUEUE_DEPTH] = job;
+  _jobCount++;
+  return true;
+}
+
+bool SimLink::pollEvent(NetEvent& event) {
+  if (_eventCount == 0) return false;
+  event = _events[_eventHead];
+  _eventHead = (_eventHead + 1) % EVENT_QUEUE_DEPTH; _eventCount--;
+  return true;
+}
+
+bool SimLink::postEvent(const NetEvent& event) {
+  if (_eventCount == EVENT_QUEUE_DEPTH) return false;
+  _events[(_eventHead + _eventCount) % EVENT_QUEUE_DEPTH] = event;
+  _eventCount++;
+  return true;
+}
+
+void SimLink::service() {
+  uint32_t now = _clock.millis();
+
+  // WiFi association, then the uploads it enables
+  if (!_linkReported && now >= _connectMs) {
+    NetEvent ev = {};
+    ev.type = NetEventType::LinkUp; ev.success = true; ev.cached = true; ev.handshakeMs = _connectMs; // connectMs models a cached reconnect
+    _linkReported = postEvent(ev);
+  }
+  if (!_linkReported) return;
+
+  // Cloud state: first report right away, then a change every _cloudToggleMs
+  if (!_cloudReported || (_cloudToggleMs && now - _lastToggleMs >= _cloudToggleMs)) {
+    if (_cloudReported) _cloudState = !_cloudState;
+    NetEvent ev = {};
+    ev.type = NetEventType::CloudState; ev.success = true; ev.cloudState = _cloudState; ev.httpCode = 200;
+    if (postEvent(ev)) { _cloudReported = true; _lastToggleMs = now; _stats.cloudEvents++; }
+  }
+
+  // One upload at a time: start the oldest job, finish it latencyMs later
+  if (!_busy && _jobCount > 0) { _busy = true; _busyUntilMs = now + _latencyMs; }
+  if (!_busy || (int32_t)(now - _busyUntilMs) < 0 || _eventCount == EVENT_QUEUE_DEPTH) return;
+
+  const UploadJob& job = _jobs[_jobHead];
+  const MotionEvent* motion = job.motion.kind != MotionKind::None ? &job.motion : nullptr;
+  uint64_t allocsBefore = AllocCounter::count();
+  auto start = std::chrono::steady_clock::now();
+  const PerfSummary* perf = job.perf.seq != 0 ? &job.perf : nullptr;
+  size_t bodyLen = buildBatch(_format, _body, sizeof(_body), _userId, job.triggerEvent, job.samples, job.count, motion, perf);
+  bool json = _format == PayloadFormat::Json; // Binary bodies go without M5-Details, like NetWorker
+  size_t headerLen = json ? generateM5DetailsHeader(_details, sizeof(_details), job.samples[job.count - 1], _userId, job.triggerEvent, motion) : 0;
+  _stats.serializeNs += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+  _stats.serializeAllocs += AllocCounter::count() - allocsBefore;
+
+  _stats.uploads++; _stats.samples += job.count;
+  if (motion) _stats.motionUploads++;
+  if (perf) _stats.perfUploads++;
+  _stats.bodyBytes += bodyLen; _stats.headerBytes += headerLen;
+  if (bodyLen > _stats.maxBodyBytes) _stats.maxBodyBytes = bodyLen;
+  if (headerLen > _stats.maxHeaderBytes) _stats.maxHeaderBytes = headerLen;
+
+  NetEvent ev = {};
+  ev.type = NetEventType::UploadDone; ev.count = job.count; ev.triggerEvent = job.triggerEvent;
+  ev.transferMs = _latencyMs; ev.bodyBytes = bodyLen;
+  bool fail = bodyLen == 0 || (json && headerLen == 0) || (_failEvery && _stats.uploads % _failEvery == 0);
+  ev.success = !fail; ev.httpCode = fail ? 503 : 200;
+  if (fail) _stats.failed++;
+  else if (_stats.firstUploadMs == 0) _stats.firstUploadMs = now;
+  postEvent(ev);
+
+  _jobHead = (_jobHead + 1) % JOB_QUEUE_DEPTH; _jobCount--;
+  _busy = false;
+}
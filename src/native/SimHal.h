@@ -0,0 +1,207 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "Hal.h"
+#include "SensorHub.h"
+#include "Trace.h"
+
+// Simulated hardware for the native build. Time is virtual: the driver advances
+// SimClock between App::loop() calls, so a 10-minute run takes milliseconds and
+// every run sees the same inputs.
+
+class SimClock : public Clock {
+public:
+  static constexpr uint32_t START_EPOCH = 1760000000; // Arbitrary fixed wall-clock start
+
+  explicit SimClock(uint32_t syncAfterMs = 0) : _syncAfterMs(syncAfterMs) {}
+  void advance(uint32_t ms) { _nowMs += ms; }
+
+  uint32_t millis() override { return _nowMs; }
+  bool timeSet() override { return _nowMs >= _syncAfterMs; }
+  uint64_t epochMs() override { return timeSet() ? (uint64_t)START_EPOCH * 1000 + _nowMs : 0; }
+
+private:
+  uint32_t _nowMs = 0;
+  uint32_t _syncAfterMs;  // Emulates waiting for the first NTP sync
+};
+
+// One sensor channel replayed from the trace: after a simulated conversion time,
+// copies the fields it owns from the trace row at collect time. Registered on a
+// SensorHub like the device channels (BoardSensors.h).
+class TraceChannel : public SensorChannel {
+public:
+  enum Fields : uint8_t { // EnvChannel bits
+    PROX = envChannelBit(EnvChannel::Prox),
+    LIGHT = envChannelBit(EnvChannel::AmbientLight) | envChannelBit(EnvChannel::WhiteLight),
+    CLIMATE = envChannelBit(EnvChannel::Temp) | envChannelBit(EnvChannel::RHum),
+  };
+
+  TraceChannel(const char* name, const Trace& trace, Clock& clock, uint8_t fields, uint32_t conversionMs)
+    : _name(name), _trace(trace), _clock(clock), _fields(fields), _conversionMs(conversionMs) {}
+  const char* name() const override { return _name; }
+  uint8_t channels() const override { return _fields; }
+  bool trigger(uint32_t& waitMs) override { waitMs = _conversionMs; return !_trace.env().empty(); }
+  bool collect(SensorData& out) override;
+
+private:
+  const char* _name;
+  const Trace& _trace;
+  Clock& _clock;
+  uint8_t _fields;
+  uint32_t _conversionMs;
+  size_t _cursor = 0;
+  uint32_t _loopBaseMs = 0;
+};
+
+class TraceImu : public MotionSensor {
+public:
+  TraceImu(const Trace& trace, Clock& clock) : _trace(trace), _clock(clock) {}
+  bool available() override { return !_trace.imu().empty(); }
+  uint16_t rateHz() override { return _trace.imuRateHz(); }
+  size_t drain(ImuSample* out, size_t max) override;
+  // Like ImuSampler's: two thirds of the time the MPU6886's 128-packet (accel + temp) FIFO takes to fill
+  uint32_t maxDrainIntervalMs() override { return rateHz() ? 128 * 1000 / rateHz() * 2 / 3 : 0; }
+  uint32_t samples() const { return _samples; }
+
+private:
+  const Trace& _trace;
+  Clock& _clock;
+  size_t _cursor = 0;
+  uint32_t _loopBaseMs = 0;
+  uint32_t _samples = 0;
+};
+
+// Fixed heap/RSSI figures (the host heap says nothing about the device's).
+class SimSystem : public SystemMonitor {
+public:
+  void read(SystemStats& out) override { out = { 180 * 1024, 150 * 1024, 110 * 1024, -60 }; }
+};
+
+// Keeps what each field shows, like TextField, and counts how often it would push.
+// Every pageSwitchMs presses a button: "View Log", "Older", hour flick, scroll flick, "Back",
+// "Diagnostics", "Back", ... so every page and log navigation gets exercised. Like M5Ui, the
+// display sleeps displayTimeoutMs after the last press (0: never) and the press that wakes it does nothing else.
+class SimUi : public Ui {
+public:
+  SimUi(Clock& clock, uint32_t pageSwitchMs, uint32_t displayTimeoutMs = 0)
+    : _clock(clock), _pageSwitchMs(pageSwitchMs), _displayTimeoutMs(displayTimeoutMs) {}
+
+  void showPage(UiPage page) override;
+  void setClock(const char* text) override { setField(_clockText, text, ""); }
+  void setValue(size_t row, const char* text) override { if (row < VALUE_ROWS) setField(_values[row], text, ""); }
+  size_t logRows() override { return LOG_ROWS; }
+  void setLogStatus(const char* text) override { setField(_logStatus, text, ""); }
+  void setLogRow(size_t row, const char* time, const char* event) override { if (row < LOG_ROWS) setField(_logRows[row], time, event); }
+  size_t diagRows() override { return DIAG_ROWS; }
+  void setDiagRow(size_t row, const char* label, const char* value) override { if (row < DIAG_ROWS) setField(_diagRows[row], label, value); }
+  void showPopup(const char* message) override { _popups++; (void)message; }
+  bool hidePopup() override { return true; }
+  UiButton pollButton() override;
+  void setVibration(uint8_t intensity) override { if (intensity) _vibrations++; }
+  bool awake() override { return _displayTimeoutMs == 0 || _clock.millis() - _lastSwitchMs < _displayTimeoutMs; }
+
+  uint32_t fieldPushes() const { return _fieldPushes; }
+  uint32_t fieldSets() const { return _fieldSets; }
+  uint32_t pageDraws() const { return _pageDraws; }
+  uint32_t popups() const { return _popups; }
+  uint32_t vibrations() const { return _vibrations; }
+
+private:
+  static constexpr size_t LOG_ROWS = 7;
+  static constexpr size_t DIAG_ROWS = 10;
+  static constexpr size_t TEXT = 84;
+  void setField(char* shown, const char* text, const char* col2);
+
+  Clock& _clock;
+  uint32_t _pageSwitchMs;
+  uint32_t _displayTimeoutMs;
+  uint32_t _lastSwitchMs = 0;     // Also the last activity
+  UiPage _page = UiPage::Main;
+  char _clockText[TEXT] = "";
+  char _values[VALUE_ROWS][TEXT] = {};
+  char _logStatus[TEXT] = "";
+  char _logRows[LOG_ROWS][TEXT] = {};
+  char _diagRows[DIAG_ROWS][TEXT] = {};
+  bool _diagNext = false;  // Main page: press "Diagnostics" next, not "View Log"
+  size_t _logStep = 0;     // Next press on the log page
+  uint32_t _fieldPushes = 0, _fieldSets = 0, _pageDraws = 0, _popups = 0, _vibrations = 0;
+};
+
+// The event log in RAM: the newest CAPACITY records, numbered like FlashEventLog's.
+// Counts what is read so the benchmark shows what the log page costs.
+class SimEventLog : public EventLog {
+public:
+  static constexpr uint32_t CAPACITY = 4096;
+
+  bool append(const EventRecord& record) override { _records[_end % CAPACITY] = record; _end++; return true; }
+  uint32_t first() override { return _end > CAPACITY ? _end - CAPACITY : 0; }
+  uint32_t end() override { return _end; }
+  size_t read(uint32_t seq, EventRecord* out, size_t count) override;
+  uint32_t seek(uint32_t epoch) override;
+
+  uint32_t reads() const { return _reads; }
+  uint32_t recordsRead() const { return _recordsRead; }
+  uint32_t seeks() const { return _seeks; }
+
+private:
+  EventRecord _records[CAPACITY];
+  uint32_t _end = 0;
+  uint32_t _reads = 0, _recordsRead = 0, _seeks = 0;
+};
+
+// Stands in for NetWorker + CommandChannel. Jobs complete after latencyMs (one at a
+// time, like the network task); service() serializes them with the real payload code,
+// which on the device happens on the network task, so its cost is reported apart
+// from loop(). Every cloudToggleMs the cloud state flips. The link comes up (LinkUp) connectMs after start.
+class SimLink : public UploadLink {
+public:
+  static constexpr size_t JOB_QUEUE_DEPTH = 2;
+  static constexpr size_t EVENT_QUEUE_DEPTH = 8;
+
+  struct Stats {
+    uint32_t uploads, failed, samples, motionUploads, perfUploads;
+    uint64_t bodyBytes, headerBytes;
+    uint32_t maxBodyBytes, maxHeaderBytes;
+    uint64_t serializeNs;          // buildBatch + generateM5DetailsHeader (JSON only)
+    uint64_t serializeAllocs;
+    uint32_t cloudEvents;
+    uint32_t firstUploadMs;        // Simulated time of the first successful upload (0: none)
+  };
+
+  SimLink(Clock& clock, const char* userId, uint32_t latencyMs, uint32_t cloudToggleMs, uint32_t failEvery,
+          PayloadFormat format = PayloadFormat::Json, uint32_t connectMs = 0)
+    : _clock(clock), _userId(userId), _latencyMs(latencyMs), _cloudToggleMs(cloudToggleMs), _failEvery(failEvery),
+      _format(format), _connectMs(connectMs) {}
+
+  bool submitUpload(const UploadJob& job) override;
+  bool pollEvent(NetEvent& event) override;
+  size_t spooledSamples() override { return 0; }
+  const char* errorString(int16_t httpCode) override { (void)httpCode; return "simulated failure"; }
+
+  // Runs the "network task" up to the current time. Call between loop() passes.
+  void service();
+  const Stats& stats() const { return _stats; }
+
+private:
+  bool postEvent(const NetEvent& event);
+
+  Clock& _clock;
+  const char* _userId;
+  uint32_t _latencyMs, _cloudToggleMs, _failEvery;
+  PayloadFormat _format;
+  uint32_t _connectMs;
+  bool _linkReported = false;
+  UploadJob _jobs[JOB_QUEUE_DEPTH];
+  size_t _jobHead = 0, _jobCount = 0;
+  uint32_t _busyUntilMs = 0;
+  bool _busy = false;
+  NetEvent _events[EVENT_QUEUE_DEPTH];
+  size_t _eventHead = 0, _eventCount = 0;
+  uint32_t _lastToggleMs = 0;
+  bool _cloudState = false;
+  bool _cloudReported = false;
+  char _body[UPLOAD_BODY_CAPACITY];
+  char _details[M5_DETAILS_CAPACITY];
+  Stats _stats = {};
+};
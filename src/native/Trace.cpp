@@ -0,0 +1,75 @@
+#include "Trace.h"
+#include <math.h>
+#include <stdio.h>
+
+namespace {
+  // xorshift32: same trace on every run and every machine
+  struct Rng {
+    uint32_t state = 0x12345678;
+    float uniform() { state ^= state << 13; state ^= state >> 17; state ^= state << 5; return (state >> 8) / 16777216.0f; }
+    float noise(float amplitude) { return (uniform() * 2.0f - 1.0f) * amplitude; }
+  };
+
+  const float PI_F = 3.14159265f;
+}
+
+bool Trace::load(const char* path) {
+  FILE* f = fopen(path, "r");
+  if (f == nullptr) return false;
+  _env.clear(); _imu.clear();
+  char line[160];
+  bool haveBase = false; uint32_t base = 0;
+  while (fgets(line, sizeof(line), f)) {
+    unsigned long t; unsigned prox, al, wl; float temp, rHum, ax, ay, az;
+    if (sscanf(line, "S,%lu,%u,%u,%u,%f,%f", &t, &prox, &al, &wl, &temp, &rHum) == 6) {
+      if (!haveBase) { base = t; haveBase = true; }
+      EnvRow row = { (uint32_t)(t - base), { (uint16_t)prox, (uint16_t)al, (uint16_t)wl, temp, rHum } };
+      _env.push_back(row);
+    } else if (sscanf(line, "I,%lu,%f,%f,%f", &t, &ax, &ay, &az) == 4) {
+      if (!haveBase) { base = t; haveBase = true; }
+      ImuSample s = { ax, ay, az, (uint32_t)(t - base) };
+      _imu.push_back(s);
+    }
+  }
+  fclose(f);
+
+  _durationMs = 0;
+  if (!_env.empty()) _durationMs = _env.back().tMs + 1;
+  if (_imu.size() > 1) {
+    uint32_t span = _imu.back().tMs - _imu.front().tMs;
+    _imuRateHz = span ? (uint16_t)lroundf((_imu.size() - 1) * 1000.0f / span) : 0;
+    if (_imu.back().tMs + 1 > _durationMs) _durationMs = _imu.back().tMs + 1;
+  }
+  return !_env.empty() || !_imu.empty();
+}
+
+void Trace::synthesize(uint32_t durationMs, uint16_t imuRateHz, uint32_t shakeEveryMs) {
+  Rng rng;
+  _env.clear(); _imu.clear();
+  _durationMs = durationMs; _imuRateHz = imuRateHz;
+
+  // Environment: one reading per 50 ms loop pass
+  for (uint32_t t = 0; t < durationMs; t += 50) {
+    float minutes = t / 60000.0f;
+    bool handNear = (t % 20000) < 1500;
+    SensorData d;
+    d.prox = (uint16_t)(handNear ? 900 + rng.noise(50) : 4 + rng.noise(2) + 2);
+    d.ambientLight = (uint16_t)(180 + 40 * sinf(2 * PI_F * minutes / 10) + rng.noise(3));
+    d.whiteLight = (uint16_t)(d.ambientLight * 1.6f + rng.noise(5));
+    d.temp = 22.5f + 0.4f * sinf(2 * PI_F * minutes / 30) + rng.noise(0.02f);
+    d.rHum = 45.0f + 2.0f * sinf(2 * PI_F * minutes / 45) + rng.noise(0.1f);
+    _env.push_back({ t, d });
+  }
+
+  // Accelerometer: at rest with sensor noise; an 8 Hz, 1.2 s shake every shakeEveryMs and
+  // a 15 ms knock halfway between shakes
+  _imu.reserve((size_t)durationMs * imuRateHz / 1000 + 1);
+  for (uint32_t i = 0; (uint64_t)i * 1000 / imuRateHz < durationMs; ++i) {
+    uint32_t t = (uint32_t)((uint64_t)i * 1000 / imuRateHz);
+    float ax = rng.noise(0.01f), ay = 0.02f + rng.noise(0.01f), az = 0.99f + rng.noise(0.01f);
+    uint32_t phase = t % shakeEveryMs;
+    if (phase < 1200) { float s = phase / 1000.0f; ax += 1.5f * sinf(2 * PI_F * 8 * s); ay += 0.6f * sinf(2 * PI_F * 8 * s + 1.0f); }
+    else if (phase >= shakeEveryMs / 2 && phase < shakeEveryMs / 2 + 15) { az += 3.0f; ax += 1.0f; }
+    _imu.push_back({ ax, ay, az, t });
+  }
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include "SensorData.h"
+
+// Sensor recording replayed by the simulated Hal. Text format, one reading per line
+// (what a -DTRACE_RECORD firmware prints; other lines are ignored):
+//   S,<ms>,<prox>,<ambient>,<white>,<tempC>,<rHum>
+//   I,<ms>,<ax>,<ay>,<az>          accelerometer, g
+// Timestamps are rebased to start at 0 and the trace loops when the simulation is
+// longer than the recording. Without a file a deterministic synthetic trace is used:
+// quiet desk readings with a shake every shakeEveryMs and a knock in between.
+struct EnvRow {
+  uint32_t tMs;
+  SensorData data;
+};
+
+class Trace {
+public:
+  bool load(const char* path);
+  void synthesize(uint32_t durationMs, uint16_t imuRateHz, uint32_t shakeEveryMs);
+
+  const std::vector<EnvRow>& env() const { return _env; }
+  const std::vector<ImuSample>& imu() const { return _imu; }
+  uint32_t durationMs() const { return _durationMs; }
+  uint16_t imuRateHz() const { return _imuRateHz; }
+
+private:
+  std::vector<EnvRow> _env;
+  std::vector<ImuSample> _imu;
+  uint32_t _durationMs = 0;
+  uint16_t _imuRateHz = 0;
+};
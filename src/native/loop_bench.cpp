@@ -0,0 +1,308 @@
+// Host benchmark for the firmware logic (pio run -e native && .pio/build/native/program).
+// Runs App::loop() against the simulated Hal in virtual time and reports:
+//   - loop() latency percentiles (host CPU time; compare runs, not absolute numbers)
+//   - wakeups and sleep between passes: by default the clock jumps to App::msUntilDue() like the
+//     device's power-saving loop does, --fixed-step runs every --loop-ms instead (the old delay());
+//     --page-switch-s 0 leaves the display to time out so the idle behaviour shows
+//   - heap allocations per loop() pass
+//   - bytes serialized per upload and the network-side serialization cost
+//   - bytes per window and encode cost of each body encoding (JSON + M5-Details, MessagePack,
+//     packed delta/varint) and the packed decoder, with a round-trip check
+// Exits with status 3 if serializing an upload allocated (the upload path must not touch the heap),
+// 4 if a packed batch does not decode to what was encoded.
+//
+//   program [--trace FILE] [--seconds N] [--loop-ms N] [--fixed-step] [--display-timeout-s N] [--latency-ms N]
+//           [--connect-ms N] [--time-after-ms N] [--cloud-toggle-s N] [--fail-every N] [--page-switch-s N] [--format json|msgpack|packed] [--reps N] [--verbose]
+
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "App.h"
+#include "UploadPayload.h"
+#include "PackedPayload.h"
+#include "AllocCounter.h"
+#include "SimHal.h"
+#include "Trace.h"
+
+namespace {
+  bool verbose = false;
+
+  struct Options {
+    const char* tracePath = nullptr;
+    uint32_t seconds = 600;
+    uint32_t loopMs = 50;          // Pass period with --fixed-step (main.cpp without power saving)
+    bool fixedStep = false;
+    uint32_t maxSleepMs = 1000;    // PowerConfig::maxSleepMs
+    uint32_t displayTimeoutS = 60;
+    uint32_t latencyMs = 400;      // Simulated upload round-trip
+    uint32_t connectMs = 300;      // Boot -> WiFi up (cached association)
+    uint32_t timeAfterMs = 0;      // Boot -> wall clock known (0: RTC-backed, right away)
+    uint32_t cloudToggleS = 45;
+    uint32_t failEvery = 0;        // Fail every Nth upload (0: never)
+    uint32_t pageSwitchS = 30;
+    uint32_t reps = 2000;          // Repetitions per payload micro-benchmark
+    PayloadFormat format = PayloadFormat::Json; // Upload body encoding in the loop() run
+  };
+
+  bool parseOptions(int argc, char** argv, Options& o) {
+    for (int i = 1; i < argc; ++i) {
+      const char* a = argv[i];
+      bool hasValue = i + 1 < argc;
+      if (strcmp(a, "--verbose") == 0) verbose = true;
+      else if (strcmp(a, "--trace") == 0 && hasValue) o.tracePath = argv[++i];
+      else if (strcmp(a, "--seconds") == 0 && hasValue) o.seconds = atoi(argv[++i]);
+      else if (strcmp(a, "--loop-ms") == 0 && hasValue) o.loopMs = atoi(argv[++i]);
+      else if (strcmp(a, "--fixed-step") == 0) o.fixedStep = true;
+      else if (strcmp(a, "--display-timeout-s") == 0 && hasValue) o.displayTimeoutS = atoi(argv[++i]);
+      else if (strcmp(a, "--latency-ms") == 0 && hasValue) o.latencyMs = atoi(argv[++i]);
+      else if (strcmp(a, "--connect-ms") == 0 && hasValue) o.connectMs = atoi(argv[++i]);
+      else if (strcmp(a, "--time-after-ms") == 0 && hasValue) o.timeAfterMs = atoi(argv[++i]);
+      else if (strcmp(a, "--cloud-toggle-s") == 0 && hasValue) o.cloudToggleS = atoi(argv[++i]);
+      else if (strcmp(a, "--fail-every") == 0 && hasValue) o.failEvery = atoi(argv[++i]);
+      else if (strcmp(a, "--page-switch-s") == 0 && hasValue) o.pageSwitchS = atoi(argv[++i]);
+      else if (strcmp(a, "--reps") == 0 && hasValue) o.reps = atoi(argv[++i]);
+      else if (strcmp(a, "--format") == 0 && hasValue) {
+        const char* f = argv[++i];
+        if (strcmp(f, "msgpack") == 0) o.format = PayloadFormat::MsgPack;
+        else if (strcmp(f, "packed") == 0) o.format = PayloadFormat::Packed;
+        else if (strcmp(f, "json") != 0) { fprintf(stderr, "Unknown format: %s\n", f); return false; }
+      }
+      else { fprintf(stderr, "Unknown option: %s\n", a); return false; }
+    }
+    return o.loopMs > 0 && o.reps > 0;
+  }
+
+  // Same settings as main.cpp
+  AppConfig firmwareConfig() {
+    AppConfig c = {};
+    c.userId = "user_1";
+    c.aggregation = { 10000, 300000, { 5.0f, 10.0f, 20.0f, 0.2f, 1.0f } };
+    c.flushPolicy = { 15, 60000, 900000 };
+    c.flushRetryIntervalMs = 5000;
+    c.motion = { 200.0f, 0.6f, 2.5f, 200, 300, 5000, 2000 };
+    c.vibrationIntensity = 200; c.vibrationMs = 300;
+    c.popupMs = 1500;
+    c.perfWindowMs = 60000;
+    return c;
+  }
+
+  double percentile(std::vector<uint32_t>& sorted, double p) {
+    if (sorted.empty()) return 0;
+    size_t rank = (size_t)(p / 100.0 * (sorted.size() - 1) + 0.5);
+    return sorted[rank];
+  }
+
+  uint64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  // Best of 5 rounds of `reps` calls: ns/call and allocations/call
+  template <typename F>
+  void microBench(const char* name, uint32_t reps, size_t bytes, F call) {
+    double bestNs = 1e30; uint64_t allocs = 0;
+    for (int round = 0; round < 5; ++round) {
+      uint64_t a0 = AllocCounter::count(), t0 = nowNs();
+      for (uint32_t i = 0; i < reps; ++i) call();
+      double ns = (double)(nowNs() - t0) / reps;
+      allocs = AllocCounter::count() - a0;
+      if (ns < bestNs) bestNs = ns;
+    }
+    printf("  %-34s %9.0f ns/call  %5.2f allocs/call  %5zu bytes\n", name, bestNs, (double)allocs / reps, bytes);
+  }
+}
+
+void logPrintf(const char* format, ...) {
+  char buffer[192]; // Formatted like on the device, printed only with --verbose
+  va_list args; va_start(args, format); vsnprintf(buffer, sizeof(buffer), format, args); va_end(args);
+  if (verbose) fputs(buffer, stdout);
+}
+
+int main(int argc, char** argv) {
+  Options opt;
+  if (!parseOptions(argc, argv, opt)) return 2;
+
+  Trace trace;
+  if (opt.tracePath) {
+    if (!trace.load(opt.tracePath)) { fprintf(stderr, "Cannot read trace %s\n", opt.tracePath); return 1; }
+  } else {
+    trace.synthesize(10 * 60 * 1000, 200, 60000);
+  }
+
+  // --- loop() in virtual time ---
+  AppConfig config = firmwareConfig();
+  SimClock clock(opt.timeAfterMs);
+  // Same channels and periods as main.cpp
+  SensorHub sensors(clock);
+  TraceChannel proximity("prox", trace, clock, TraceChannel::PROX, 0);
+  TraceChannel light("light", trace, clock, TraceChannel::LIGHT, 0);
+  TraceChannel climate("sht4x", trace, clock, TraceChannel::CLIMATE, 9);
+  sensors.add(proximity, 50, 800); sensors.add(light, 200, 2000); sensors.add(climate, 2000, 10000);
+  sensors.setDeadbands(config.aggregation.deadband);
+  TraceImu imu(trace, clock);
+  SimUi ui(clock, opt.pageSwitchS * 1000, opt.displayTimeoutS * 1000);
+  SimLink link(clock, config.userId, opt.latencyMs, opt.cloudToggleS * 1000, opt.failEvery, opt.format, opt.connectMs);
+  SimSystem system;
+  SimEventLog* events = new SimEventLog();
+  App* app = new App(); // Large (sample buffer, upload job): keep it off the stack
+  app->begin(config, { &clock, &sensors, &imu, &ui, &link, &system, events });
+
+  std::vector<uint32_t> latencyNs;
+  std::vector<uint32_t> allocs;
+  uint64_t allocBytes = 0;
+  uint32_t endMs = clock.millis() + opt.seconds * 1000;
+  uint64_t sleptMs[2] = {}; uint32_t passes[2] = {}; // Display off, on
+  while ((int32_t)(clock.millis() - endMs) < 0) {
+    uint32_t step = opt.loopMs;
+    if (!opt.fixedStep) step = std::min(std::max(app->msUntilDue(), (uint32_t)1), opt.maxSleepMs);
+    bool awake = ui.awake();
+    sleptMs[awake] += step; passes[awake]++;
+    clock.advance(step);
+    link.service();
+    uint64_t a0 = AllocCounter::count(), b0 = AllocCounter::bytes(), t0 = nowNs();
+    app->loop();
+    latencyNs.push_back((uint32_t)(nowNs() - t0));
+    allocs.push_back((uint32_t)(AllocCounter::count() - a0));
+    allocBytes += AllocCounter::bytes() - b0;
+  }
+  size_t iterations = latencyNs.size();
+
+  std::vector<uint32_t> sorted(latencyNs);
+  std::sort(sorted.begin(), sorted.end());
+  uint64_t allocTotal = 0; uint32_t allocMax = 0; size_t allocIters = 0;
+  for (uint32_t a : allocs) { allocTotal += a; allocMax = std::max(allocMax, a); if (a) allocIters++; }
+  const SimLink::Stats& ls = link.stats();
+
+  printf("Trace: %s, %zu env rows, %zu IMU samples at %u Hz, %.0f s (looped)\n", opt.tracePath ? opt.tracePath : "synthetic",
+         trace.env().size(), trace.imu().size(), (unsigned)trace.imuRateHz(), trace.durationMs() / 1000.0);
+  printf("\nloop(): %zu passes, %u s simulated, %s\n", iterations, (unsigned)opt.seconds, opt.fixedStep ? "fixed step" : "sleeping until due");
+  for (int awake = 1; awake >= 0; --awake) {
+    if (passes[awake] == 0) continue;
+    printf("  display %-9s %u passes over %.0f s: %.2f wakeups/s, avg sleep %.1f ms\n", awake ? "on" : "off", (unsigned)passes[awake],
+           sleptMs[awake] / 1000.0, passes[awake] * 1000.0 / sleptMs[awake], (double)sleptMs[awake] / passes[awake]);
+  }
+  printf("  latency us        p50 %.2f  p90 %.2f  p99 %.2f  p99.9 %.2f  max %.2f\n", percentile(sorted, 50) / 1000,
+         percentile(sorted, 90) / 1000, percentile(sorted, 99) / 1000, percentile(sorted, 99.9) / 1000, sorted.back() / 1000.0);
+  printf("  allocs/pass       avg %.3f  max %u  (%zu passes allocated, %.1f bytes/pass)\n", (double)allocTotal / iterations,
+         (unsigned)allocMax, allocIters, (double)allocBytes / iterations);
+  printf("  ui                %u field sets, %u pushes, %u page draws, %u popups, %u vibrations\n", (unsigned)ui.fieldSets(),
+         (unsigned)ui.fieldPushes(), (unsigned)ui.pageDraws(), (unsigned)ui.popups(), (unsigned)ui.vibrations());
+  printf("  event log         %u records, %u page reads (%.1f records each), %u seeks\n", (unsigned)events->end(),
+         (unsigned)events->reads(), events->reads() ? (double)events->recordsRead() / events->reads() : 0.0, (unsigned)events->seeks());
+  printf("  samples           %u buffered now, %u dropped, %u IMU samples analyzed\n", (unsigned)app->bufferedSamples(),
+         (unsigned)app->droppedSamples(), (unsigned)imu.samples());
+  const WindowAggregator& windows = app->aggregator();
+  printf("  windows           %u closed, %u buffered for upload (%.0f%%), channels sent:", (unsigned)windows.windows(),
+         (unsigned)windows.sentWindows(), windows.windows() ? 100.0 * windows.sentWindows() / windows.windows() : 0.0);
+  for (size_t i = 0; i < ENV_CHANNELS; ++i) printf(" %s %u", envChannelName((EnvChannel)i), (unsigned)windows.channelsSent((EnvChannel)i));
+  printf("\n");
+  printf("  sensor reads     ");
+  for (size_t i = 0; i < sensors.channelCount(); ++i) {
+    printf(" %s %u (%u errors, now every %u ms)", sensors.channelName(i), (unsigned)sensors.channelStats(i).reads,
+           (unsigned)sensors.channelStats(i).errors, (unsigned)sensors.channelPeriod(i));
+  }
+  printf("\n");
+
+  const PerfSummary& perf = app->profiler().lastSummary();
+  if (perf.seq) {
+    printf("  stages us (profiler window %lu, %lu passes):", (unsigned long)perf.seq, (unsigned long)perf.passes);
+    for (size_t i = 0; i < LOOP_STAGES; ++i) {
+      if (perf.stages[i].maxUs) printf(" %s %lu/%lu", loopStageName((LoopStage)i), (unsigned long)perf.stages[i].p99Us, (unsigned long)perf.stages[i].maxUs);
+    }
+    printf("  (p99/max)\n");
+  }
+
+  printf("\nuploads (network side): %u (%u failed, %u with motion summary, %u with perf summary), %u samples, %u cloud events\n",
+         (unsigned)ls.uploads, (unsigned)ls.failed, (unsigned)ls.motionUploads, (unsigned)ls.perfUploads, (unsigned)ls.samples,
+         (unsigned)ls.cloudEvents);
+  if (ls.firstUploadMs) printf("  first upload      %u ms after boot (link up at %u ms)\n", (unsigned)ls.firstUploadMs, (unsigned)opt.connectMs);
+  if (ls.uploads) {
+    printf("  body bytes        avg %.0f  max %u  (%.1f per sample)\n", (double)ls.bodyBytes / ls.uploads, (unsigned)ls.maxBodyBytes,
+           ls.samples ? (double)ls.bodyBytes / ls.samples : 0.0);
+    printf("  M5-Details bytes  avg %.0f  max %u\n", (double)ls.headerBytes / ls.uploads, (unsigned)ls.maxHeaderBytes);
+    printf("  serialize         %.1f us/upload, %.2f allocs/upload\n", ls.serializeNs / 1000.0 / ls.uploads,
+           (double)ls.serializeAllocs / ls.uploads);
+  }
+
+  // --- Payload encodings ---
+  // Full windows of 200 trace readings each, every channel reported
+  WindowSample batch[MAX_BATCH_SAMPLES];
+  for (size_t i = 0; i < MAX_BATCH_SAMPLES; ++i) {
+    WindowAggregator windows;
+    windows.begin(config.aggregation, 0);
+    for (size_t r = 0; r < 200; ++r) windows.add(trace.env()[(i * 200 + r) % trace.env().size()].data, (1 << ENV_CHANNELS) - 1);
+    windows.close(config.aggregation.windowMs, true, batch[i]);
+    batch[i].epoch = SimClock::START_EPOCH + (uint32_t)i * 10; batch[i].epochMs = (uint16_t)(i * 37 % 1000);
+  }
+  size_t batchWindows = config.flushPolicy.maxSamples;
+  MotionEvent motion = { MotionKind::Shake, 1000, 1180, 236, 1.07f, 2.41f, 96.0f, 9.4f };
+  static char body[UPLOAD_BODY_CAPACITY];
+  static char details[M5_DETAILS_CAPACITY];
+  size_t headerLen = generateM5DetailsHeader(details, sizeof(details), batch[batchWindows - 1], config.userId, "regular");
+  size_t motionHeaderLen = generateM5DetailsHeader(details, sizeof(details), batch[batchWindows - 1], config.userId, "shake", &motion);
+
+  printf("\npayload encodings, %zu windows per batch (best of 5 x %u):\n", batchWindows, (unsigned)opt.reps);
+  const PayloadFormat formats[] = { PayloadFormat::Json, PayloadFormat::MsgPack, PayloadFormat::Packed };
+  for (PayloadFormat format : formats) {
+    size_t len = buildBatch(format, body, sizeof(body), config.userId, "regular", batch, batchWindows);
+    size_t header = format == PayloadFormat::Json ? headerLen : 0; // Sent alongside the JSON body only
+    printf("  %-8s body %5zu B + M5-Details %3zu B = %6.1f B/window\n", payloadFormatName(format), len, header,
+           (double)(len + header) / batchWindows);
+  }
+  for (PayloadFormat format : formats) {
+    char name[48];
+    snprintf(name, sizeof(name), "buildBatch(%s)", payloadFormatName(format));
+    microBench(name, opt.reps, buildBatch(format, body, sizeof(body), config.userId, "regular", batch, batchWindows), [&] {
+      buildBatch(format, body, sizeof(body), config.userId, "regular", batch, batchWindows);
+    });
+  }
+  microBench("buildBatchBody(motion)", opt.reps, buildBatchBody(body, sizeof(body), config.userId, "shake", batch, batchWindows, &motion), [&] {
+    buildBatchBody(body, sizeof(body), config.userId, "shake", batch, batchWindows, &motion);
+  });
+  microBench("buildBatchBody(1 window)", opt.reps, buildBatchBody(body, sizeof(body), config.userId, "regular", batch, 1), [&] {
+    buildBatchBody(body, sizeof(body), config.userId, "regular", batch, 1);
+  });
+  microBench("generateM5DetailsHeader", opt.reps, headerLen, [&] {
+    generateM5DetailsHeader(details, sizeof(details), batch[batchWindows - 1], config.userId, "regular");
+  });
+  microBench("generateM5DetailsHeader(motion)", opt.reps, motionHeaderLen, [&] {
+    generateM5DetailsHeader(details, sizeof(details), batch[batchWindows - 1], config.userId, "shake", &motion);
+  });
+
+  // Packed round trip: everything must come back within the hundredths it is sent in
+  size_t packedLen = buildBatchPacked((uint8_t*)body, sizeof(body), config.userId, "shake", batch, batchWindows, &motion, &perf);
+  static PackedBatch decoded;
+  microBench("decodeBatchPacked(motion, perf)", opt.reps, packedLen, [&] {
+    decodeBatchPacked((const uint8_t*)body, packedLen, decoded);
+  });
+  bool roundTrip = packedLen > 0 && decodeBatchPacked((const uint8_t*)body, packedLen, decoded) && decoded.count == batchWindows &&
+                   strcmp(decoded.userId, config.userId) == 0 && decoded.hasMotion && decoded.motion.samples == motion.samples &&
+                   decoded.hasPerf && decoded.perf.seq == perf.seq && decoded.perf.rssi == perf.rssi;
+  for (size_t i = 0; roundTrip && i < batchWindows; ++i) {
+    const WindowSample& a = batch[i];
+    const WindowSample& b = decoded.samples[i];
+    roundTrip = a.epoch == b.epoch && a.epochMs == b.epochMs && a.durationMs == b.durationMs && a.count == b.count && a.reported == b.reported;
+    for (size_t ch = 0; roundTrip && ch < ENV_CHANNELS; ++ch) {
+      const float* x = &a.stats[ch].min;
+      const float* y = &b.stats[ch].min;
+      for (int k = 0; k < 4; ++k) roundTrip = roundTrip && fabsf(x[k] - y[k]) <= 0.0051f;
+    }
+  }
+
+  delete app; delete events;
+
+  // The upload path must not allocate (see AllocCounter.h): fail the run so a regression is noticed
+  if (ls.serializeAllocs != 0) {
+    printf("\nFAIL: %llu heap allocations while serializing %u uploads\n", (unsigned long long)ls.serializeAllocs, (unsigned)ls.uploads);
+    return 3;
+  }
+  if (!roundTrip) {
+    printf("\nFAIL: packed batch did not decode to the encoded windows\n");
+    return 4;
+  }
+  return 0;
+}
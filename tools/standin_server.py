@@ -0,0 +1,362 @@
+#!/usr/bin/env python3
+"""Local stand-in for the upload and get-device-state Cloud Run services.
+
+Lets the firmware (built with -DLOCAL_BACKEND='"http://<host>:8080"') be tested
+without the cloud:
+
+  POST /upload              batch body: JSON, MessagePack (application/msgpack) or packed
+                            (application/x-m5-packed, see include/PackedPayload.h); 415 for
+                            anything else. M5-Details header also accepted on GET
+  GET  /state?userId=u      {"fanState": bool} with an ETag; If-None-Match -> 304
+       &wait=N              long-poll: hold until the state changes or N seconds pass
+       &stream=1 / Accept: text/event-stream
+                            server-sent events, one "data:" line per change
+  POST /state?userId=u&fanState=true|false
+                            set the state (wakes long-polls and streams)
+
+Flags emulate the current production service (--no-etag --no-longpoll --no-sse --json-only)
+or a slow server (--delay-ms). Only the standard library is used.
+
+  python3 tools/standin_server.py --port 8080 --toggle-every 30
+
+Also the backend for the virtual device fleet (pio run -e fleet, see src/fleet/fleet_bench.cpp).
+"""
+
+import argparse
+import asyncio
+import json
+import struct
+import time
+from urllib.parse import parse_qs, urlsplit
+
+SSE_PING_S = 15
+STAGES = ["board", "touch", "net", "imu", "sensors", "screen", "upload", "idle"]  # LoopStage order
+CHANNELS = ["prox", "al", "wl", "temp", "rHum"]  # EnvChannel order
+MOTION_KINDS = ["none", "shake", "impact"]
+
+
+# --- Binary upload bodies, decoded into the JSON document layout ---
+class Cursor:
+    def __init__(self, data):
+        self.data, self.pos = data, 0
+
+    def take(self, n):
+        if self.pos + n > len(self.data):
+            raise ValueError("truncated")
+        chunk = self.data[self.pos:self.pos + n]
+        self.pos += n
+        return chunk
+
+    def byte(self):
+        return self.take(1)[0]
+
+    def varint(self):
+        value, shift = 0, 0
+        while True:
+            b = self.byte()
+            value |= (b & 0x7F) << shift
+            if not b & 0x80:
+                return value
+            shift += 7
+            if shift > 28:
+                raise ValueError("varint too long")
+
+    def svarint(self):
+        v = self.varint()
+        return (v >> 1) ^ -(v & 1)
+
+    def str(self):
+        return self.take(self.varint()).decode()
+
+
+def decode_packed(data):
+    c = Cursor(data)
+    if c.take(3) != b"M5\x02":
+        raise ValueError("not a packed batch")
+    flags = c.byte()
+    doc = {"userId": c.str(), "triggerEvent": c.str(), "samples": []}
+    means, epoch = [0] * len(CHANNELS), 0
+    for i in range(c.varint()):
+        epoch = c.varint() if i == 0 else epoch + c.svarint()
+        sample = {"t": epoch, "ms": c.varint(), "dur": c.varint(), "n": c.varint()}
+        reported = c.byte()
+        for ch, name in enumerate(CHANNELS):
+            if reported & (1 << ch):
+                means[ch] += c.svarint()
+                below, above, sd = c.varint(), c.varint(), c.varint()
+                mean = means[ch]
+                sample[name] = [mean / 100, (mean - below) / 100, (mean + above) / 100, sd / 100]
+        doc["samples"].append(sample)
+    if flags & 1:
+        kind = c.byte()
+        doc["motion"] = {"kind": MOTION_KINDS[kind] if kind < len(MOTION_KINDS) else "?", "durMs": c.varint(),
+                         "n": c.varint(), "rms": c.varint() / 100, "peak": c.varint() / 100, "jerk": c.varint(),
+                         "freq": c.varint() / 100}
+    if flags & 2:
+        perf = {"seq": c.varint(), "winMs": c.varint(), "n": c.varint()}
+        perf["us"] = {name: [c.varint(), c.varint(), c.varint()] for name in STAGES}
+        perf["http"] = [c.varint() for _ in range(6)]
+        perf["heap"] = [c.varint() for _ in range(3)]
+        perf["rssi"] = c.svarint()
+        doc["perf"] = perf
+    if c.pos != len(data):
+        raise ValueError("trailing bytes")
+    return doc
+
+
+def decode_msgpack(data):
+    """The subset ArduinoJson's serializeMsgPack() writes."""
+    c = Cursor(data)
+
+    def value():
+        t = c.byte()
+        if t <= 0x7F:
+            return t
+        if t >= 0xE0:
+            return t - 0x100
+        if 0x80 <= t <= 0x8F:
+            return {value(): value() for _ in range(t & 0x0F)}
+        if 0x90 <= t <= 0x9F:
+            return [value() for _ in range(t & 0x0F)]
+        if 0xA0 <= t <= 0xBF:
+            return c.take(t & 0x1F).decode()
+        fixed = {0xC0: None, 0xC2: False, 0xC3: True}
+        if t in fixed:
+            return fixed[t]
+        scalars = {0xCA: ">f", 0xCB: ">d", 0xCC: ">B", 0xCD: ">H", 0xCE: ">I", 0xCF: ">Q",
+                   0xD0: ">b", 0xD1: ">h", 0xD2: ">i", 0xD3: ">q"}
+        if t in scalars:
+            fmt = scalars[t]
+            return struct.unpack(fmt, c.take(struct.calcsize(fmt)))[0]
+        lengths = {0xD9: ">B", 0xDA: ">H", 0xDB: ">I", 0xDC: ">H", 0xDD: ">I", 0xDE: ">H", 0xDF: ">I"}
+        if t in lengths:
+            fmt = lengths[t]
+            n = struct.unpack(fmt, c.take(struct.calcsize(fmt)))[0]
+            if t <= 0xDB:
+                return c.take(n).decode()
+            if t <= 0xDD:
+                return [value() for _ in range(n)]
+            return {value(): value() for _ in range(n)}
+        raise ValueError("unsupported msgpack type 0x%02x" % t)
+
+    doc = value()
+    if c.pos != len(data):
+        raise ValueError("trailing bytes")
+    return doc
+
+
+BODY_DECODERS = {"application/json": lambda body: json.loads(body),
+                 "application/msgpack": decode_msgpack,
+                 "application/x-m5-packed": decode_packed}
+
+
+class DeviceState:
+    def __init__(self):
+        self.fan_state = False
+        self.version = 1
+        self.changed = asyncio.Condition()
+
+    @property
+    def etag(self):
+        return '"v%d"' % self.version
+
+    def body(self):
+        return json.dumps({"fanState": self.fan_state, "version": self.version}).encode()
+
+    async def set(self, value):
+        async with self.changed:
+            if value != self.fan_state:
+                self.fan_state = value
+                self.version += 1
+                self.changed.notify_all()
+
+
+class StandinServer:
+    def __init__(self, args):
+        self.args = args
+        self.devices = {}
+        self.stats = {"uploads": 0, "samples": 0, "values": 0, "upload_bytes": 0, "binary_uploads": 0, "rejected_415": 0, "state_200": 0, "state_304": 0,
+                      "long_polls": 0, "streams": 0, "perf": 0}
+
+    def device(self, user_id):
+        if user_id not in self.devices:
+            self.devices[user_id] = DeviceState()
+        return self.devices[user_id]
+
+    # --- HTTP plumbing ---
+    async def handle(self, reader, writer):
+        try:
+            while True:  # Keep-alive: serve requests until the client closes
+                request_line = await reader.readline()
+                if not request_line:
+                    break
+                method, target, _ = request_line.decode("latin-1").split(" ", 2)
+                headers = {}
+                while True:
+                    line = await reader.readline()
+                    if line in (b"\r\n", b"\n", b""):
+                        break
+                    name, _, value = line.decode("latin-1").partition(":")
+                    headers[name.strip().lower()] = value.strip()
+                body = b""
+                if "content-length" in headers:
+                    body = await reader.readexactly(int(headers["content-length"]))
+                if self.args.delay_ms:
+                    await asyncio.sleep(self.args.delay_ms / 1000)
+                keep_open = await self.route(method, target, headers, body, writer)
+                if not keep_open or headers.get("connection", "").lower() == "close":
+                    break
+        except (ConnectionError, asyncio.IncompleteReadError, ValueError):
+            pass
+        finally:
+            writer.close()
+
+    def respond(self, writer, status, body=b"", headers=None):
+        reason = {200: "OK", 304: "Not Modified", 400: "Bad Request", 404: "Not Found",
+                  415: "Unsupported Media Type"}.get(status, "")
+        lines = ["HTTP/1.1 %d %s" % (status, reason), "Content-Length: %d" % len(body), "Connection: keep-alive"]
+        if body:
+            lines.append("Content-Type: application/json")
+        for name, value in (headers or {}).items():
+            lines.append("%s: %s" % (name, value))
+        writer.write(("\r\n".join(lines) + "\r\n\r\n").encode("latin-1") + body)
+
+    async def route(self, method, target, headers, body, writer):
+        url = urlsplit(target)
+        query = {k: v[-1] for k, v in parse_qs(url.query).items()}
+        path = url.path.rstrip("/") or "/"
+        if path == "/upload":
+            status = self.record_upload(headers, body)
+            self.respond(writer, status, b'{"ok":true}' if status == 200 else b"")
+        elif path == "/state" and method == "POST":
+            await self.device(query.get("userId", "user_1")).set(query.get("fanState", "false") == "true")
+            self.respond(writer, 200, b'{"ok":true}')
+        elif path == "/state":
+            return await self.get_state(query, headers, writer)
+        else:
+            self.respond(writer, 404)
+        await writer.drain()
+        return True
+
+    # --- Endpoints ---
+    def record_upload(self, headers, body):
+        """Returns the HTTP status: 415 tells the device to fall back to JSON."""
+        content_type = headers.get("content-type", "application/json").split(";")[0].strip().lower()
+        decoder = BODY_DECODERS.get(content_type)
+        if body and (decoder is None or (self.args.json_only and content_type != "application/json")):
+            self.stats["rejected_415"] += 1
+            return 415
+        self.stats["uploads"] += 1
+        self.stats["upload_bytes"] += len(body) + len(headers.get("m5-details", ""))
+        if body:
+            try:
+                doc = decoder(body)
+            except (ValueError, UnicodeDecodeError, struct.error):
+                return 400
+            if content_type != "application/json":
+                self.stats["binary_uploads"] += 1
+            samples = doc.get("samples", [])
+            self.stats["samples"] += len(samples)
+            # Channels outside their deadband, each [mean, min, max, sd] over the sample's window
+            self.stats["values"] += sum(1 for s in samples for v in s.values() if isinstance(v, list))
+            if "perf" in doc:
+                self.record_perf(doc.get("userId", "?"), doc["perf"])
+        elif "m5-details" in headers:
+            self.stats["samples"] += 1
+        return 200
+
+    def record_perf(self, user_id, perf):
+        """One loop profiling window from a device: print its p99s so regressions show up in the log."""
+        self.stats["perf"] += 1
+        stages = " ".join("%s=%s" % (name, v[1]) for name, v in perf.get("us", {}).items() if v[2])
+        http, heap = perf.get("http", []), perf.get("heap", [])
+        print("[%s] %s perf #%s p99us %s http=%s heap=%s rssi=%s" % (time.strftime("%H:%M:%S"), user_id, perf.get("seq"),
+                                                                    stages, http, heap, perf.get("rssi")))
+
+    async def get_state(self, query, headers, writer):
+        dev = self.device(query.get("userId", "user_1"))
+        wants_stream = query.get("stream") == "1" or "text/event-stream" in headers.get("accept", "")
+        if wants_stream and not self.args.no_sse:
+            await self.stream_state(dev, writer)
+            return False
+
+        if_none_match = headers.get("if-none-match") if not self.args.no_etag else None
+        wait = 0 if self.args.no_longpoll else min(float(query.get("wait", 0)), 60)
+        if if_none_match == dev.etag and wait > 0:
+            self.stats["long_polls"] += 1
+            async with dev.changed:
+                try:
+                    await asyncio.wait_for(dev.changed.wait_for(lambda: dev.etag != if_none_match), wait)
+                except asyncio.TimeoutError:
+                    pass
+        extra = {} if self.args.no_etag else {"ETag": dev.etag}
+        if if_none_match == dev.etag:
+            self.stats["state_304"] += 1
+            self.respond(writer, 304, headers=extra)
+        else:
+            self.stats["state_200"] += 1
+            self.respond(writer, 200, dev.body(), extra)
+        await writer.drain()
+        return True
+
+    async def stream_state(self, dev, writer):
+        self.stats["streams"] += 1
+        writer.write(b"HTTP/1.1 200 OK\r\nContent-Type: text/event-stream\r\nCache-Control: no-cache\r\n"
+                     b"Connection: close\r\n\r\n")
+        sent_version = 0
+        while True:
+            if dev.version != sent_version:
+                sent_version = dev.version
+                writer.write(("id: %s\ndata: %s\n\n" % (dev.etag, dev.body().decode())).encode())
+            else:
+                writer.write(b": ping\n\n")
+            await writer.drain()
+            async with dev.changed:
+                try:
+                    await asyncio.wait_for(dev.changed.wait_for(lambda: dev.version != sent_version), SSE_PING_S)
+                except asyncio.TimeoutError:
+                    pass
+
+    # --- Background helpers ---
+    async def toggler(self):
+        while True:
+            await asyncio.sleep(self.args.toggle_every)
+            for user_id in list(self.devices) or ["user_1"]:
+                dev = self.device(user_id)
+                await dev.set(not dev.fan_state)
+            print("[%s] toggled fanState for %d device(s)" % (time.strftime("%H:%M:%S"), max(1, len(self.devices))))
+
+    async def reporter(self):
+        while True:
+            await asyncio.sleep(self.args.stats_every)
+            print("[%s] %s" % (time.strftime("%H:%M:%S"), " ".join("%s=%d" % kv for kv in self.stats.items())))
+
+
+async def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    parser.add_argument("--host", default="0.0.0.0")
+    parser.add_argument("--port", type=int, default=8080)
+    parser.add_argument("--toggle-every", type=float, default=0, help="flip every device's fanState every N seconds")
+    parser.add_argument("--delay-ms", type=int, default=0, help="delay every response (slow server)")
+    parser.add_argument("--no-etag", action="store_true", help="no ETag/304 support")
+    parser.add_argument("--no-longpoll", action="store_true", help="ignore &wait=N")
+    parser.add_argument("--no-sse", action="store_true", help="answer stream requests with plain JSON")
+    parser.add_argument("--json-only", action="store_true", help="answer binary upload bodies with 415")
+    parser.add_argument("--stats-every", type=float, default=10)
+    args = parser.parse_args()
+
+    standin = StandinServer(args)
+    server = await asyncio.start_server(standin.handle, args.host, args.port, limit=1 << 16, backlog=4096)
+    print("Stand-in backend on http://%s:%d" % (args.host, args.port))
+    tasks = [asyncio.create_task(standin.reporter())]
+    if args.toggle_every > 0:
+        tasks.append(asyncio.create_task(standin.toggler()))
+    async with server:
+        await server.serve_forever()
+
+
+if __name__ == "__main__":
+    try:
+        asyncio.run(main())
+    except KeyboardInterrupt:
+        pass